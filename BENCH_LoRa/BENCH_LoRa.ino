@@ -0,0 +1,239 @@
+#include "SX1278.h"
+#include <SPI.h>
+
+// Two boards are needed for the radio benchmarks: flash this sketch with
+// BENCH_PEER 0 on the board under test and with BENCH_PEER 1 on the peer.
+#define BENCH_PEER  0
+
+#define LORA_MODE  4
+#define LORA_CHANNEL  CH_6_BW_125
+#define LORA_ADDRESS  (BENCH_PEER ? 4 : 2)
+#define LORA_PEER_ADDRESS  (BENCH_PEER ? 2 : 4)
+
+// Repetitions of the local (no radio) measurements
+#define BENCH_REPS  10
+// Time waited for each reply of the peer
+#define BENCH_WAIT  5000
+
+// First payload byte of the round trips
+#define BENCH_NO_ANSWER  0
+#define BENCH_ANSWER  1
+
+// Payload sizes, up to the largest one that fits in a 255 bytes frame
+// with the 5 framing bytes
+const uint8_t sizes[] = {0, 16, 32, 64, 128, 192, 250};
+
+uint8_t payload[MAX_PAYLOAD];
+
+unsigned long benchStart;
+unsigned long benchTotal;
+unsigned long benchMax;
+uint16_t benchCount;
+#if (SX1278_instrumentation > 0)
+instrumentation before;
+instrumentation after;
+#endif
+
+// Starts the measurements of an operation
+void benchBegin()
+{
+  benchTotal = 0;
+  benchMax = 0;
+  benchCount = 0;
+#if (SX1278_instrumentation > 0)
+  sx1278.getInstrumentation(&before);
+#endif
+}
+
+// Starts timing one call
+void benchIn()
+{
+  benchStart = micros();
+}
+
+// Stops timing one call
+void benchOut()
+{
+  unsigned long t = micros() - benchStart;
+
+  benchTotal += t;
+  if (t > benchMax) {
+    benchMax = t;
+  }
+  benchCount++;
+}
+
+// Prints a CSV line: op,param,calls,avg_us,max_us,reg_reads,reg_writes,opmode_writes
+// (register accesses per call, only with SX1278_instrumentation enabled)
+void benchEnd(const __FlashStringHelper *op, int param)
+{
+  Serial.print(op);
+  Serial.print(',');
+  Serial.print(param);
+  Serial.print(',');
+  Serial.print(benchCount);
+  Serial.print(',');
+  Serial.print(benchCount ? benchTotal / benchCount : 0);
+  Serial.print(',');
+  Serial.print(benchMax);
+  Serial.print(',');
+#if (SX1278_instrumentation > 0)
+  sx1278.getInstrumentation(&after);
+  Serial.print(benchCount ? (after.regReads - before.regReads) / benchCount : 0);
+  Serial.print(',');
+  Serial.print(benchCount ? (after.regWrites - before.regWrites) / benchCount : 0);
+  Serial.print(',');
+  Serial.println(benchCount ? (after.opModeWrites - before.opModeWrites) / benchCount : 0);
+#else
+  Serial.println(F("-,-,-"));
+#endif
+}
+
+void configure()
+{
+  sx1278.setMode(LORA_MODE);
+  sx1278.setHeaderON();
+  sx1278.setChannel(LORA_CHANNEL);
+  sx1278.setCRC_ON();
+  sx1278.setPower('M');
+  sx1278.setNodeAddress(LORA_ADDRESS);
+}
+
+// Waits for 'RxDone' so that 'getPacket' only reads the FIFO
+boolean waitRxDone(unsigned long wait)
+{
+  unsigned long previous = millis();
+
+  while (millis() - previous < wait) {
+    if (bitRead(sx1278.readRegister(REG_IRQ_FLAGS), 6) == 1) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void setup()
+{
+  Serial.begin(115200);
+
+  for (unsigned int i = 0; i < sizeof(payload); i++) {
+    payload[i] = i;
+  }
+
+#if (BENCH_PEER)
+  sx1278.ON();
+  configure();
+  Serial.println(F("sx1278 benchmark peer ready"));
+#else
+  Serial.println(F("op,param,calls,avg_us,max_us,reg_reads,reg_writes,opmode_writes"));
+
+  // Power ON the module
+  benchBegin();
+  benchIn();
+  sx1278.ON();
+  benchOut();
+  benchEnd(F("ON"), 0);
+
+  // All the LoRa modes
+  for (uint8_t mode = 1; mode <= 10; mode++) {
+    benchBegin();
+    for (uint8_t r = 0; r < BENCH_REPS; r++) {
+      benchIn();
+      sx1278.setMode(mode);
+      benchOut();
+    }
+    benchEnd(F("setMode"), mode);
+  }
+
+  configure();
+
+  // Filling the FIFO
+  for (uint8_t s = 0; s < sizeof(sizes); s++) {
+    benchBegin();
+    for (uint8_t r = 0; r < BENCH_REPS; r++) {
+      sx1278.truncPayload(sizes[s]);
+      benchIn();
+      if (sx1278.setPacket(LORA_PEER_ADDRESS, payload) == 0) {
+        benchOut();
+      }
+    }
+    benchEnd(F("setPacket"), sizes[s]);
+  }
+
+  // Reading the registers
+  benchBegin();
+  for (uint8_t r = 0; r < BENCH_REPS; r++) {
+    benchIn();
+    sx1278.getRegs();
+    benchOut();
+  }
+  benchEnd(F("getRegs"), 0);
+
+  // Trigger of a packet loaded in advance: call of 'fireTx' to the write
+  // of the Tx mode
+  for (uint8_t s = 0; s < sizeof(sizes); s++) {
+    uint16_t length = sizes[s] ? sizes[s] : 1;
+
+    benchBegin();
+    payload[0] = BENCH_NO_ANSWER;
+    for (uint8_t r = 0; r < BENCH_REPS; r++) {
+      if (sx1278.prepareTx(BROADCAST_0, payload, length) == 0) {
+        benchIn();
+        sx1278.fireTx();
+        benchOut();
+        sx1278.waitTxDone(BENCH_WAIT);
+      }
+      delay(1000);
+    }
+    benchEnd(F("fireTx"), length);
+  }
+
+  // Round trips with the peer. The first payload byte asks the peer to
+  // answer with a packet of the same size.
+  for (uint8_t s = 0; s < sizeof(sizes); s++) {
+    uint16_t length = sizes[s] ? sizes[s] : 1;
+
+    benchBegin();
+    payload[0] = BENCH_NO_ANSWER;
+    for (uint8_t r = 0; r < BENCH_REPS; r++) {
+      benchIn();
+      uint8_t e = sx1278.sendPacketTimeoutACK(LORA_PEER_ADDRESS, payload, length, BENCH_WAIT);
+      if (e == 0) {
+        benchOut();
+      }
+    }
+    benchEnd(F("sendPacketTimeoutACK"), length);
+
+    benchBegin();
+    payload[0] = BENCH_ANSWER;
+    for (uint8_t r = 0; r < BENCH_REPS; r++) {
+      if (sx1278.sendPacketTimeoutACK(LORA_PEER_ADDRESS, payload, length, BENCH_WAIT) != 0) {
+        continue;
+      }
+      sx1278.receive();
+      if (waitRxDone(BENCH_WAIT)) {
+        benchIn();
+        int8_t e = sx1278.getPacket(BENCH_WAIT);
+        if (e == 0) {
+          benchOut();
+        }
+      }
+    }
+    benchEnd(F("getPacket"), length);
+  }
+
+  Serial.println(F("done"));
+#endif
+}
+
+void loop(void)
+{
+#if (BENCH_PEER)
+  // Acknowledging each packet and answering with a packet of the same size
+  // when asked to
+  if ((sx1278.receivePacketTimeoutACK(10000) == 0) && (sx1278.packet_received.data[0] == BENCH_ANSWER)) {
+    delay(100);
+    sx1278.sendPacketTimeout(LORA_PEER_ADDRESS, sx1278.packet_received.data, sx1278._payloadlength);
+  }
+#endif
+}
@@ -42,6 +42,76 @@ SX1278::SX1278()
 	_reception = CORRECT_PACKET;
 	_retries = 0;
 	_maxRetries = 3;
+	_hopChannelsNb = 0;
+	_hopPeriod = 0;
+	_rxContinuous = false;
+	_fixedLength = 0;
+	_rxNbBytes = 0;
+	_bitRate = 4800;
+	_bulkLength = 0;
+	_arqWindow = 8;
+	_arqMode = ARQ_SELECTIVE_REPEAT;
+	memset( _rtt, 0x00, sizeof(_rtt) );
+#if (SX1278_link_stats > 0)
+	memset( _links, 0x00, sizeof(_links) );
+	_linkOverflow = 0;
+#endif
+	_txDest = 0;
+	_compression = COMPRESSION_NONE;
+	_compressHandler = NULL;
+	_decompressHandler = NULL;
+	_security = SECURITY_NONE;
+	memset( _secKey, 0x00, sizeof(_secKey) );
+	_secCounter = 0;
+	_secPeers = 0;
+#if (SX1278_fec_mode > 0)
+	_fecParity = 0;
+	_fecBlock = 8;
+#endif
+	_deviation = 5000;
+	_frameFormat = FRAME_FORMAT_LEGACY;
+	_rxFormat = 0;
+	_nodeAddress = 0;
+	_groups = 0;
+	_preamblelength = 8;
+	_wakeInterval = 0;
+	_rxDoneTime = 0;
+	_txDoneTime = 0;
+	_txArmed = false;
+	_txStart = 0;
+	_fireLatency = 0;
+	_prepareTime = TDMA_PREPARE_TIME;
+	_beaconSeq = 0;
+	_tdmaSlots = 0;
+	_tdmaIndex = TDMA_NO_SLOT;
+	_tdmaSlot = 0;
+	_tdmaPeriod = 0;
+	_beaconStamp = 0;
+	_beaconStart = 0;
+	_beaconEnd = 0;
+	_clockRatio = 1.0;
+	_tdmaSynced = false;
+#if (SX1278_instrumentation > 0)
+	memset( &_instr, 0x00, sizeof(_instr) );
+#endif
+#if (SX1278_trace_mode > 0)
+	resetTrace();
+#endif
+	_batching = false;
+	_batchCount = 0;
+	_batchError = 0;
+	_verifyPolicy = VERIFY_ALWAYS;
+	_auditPeriod = 0;
+	_lastAudit = 0;
+	_auditErrors = 0;
+	_shadowCount = 0;
+	_opMode = FSK_STANDBY_MODE;
+	_powerState = POWER_STANDBY;
+	_powerSince = 0;
+	memset( _residency, 0x00, sizeof(_residency) );
+	_autoSleep = false;
+	_wakeCount = 0;
+	_wakeTime = 0;
 	packet_sent.retry = _retries;
 };
 
@@ -73,6 +143,9 @@ uint8_t SX1278::ON()
 	SPI.setClockDivider(SPI_CLOCK_DIV2);
 	//Set data mode
 	SPI.setDataMode(SPI_MODE0);
+
+	// The module keeps its mode across resets of the microcontroller
+	updatePowerState(readRegister(REG_OP_MODE));
 	
 	// Set Maximum Over Current Protection
 	state = setMaxCurrent(0x1B);
@@ -106,6 +179,8 @@ void SX1278::OFF()
 		Serial.println(F("Starting 'OFF'"));
 	#endif
 
+	// The module keeps its registers in sleep mode
+	setSleep();
         SPI.end();
         // Powering the module
         pinMode(SX1278_SS,OUTPUT);
@@ -117,6 +192,404 @@ void SX1278::OFF()
 	#endif
 }
 
+/*
+ Function: Sets the module in sleep mode. The FIFO content is lost.
+ Returns: Integer that determines if there has been any error
+   state = 2  --> The command has not been executed
+   state = 1  --> There has been an error while executing the command
+   state = 0  --> The command has been executed with no errors
+*/
+int8_t SX1278::setSleep()
+{
+	int8_t state = 2;
+
+	#if (SX1278_debug_mode > 1)
+		Serial.println();
+		Serial.println(F("Starting 'setSleep'"));
+	#endif
+
+	if( _modem == LORA )
+	{
+		setOpMode(LORA_SLEEP_MODE);
+	}
+	else
+	{
+		setOpMode(FSK_SLEEP_MODE);
+	}
+	state = 0;
+	return state;
+}
+
+/*
+ Function: Sets the module in standby mode.
+ Returns: Integer that determines if there has been any error
+   state = 2  --> The command has not been executed
+   state = 1  --> There has been an error while executing the command
+   state = 0  --> The command has been executed with no errors
+*/
+int8_t SX1278::setStandby()
+{
+	int8_t state = 2;
+
+	#if (SX1278_debug_mode > 1)
+		Serial.println();
+		Serial.println(F("Starting 'setStandby'"));
+	#endif
+
+	if( _modem == LORA )
+	{
+		setOpMode(LORA_STANDBY_MODE);
+	}
+	else
+	{
+		setOpMode(FSK_STANDBY_MODE);
+	}
+	state = 0;
+	return state;
+}
+
+/*
+ Function: Wakes the module up from sleep to standby mode, accounting the
+           wake latency. In FSK mode the latency is measured until ModeReady,
+           in LoRa mode the crystal start up is not visible so TS_OSC is added.
+           The register accesses skip the delay of 'writeRegister' and
+           'readRegister', so only the SPI transfers add to the figure.
+ Returns: Integer that determines if there has been any error
+   state = 2  --> The command has not been executed
+   state = 1  --> There has been an error while executing the command
+   state = 0  --> The command has been executed with no errors
+*/
+int8_t SX1278::wake()
+{
+	int8_t state = 2;
+	unsigned long start;
+	uint8_t value;
+
+	if( _powerState != POWER_SLEEP )
+	{
+		return 0;
+	}
+
+	if( _modem == LORA )
+	{
+		value = LORA_STANDBY_MODE;
+	}
+	else
+	{
+		value = FSK_STANDBY_MODE;
+	}
+	SX1278_COUNT(opModeWrites);
+	start = micros();
+	writeRegisters(REG_OP_MODE, &value, 1);
+	if( _modem == LORA )
+	{
+		state = 0;
+		_wakeTime += micros() - start + WAKE_LATENCY_OSC;
+	}
+	else
+	{
+		state = 1;
+		while( micros() - start < MAX_WAKE_LATENCY )
+		{
+			// ModeReady flag
+			readRegisters(REG_IRQ_FLAGS1, &value, 1);
+			if( bitRead(value, 7) == 1 )
+			{
+				state = 0;
+				break;
+			}
+		}
+		_wakeTime += micros() - start;
+	}
+	_wakeCount++;
+	return state;
+}
+
+/*
+ Function: Sets the module in sleep mode after each transmission and reception
+           if enabled.
+ Parameters:
+   enable: 'true' to sleep when idle, 'false' to stay in standby.
+*/
+void SX1278::setAutoSleep(boolean enable)
+{
+	_autoSleep = enable;
+}
+
+/*
+ Function: Sets the module in sleep mode if the automatic sleep is enabled.
+*/
+void SX1278::idle()
+{
+	// Background audit of the registers the setters did not read back
+	if( (_auditPeriod != 0) && (millis() - _lastAudit >= _auditPeriod) )
+	{
+		auditRegisters();
+	}
+	if( _autoSleep )
+	{
+		setSleep();
+	}
+}
+
+/*
+ Function: Accounts the time spent in the previous power state and changes it
+           according to the operating mode written in REG_OP_MODE.
+ Parameters:
+   mode: value of REG_OP_MODE.
+*/
+void SX1278::updatePowerState(uint8_t mode)
+{
+	uint8_t power;
+	unsigned long now = millis();
+
+	_opMode = mode;
+	// Only standby keeps the FIFO of a packet armed by 'prepareTx'
+	if( (mode & B00000111) != 1 )
+	{
+		_txArmed = false;
+	}
+	switch( mode & B00000111 )
+	{
+		case 0:		power = POWER_SLEEP;
+					break;
+		case 1:		power = POWER_STANDBY;
+					break;
+		case 2:
+		case 3:		power = POWER_TX;
+					break;
+		default:	power = POWER_RX;
+					break;
+	}
+	_residency[_powerState] += now - _powerSince;
+	_powerSince = now;
+	_powerState = power;
+}
+
+/*
+ Function: Gets the time spent in a power state since the last reset.
+ Returns: Time in milliseconds
+ Parameters:
+   power: POWER_SLEEP, POWER_STANDBY, POWER_RX or POWER_TX.
+*/
+uint32_t SX1278::getResidency(uint8_t power)
+{
+	uint32_t time;
+
+	if( power >= POWER_STATES )
+	{
+		return 0;
+	}
+	time = _residency[power];
+	if( power == _powerState )
+	{
+		time += millis() - _powerSince;
+	}
+	return time;
+}
+
+/*
+ Function: Gets the energy used by the module since the last reset, modelled
+           with the typical currents of the datasheet.
+ Returns: Energy in millijoules
+*/
+float SX1278::getEnergy()
+{
+	float charge;	// uA * ms
+
+	charge = (float)getResidency(POWER_SLEEP) * CURRENT_SLEEP;
+	charge += (float)getResidency(POWER_STANDBY) * CURRENT_STANDBY;
+	charge += (float)getResidency(POWER_RX) * CURRENT_RX;
+	charge += (float)getResidency(POWER_TX) * CURRENT_TX;
+	return charge * SUPPLY_VOLTAGE / 1000000000.0;
+}
+
+/*
+ Function: Resets the power state counters.
+*/
+void SX1278::resetPowerStats()
+{
+	memset( _residency, 0x00, sizeof(_residency) );
+	_powerSince = millis();
+	_wakeCount = 0;
+	_wakeTime = 0;
+}
+
+/*
+ Function: Prints the time spent in each power state, the wake ups and the
+           modelled energy.
+*/
+void SX1278::showPowerStats()
+{
+	Serial.print(F("## Sleep (ms): "));
+	Serial.println(getResidency(POWER_SLEEP), DEC);
+	Serial.print(F("## Standby (ms): "));
+	Serial.println(getResidency(POWER_STANDBY), DEC);
+	Serial.print(F("## Rx (ms): "));
+	Serial.println(getResidency(POWER_RX), DEC);
+	Serial.print(F("## Tx (ms): "));
+	Serial.println(getResidency(POWER_TX), DEC);
+	Serial.print(F("## Wake ups: "));
+	Serial.print(_wakeCount, DEC);
+	if( _wakeCount != 0 )
+	{
+		Serial.print(F(", mean latency (us): "));
+		Serial.print(_wakeTime / _wakeCount, DEC);
+	}
+	Serial.println();
+	Serial.print(F("## Energy (mJ): "));
+	Serial.println(getEnergy(), 3);
+}
+
+#if (SX1278_instrumentation > 0)
+/*
+ Function: Accounts a call of an instrumented function.
+ Parameters:
+   op: INSTR_SET_PACKET, INSTR_SEND, INSTR_AVAILABLE_DATA, INSTR_GET_PACKET,
+       INSTR_GET_ACK or INSTR_SET_ACK.
+   time: duration of the call in us.
+*/
+void SX1278::instrumentCall(uint8_t op, uint32_t time)
+{
+	_instr.calls[op]++;
+	_instr.time[op] += time;
+	if( time > _instr.maxTime[op] )
+	{
+		_instr.maxTime[op] = time;
+	}
+}
+
+/*
+ Function: Copies the instrumentation counters.
+ Parameters:
+   counters: structure where the counters are copied.
+*/
+void SX1278::getInstrumentation(instrumentation *counters)
+{
+	memcpy( counters, &_instr, sizeof(_instr) );
+}
+
+/*
+ Function: Resets the instrumentation counters.
+*/
+void SX1278::resetInstrumentation()
+{
+	memset( &_instr, 0x00, sizeof(_instr) );
+}
+
+/*
+ Function: Starts timing an instrumented call.
+*/
+instrumentTimer::instrumentTimer(SX1278 *module, uint8_t op)
+{
+	_module = module;
+	_op = op;
+	_start = micros();
+}
+
+/*
+ Function: Accounts the instrumented call when it returns.
+*/
+instrumentTimer::~instrumentTimer()
+{
+	_module->instrumentCall(_op, micros() - _start);
+}
+#endif
+
+#if (SX1278_trace_mode > 0)
+/*
+ Function: Stores an event in the trace buffer. When the buffer is full the
+ event is dropped and counted, so a slow drain never stalls the radio.
+ Parameters:
+   event: TRACE_WRITE, TRACE_IRQ or TRACE_CALL.
+   reg: register written or read.
+   value: value of the register or INSTR_* function called.
+*/
+void SX1278::trace(uint8_t event, uint8_t reg, uint8_t value)
+{
+	traceRecord *record;
+
+	if( _traceCount == TRACE_SIZE )
+	{
+		if( _traceLost < 255 )
+		{
+			_traceLost++;
+		}
+		return;
+	}
+	record = &_trace[_traceHead];
+	record->time = micros();
+	record->event = event;
+	record->reg = reg;
+	record->value = value;
+	_traceHead = (_traceHead + 1) % TRACE_SIZE;
+	_traceCount++;
+}
+
+/*
+ Function: Sends the oldest trace records through the serial port, only
+ while there is room in the serial transmit buffer. The records dropped
+ while the buffer was full are newer than the ones in it, so they are
+ reported by a TRACE_LOST record once the buffer has been drained.
+ Returns: The number of records sent.
+ Parameters:
+   max: maximum number of records to send.
+*/
+uint8_t SX1278::drainTrace(uint8_t max)
+{
+	uint8_t sent = 0;
+	uint8_t frame[TRACE_FRAME];
+	traceRecord *record;
+	traceRecord lost;
+
+	while( (sent < max) && (Serial.availableForWrite() >= TRACE_FRAME) )
+	{
+		if( _traceCount > 0 )
+		{
+			record = &_trace[(_traceHead + TRACE_SIZE - _traceCount) % TRACE_SIZE];
+			_traceCount--;
+		}
+		else if( _traceLost > 0 )
+		{
+			// Reporting the records lost after the last one sent
+			lost.time = micros();
+			lost.event = TRACE_LOST;
+			lost.reg = 0;
+			lost.value = _traceLost;
+			record = &lost;
+			_traceLost = 0;
+		}
+		else
+		{
+			break;
+		}
+		frame[0] = TRACE_SYNC;
+		frame[1] = record->time & 0xFF;
+		frame[2] = (record->time >> 8) & 0xFF;
+		frame[3] = (record->time >> 16) & 0xFF;
+		frame[4] = (record->time >> 24) & 0xFF;
+		frame[5] = record->event;
+		frame[6] = record->reg;
+		frame[7] = record->value;
+		Serial.write(frame, TRACE_FRAME);
+		sent++;
+	}
+	return sent;
+}
+
+/*
+ Function: Discards the trace records.
+*/
+void SX1278::resetTrace()
+{
+	_traceHead = 0;
+	_traceCount = 0;
+	_traceLost = 0;
+	_traceIrq[0] = 0;
+	_traceIrq[1] = 0;
+}
+#endif
+
 /*
  Function: Reads the indicated register.
  Returns: The content of the register
@@ -127,6 +600,30 @@ byte SX1278::readRegister(byte address)
 {
     byte value = 0x00;
 
+    // Queued writes are not in the module yet
+    if( _batching )
+    {
+        for( uint8_t i = 0; i < _batchCount; i++ )
+        {
+            if( _batchAddress[i] == address )
+            {
+                return _batchData[i];
+            }
+        }
+    }
+
+    SX1278_COUNT(regReads);
+    #if (SX1278_instrumentation > 0)
+        if( address == REG_FIFO )
+        {
+            _instr.fifoReads++;
+        }
+        else if( (_modem == LORA) ? (address == REG_IRQ_FLAGS) : ((address == REG_IRQ_FLAGS1) || (address == REG_IRQ_FLAGS2)) )
+        {
+            _instr.irqPolls++;
+        }
+    #endif
+
     digitalWrite(SX1278_SS,LOW);
     
     //PRUEBA SPI
@@ -136,6 +633,18 @@ byte SX1278::readRegister(byte address)
     value = SPI.transfer(0x00);
     digitalWrite(SX1278_SS,HIGH);
 
+    #if (SX1278_trace_mode > 0)
+        // Only the changes of the IRQ flags, polling them would fill the buffer
+        if( (_modem == LORA) ? (address == REG_IRQ_FLAGS) : ((address == REG_IRQ_FLAGS1) || (address == REG_IRQ_FLAGS2)) )
+        {
+            if( value != _traceIrq[address == REG_IRQ_FLAGS2] )
+            {
+                _traceIrq[address == REG_IRQ_FLAGS2] = value;
+                trace(TRACE_IRQ, address, value);
+            }
+        }
+    #endif
+
     #if (SX1278_debug_mode > 1)
         Serial.print(F("## Reading:  ##\t"));
 		Serial.print(F("Register "));
@@ -157,6 +666,57 @@ byte SX1278::readRegister(byte address)
 */
 void SX1278::writeRegister(byte address, byte data)
 {
+    if( _batching && (address != REG_FIFO) )
+    {
+        if( address != REG_OP_MODE )
+        {
+            // Queueing the write, the last value of a register wins
+            uint8_t i = 0;
+            while( (i < _batchCount) && (_batchAddress[i] != address) )
+            {
+                i++;
+            }
+            if( i == BATCH_SIZE )
+            {
+                writeBatch();
+                i = 0;
+            }
+            _batchAddress[i] = address;
+            _batchData[i] = data;
+            if( i == _batchCount )
+            {
+                _batchCount++;
+            }
+            return;
+        }
+        // Queued writes belong to the current mode
+        writeBatch();
+    }
+    // Keeping the operating mode and power state accounting up to date
+    if( address == REG_OP_MODE )
+    {
+        updatePowerState(data);
+        SX1278_COUNT(opModeWrites);
+    }
+    SX1278_COUNT(regWrites);
+    #if (SX1278_instrumentation > 0)
+        if( address == REG_FIFO )
+        {
+            _instr.fifoWrites++;
+        }
+    #endif
+    if( address != REG_FIFO )
+    {
+        shadowWrite(address, data);
+    }
+    #if (SX1278_trace_mode > 0)
+        // FIFO writes are traced as the 'setPacket' call
+        if( address != REG_FIFO )
+        {
+            trace(TRACE_WRITE, address, data);
+        }
+    #endif
+
     digitalWrite(SX1278_SS,LOW);
     
     //PRUEBA SPI
@@ -179,82 +739,462 @@ void SX1278::writeRegister(byte address, byte data)
 }
 
 /*
- * Function: Clears the interruption flags
- * 
- * LoRa Configuration registers are accessed through the SPI interface. 
- * Registers are readable in all device mode including Sleep. However, they 
- * should be written only in Sleep and Stand-by modes.
- * 
- * Returns: Nothing
+ Function: Sets the operating mode. The mode is kept by 'updatePowerState' on
+ every write of REG_OP_MODE and on the automatic changes (TxDone, CadDone), so
+ REG_OP_MODE is only written when the mode changes.
+ Parameters:
+   mode: value to write in REG_OP_MODE
 */
-void SX1278::clearFlags()
+void SX1278::setOpMode(uint8_t mode)
 {
-    byte st0;
-
-	// Save the previous status
-	st0 = readRegister(REG_OP_MODE);		
-
-	if( _modem == LORA )
-	{
-		/// LoRa mode
-		// Stdby mode to write in registers		
-		writeRegister(REG_OP_MODE, LORA_STANDBY_MODE);	
-		// LoRa mode flags register
-		writeRegister(REG_IRQ_FLAGS, 0xFF);	
-		// Getting back to previous status
-		writeRegister(REG_OP_MODE, st0);
-		
-		#if (SX1278_debug_mode > 1)
-			Serial.println(F("## LoRa flags cleared ##"));
-		#endif
-	}
-	else
+	if( mode == _opMode )
 	{
-		/// FSK mode
-		// Stdby mode to write in registers
-		writeRegister(REG_OP_MODE, FSK_STANDBY_MODE);	
-		// FSK mode flags1 register
-		writeRegister(REG_IRQ_FLAGS1, 0xFF);
-		// FSK mode flags2 register 
-		writeRegister(REG_IRQ_FLAGS2, 0xFF);
-		// Getting back to previous status
-		writeRegister(REG_OP_MODE, st0);
-		
-		#if (SX1278_debug_mode > 1)
-			Serial.println(F("## FSK flags cleared ##"));
-		#endif
+		SX1278_COUNT(opModeSkips);
+		return;
 	}
+	writeRegister(REG_OP_MODE, mode);
 }
 
 /*
- Function: Sets the module in LoRa mode.
- Returns:  Integer that determines if there has been any error
-   state = 2  --> The command has not been executed
-   state = 1  --> There has been an error while executing the command
-   state = 0  --> The command has been executed with no errors
+ Function: Reads consecutive registers in one SPI transaction, without the
+ delay of 'readRegister'.
+ Returns: Nothing
+ Parameters:
+   address: first register to read from
+   data: where the registers are stored
+   length: number of registers to read
 */
-uint8_t SX1278::setLORA()
+void SX1278::readRegisters(byte address, uint8_t *data, uint16_t length)
 {
-    uint8_t state = 2;
+    SX1278_COUNT(regReads);
+    #if (SX1278_instrumentation > 0)
+        if( address == REG_FIFO )
+        {
+            _instr.fifoReads += length;
+        }
+    #endif
+
+    // No settling delay: the FIFO streams need back to back accesses
+    digitalWrite(SX1278_SS,LOW);
+    bitClear(address, 7);		// Bit 7 cleared to read from registers
+    SPI.transfer(address);
+    for( uint16_t i = 0; i < length; i++ )
+    {
+        data[i] = SPI.transfer(0x00);
+    }
+    digitalWrite(SX1278_SS,HIGH);
+
+    #if (SX1278_debug_mode > 1)
+        Serial.print(F("## Reading:  ##\t"));
+		Serial.print(F("Registers from "));
+		Serial.print(address, HEX);
+		Serial.print(F(":  "));
+		for( uint16_t i = 0; i < length; i++ )
+		{
+			Serial.print(data[i], HEX);
+			Serial.print(F(" "));
+		}
+		Serial.println();
+	#endif
+}
+
+/*
+ Function: Writes consecutive registers in one SPI transaction, without the
+ delay of 'writeRegister'.
+ Returns: Nothing
+ Parameters:
+   address: first register to write in
+   data: values to write
+   length: number of registers to write
+*/
+void SX1278::writeRegisters(byte address, uint8_t *data, uint16_t length)
+{
+    if( (address == REG_OP_MODE) && (length > 0) )
+    {
+        updatePowerState(data[0]);
+    }
+    SX1278_COUNT(regWrites);
+    #if (SX1278_instrumentation > 0)
+        if( address == REG_FIFO )
+        {
+            _instr.fifoWrites += length;
+        }
+    #endif
+    if( address != REG_FIFO )
+    {
+        for( uint16_t i = 0; i < length; i++ )
+        {
+            shadowWrite(address + i, data[i]);
+            SX1278_TRACE(TRACE_WRITE, address + i, data[i]);
+        }
+    }
+
+    // No settling delay: the FIFO streams need back to back accesses
+    digitalWrite(SX1278_SS,LOW);
+    bitSet(address, 7);			// Bit 7 set to write in registers
+    SPI.transfer(address);
+    for( uint16_t i = 0; i < length; i++ )
+    {
+        SPI.transfer(data[i]);
+    }
+    digitalWrite(SX1278_SS,HIGH);
+
+    #if (SX1278_debug_mode > 1)
+        Serial.print(F("## Writing:  ##\t"));
+		Serial.print(F("Registers from "));
+		bitClear(address, 7);
+		Serial.print(address, HEX);
+		Serial.print(F(":  "));
+		for( uint16_t i = 0; i < length; i++ )
+		{
+			Serial.print(data[i], HEX);
+			Serial.print(F(" "));
+		}
+		Serial.println();
+	#endif
+}
+
+/*
+ Function: Starts queueing the register writes.
+*/
+void SX1278::beginBatch()
+{
+	_batching = true;
+	_batchCount = 0;
+	_batchError = 0;
+}
+
+/*
+ Function: Writes the queued registers, one burst per run of contiguous
+ addresses, and reads every run back in one burst to check it.
+*/
+void SX1278::writeBatch()
+{
+	uint8_t address;
+	uint8_t data;
+	uint8_t run;
+	uint8_t check[BATCH_SIZE];
+	uint8_t j;
+
+	// Sorting the queue by address to find the runs
+	for( uint8_t i = 1; i < _batchCount; i++ )
+	{
+		address = _batchAddress[i];
+		data = _batchData[i];
+		for( j = i; (j > 0) && (_batchAddress[j - 1] > address); j-- )
+		{
+			_batchAddress[j] = _batchAddress[j - 1];
+			_batchData[j] = _batchData[j - 1];
+		}
+		_batchAddress[j] = address;
+		_batchData[j] = data;
+	}
+
+	// The queue is emptied first so the bursts reach the module
+	_batching = false;
+	for( uint8_t i = 0; i < _batchCount; i += run )
+	{
+		run = 1;
+		while( (i + run < _batchCount) && (_batchAddress[i + run] == _batchAddress[i] + run) )
+		{
+			run++;
+		}
+		writeRegisters(_batchAddress[i], &_batchData[i], run);
+	}
+	for( uint8_t i = 0; i < _batchCount; i += run )
+	{
+		run = 1;
+		while( (i + run < _batchCount) && (_batchAddress[i + run] == _batchAddress[i] + run) )
+		{
+			run++;
+		}
+		readRegisters(_batchAddress[i], check, run);
+		if( memcmp(check, &_batchData[i], run) != 0 )
+		{
+			_batchError = 1;
+			#if (SX1278_debug_mode > 1)
+				Serial.print(F("** Register "));
+				Serial.print(_batchAddress[i], HEX);
+				Serial.println(F(" burst has not been written correctly **"));
+			#endif
+		}
+	}
+	_batchCount = 0;
+	_batching = true;
+}
+
+/*
+ Function: Writes the queued registers and ends the batch.
+ Returns: Integer that determines if there has been any error
+   state = 1  --> A register written in the batch was not read back
+   state = 0  --> The command has been executed with no errors
+*/
+int8_t SX1278::flushBatch()
+{
+	writeBatch();
+	_batching = false;
+	return _batchError;
+}
+
+/*
+ Function: Sets when the setters read back the registers they write.
+ Returns: Integer that determines if there has been any error
+   state = 0  --> The command has been executed with no errors
+   state = -1 --> Forbidden parameter value for this function
+ Parameters:
+   policy: VERIFY_ALWAYS, VERIFY_ON_CHANGE or VERIFY_AUDIT
+   period: time (ms) between the audits run when the module goes idle,
+   '0' to only audit when 'auditRegisters' is called
+*/
+int8_t SX1278::setVerifyPolicy(uint8_t policy, uint32_t period)
+{
+	if( policy > VERIFY_AUDIT )
+	{
+		return -1;
+	}
+	_verifyPolicy = policy;
+	_auditPeriod = period;
+	_lastAudit = millis();
+	return 0;
+}
+
+/*
+ Function: Records in the shadow the registers written by a setter and reads
+ them back unless the policy allows to skip it.
+ Returns: 'true' if the registers hold the values or were not read back
+ Parameters:
+   address: first register written
+   data: values written
+   length: number of consecutive registers written
+*/
+boolean SX1278::checkRegisters(byte address, uint8_t *data, uint8_t length)
+{
+	boolean changed = false;
+	uint8_t value[4];
+	uint8_t i;
+
+	for( uint8_t n = 0; n < length; n++ )
+	{
+		i = 0;
+		while( (i < _shadowCount) && (_shadowAddress[i] != address + n) )
+		{
+			i++;
+		}
+		if( i == _shadowCount )
+		{
+			if( _shadowCount == SHADOW_SIZE )
+			{
+				// Not kept in the shadow, so not audited either
+				changed = true;
+				continue;
+			}
+			_shadowAddress[i] = address + n;
+			_shadowCount++;
+			changed = true;
+		}
+		else if( _shadowChecked[i] != data[n] )
+		{
+			changed = true;
+		}
+		_shadowData[i] = data[n];
+		_shadowChecked[i] = data[n];
+	}
+
+	if( (_verifyPolicy == VERIFY_ALWAYS)
+		|| ((_verifyPolicy == VERIFY_ON_CHANGE) && changed) )
+	{
+		length = min(length, sizeof(value));
+		readRegisters(address, value, length);
+		return( memcmp(value, data, length) == 0 );
+	}
+	return true;
+}
+
+/*
+ Function: Reads the registers of the shadow and writes again the ones that
+ do not hold the value set. If the module is not in the modem or in the
+ sleep or standby mode it was left in, it has been reset: the modem is set
+ again, with the FSK bit rate and deviation, before the shadow (channel,
+ power, modulation, lengths and addresses) is written back.
+ Returns: The number of corrupted registers.
+*/
+uint8_t SX1278::auditRegisters()
+{
+	uint8_t errors = 0;
+	byte st0;
+	byte mode;
+	boolean reset;
+	uint8_t shadow[SHADOW_SIZE];
+
+	#if (SX1278_debug_mode > 1)
+		Serial.println();
+		Serial.println(F("Starting 'auditRegisters'"));
+	#endif
+
+	_lastAudit = millis();
+	st0 = _opMode;	// Save the previous status
+
+	// LongRangeMode must match the modem. Tx, Rx and CAD fall back to
+	// standby by themselves, so only sleep and standby are compared
+	mode = readRegister(REG_OP_MODE);
+	reset = (bitRead(mode, 7) != ((_modem == LORA) ? 1 : 0));
+	if( ((st0 & B00000111) <= 1) && ((mode & B00000111) != (st0 & B00000111)) )
+	{
+		reset = true;
+	}
+	if( reset )
+	{
+		#if (SX1278_debug_mode > 0)
+			Serial.println(F("** The module has been reset, setting it again **"));
+		#endif
+		// Setting the modem writes its defaults over the shadow
+		memcpy( shadow, _shadowData, _shadowCount );
+		if( _modem == LORA )
+		{
+			setLORA();
+		}
+		else
+		{
+			setFSK();
+			setFSKBitrate(_bitRate);
+			setFSKDeviation(_deviation);
+		}
+		memcpy( _shadowData, shadow, _shadowCount );
+		memcpy( _shadowChecked, shadow, _shadowCount );
+	}
+	for( uint8_t i = 0; i < _shadowCount; i++ )
+	{
+		if( readRegister(_shadowAddress[i]) != _shadowData[i] )
+		{
+			if( errors == 0 )
+			{
+				// Stdby mode in order to write in registers
+				if( _modem == LORA )
+				{
+					setOpMode(LORA_STANDBY_MODE);
+				}
+				else
+				{
+					setOpMode(FSK_STANDBY_MODE);
+				}
+			}
+			writeRegister(_shadowAddress[i], _shadowData[i]);
+			errors++;
+			#if (SX1278_debug_mode > 1)
+				Serial.print(F("** Register "));
+				Serial.print(_shadowAddress[i], HEX);
+				Serial.println(F(" was corrupted, written again **"));
+			#endif
+		}
+	}
+	if( (errors > 0) || reset )
+	{
+		setOpMode(st0);	// Getting back to previous status
+	}
+	_auditErrors += errors;
+	return errors;
+}
+
+/*
+ Function: Keeps the shadow up to date, the registers of the shadow are also
+ written outside the setters (channel hopping, FSK streams).
+ Parameters:
+   address: register written
+   data: value written
+*/
+void SX1278::shadowWrite(byte address, byte data)
+{
+	for( uint8_t i = 0; i < _shadowCount; i++ )
+	{
+		if( _shadowAddress[i] == address )
+		{
+			_shadowData[i] = data;
+			return;
+		}
+	}
+}
+
+/*
+ * Function: Clears the interruption flags
+ * 
+ * LoRa Configuration registers are accessed through the SPI interface. 
+ * Registers are readable in all device mode including Sleep. However, they 
+ * should be written only in Sleep and Stand-by modes.
+ * 
+ * Returns: Nothing
+*/
+void SX1278::clearFlags()
+{
+	// The flags are cleared by writing '1' in any mode, so there is no need
+	// to go through standby
+	if( _modem == LORA )
+	{
+		/// LoRa mode
+		// LoRa mode flags register
+		writeRegister(REG_IRQ_FLAGS, 0xFF);	
+		
+		#if (SX1278_debug_mode > 1)
+			Serial.println(F("## LoRa flags cleared ##"));
+		#endif
+	}
+	else
+	{
+		/// FSK mode
+		// FSK mode flags1 register
+		writeRegister(REG_IRQ_FLAGS1, 0xFF);
+		// FSK mode flags2 register 
+		writeRegister(REG_IRQ_FLAGS2, 0xFF);
+		
+		#if (SX1278_debug_mode > 1)
+			Serial.println(F("## FSK flags cleared ##"));
+		#endif
+	}
+}
+
+/*
+ Function: Sets the module in LoRa mode. The modulation is only set to its
+           defaults when the module was in FSK mode, so the one set by the
+           user is kept through 'OFF' and 'ON'.
+ Returns:  Integer that determines if there has been any error
+   state = 2  --> The command has not been executed
+   state = 1  --> There has been an error while executing the command
+   state = 0  --> The command has been executed with no errors
+*/
+uint8_t SX1278::setLORA()
+{
+    uint8_t state = 2;
     byte st0;
+    boolean changed;
+    uint8_t config[2];
 
 	#if (SX1278_debug_mode > 1)
 		Serial.println();
 		Serial.println(F("Starting 'setLORA'"));
 	#endif
 
-	writeRegister(REG_OP_MODE, FSK_SLEEP_MODE);    // Sleep mode (mandatory to set LoRa mode)
-	writeRegister(REG_OP_MODE, LORA_SLEEP_MODE);    // LoRa sleep mode
-	writeRegister(REG_OP_MODE, LORA_STANDBY_MODE);	// LoRa standby mode
+	// The registers of the shadow have another meaning in LoRa mode
+	if( _modem != LORA )
+	{
+		_shadowCount = 0;
+	}
+	// LongRangeMode bit
+	changed = (bitRead(readRegister(REG_OP_MODE), 7) == 0);
+
+	setOpMode(FSK_SLEEP_MODE);    // Sleep mode (mandatory to set LoRa mode)
+	setOpMode(LORA_SLEEP_MODE);    // LoRa sleep mode
+	setOpMode(LORA_STANDBY_MODE);	// LoRa standby mode
 
 	writeRegister(REG_MAX_PAYLOAD_LENGTH,MAX_LENGTH);
 		
-	// Set RegModemConfig1 to Default values
-	writeRegister(REG_MODEM_CONFIG1, 0x72);	
-	// Set RegModemConfig2 to Default values
-	writeRegister(REG_MODEM_CONFIG2, 0x70);	
-	// Set RegModemConfig2 to Default values
-	writeRegister(REG_MODEM_CONFIG3, 0x00);		
+	if( changed )
+	{
+		// Set RegModemConfig1 to Default values
+		writeRegister(REG_MODEM_CONFIG1, 0x72);	
+		// Set RegModemConfig2 to Default values
+		writeRegister(REG_MODEM_CONFIG2, 0x70);	
+		// Set RegModemConfig2 to Default values
+		writeRegister(REG_MODEM_CONFIG3, 0x00);		
+	}
 
 	//delay(100);
 
@@ -263,6 +1203,11 @@ uint8_t SX1278::setLORA()
 	{ // LoRa mode
 		_modem = LORA;
 		state = 0;
+		// The modulation is audited too, the setters keep it up to date
+		readRegisters(REG_MODEM_CONFIG1, config, 2);
+		checkRegisters(REG_MODEM_CONFIG1, config, 2);
+		readRegisters(REG_MODEM_CONFIG3, config, 1);
+		checkRegisters(REG_MODEM_CONFIG3, config, 1);
 		#if (SX1278_debug_mode > 1)
 			Serial.println(F("## LoRa set with success ##"));
 			Serial.println();
@@ -298,8 +1243,14 @@ uint8_t SX1278::setFSK()
 		Serial.println(F("Starting 'setFSK'"));
 	#endif
 
-	writeRegister(REG_OP_MODE, FSK_SLEEP_MODE);	// Sleep mode (mandatory to change mode)
-	writeRegister(REG_OP_MODE, FSK_STANDBY_MODE);	// FSK standby mode
+	// The registers of the shadow have another meaning in FSK mode
+	if( _modem != FSK )
+	{
+		_shadowCount = 0;
+	}
+
+	setOpMode(FSK_SLEEP_MODE);	// Sleep mode (mandatory to change mode)
+	setOpMode(FSK_STANDBY_MODE);	// FSK standby mode
 	config1 = readRegister(REG_PACKET_CONFIG1);
 	config1 = config1 & B01111101;		// clears bits 8 and 1 from REG_PACKET_CONFIG1
 	config1 = config1 | B00000100;		// sets bit 2 from REG_PACKET_CONFIG1
@@ -315,7 +1266,8 @@ uint8_t SX1278::setFSK()
 	if( st0 == FSK_STANDBY_MODE )
 	{ // FSK mode
 		_modem = FSK;
-		state = 0;
+		// The node address may have been set in LoRa mode
+		state = setAddressFilter();
 		#if (SX1278_debug_mode > 1)
 			Serial.println(F("## FSK set with success ##"));
 			Serial.println();
@@ -334,63 +1286,323 @@ uint8_t SX1278::setFSK()
 }
 
 /*
- Function: Gets the bandwidth, coding rate and spreading factor of the LoRa modulation.
+ Function: Sets the FSK bit rate.
  Returns: Integer that determines if there has been any error
    state = 2  --> The command has not been executed
    state = 1  --> There has been an error while executing the command
    state = 0  --> The command has been executed with no errors
+   state = -1 --> Forbidden command for this protocol
+ Parameters:
+   bitrate: bit rate in bps.
 */
-uint8_t SX1278::getMode()
+int8_t SX1278::setFSKBitrate(uint32_t bitrate)
 {
-	byte st0;
 	int8_t state = 2;
-	byte value = 0x00;
+	byte st0;
+	uint32_t value;
 
 	#if (SX1278_debug_mode > 1)
-	  Serial.println();
-	  Serial.println(F("Starting 'getMode'"));
+		Serial.println();
+		Serial.println(F("Starting 'setFSKBitrate'"));
 	#endif
 
-	// Save the previous status
-	st0 = readRegister(REG_OP_MODE);		
-	// Setting LoRa mode
-	if( _modem == FSK )
+	if( _modem == LORA )
 	{
-		setLORA();					
+		return -1;
 	}
-	value = readRegister(REG_MODEM_CONFIG1);
-	_bandwidth = (value >> 4);   				// Storing 4 MSB from REG_MODEM_CONFIG1 (=_bandwidth)
-	_codingRate = (value >> 1) & 0x07;  		// Storing first, second and third bits from
-	value = readRegister(REG_MODEM_CONFIG2);	// REG_MODEM_CONFIG1 (=_codingRate)
-	_spreadingFactor = (value >> 4) & 0x0F; 	// Storing 4 MSB from REG_MODEM_CONFIG2 (=_spreadingFactor)
-	state = 1;
-
-	if( isBW(_bandwidth) )		// Checking available values for:
-	{								//		_bandwidth
-		if( isCR(_codingRate) )		//		_codingRate
-		{							//		_spreadingFactor
-			if( isSF(_spreadingFactor) )
-			{
-				state = 0;
-			}
-		}
+	if( (bitrate < MIN_BITRATE_FSK) || (bitrate > MAX_BITRATE_FSK) )
+	{
+		#if (SX1278_debug_mode > 1)
+			Serial.println(F("** Bit rate must be between 1200 and 300000 bps **"));
+			Serial.println();
+		#endif
+		return 1;
 	}
 
-	#if (SX1278_debug_mode > 1)
-	  Serial.println(F("## Parameters from configuration mode are:"));
-	  Serial.print(F("Bandwidth: "));
-	  Serial.print(_bandwidth, HEX);
-	  Serial.println();
-	  Serial.print(F("\t Coding Rate: "));
-	  Serial.print(_codingRate, HEX);
-	  Serial.println();
-	  Serial.print(F("\t Spreading Factor: "));
-	  Serial.print(_spreadingFactor, HEX);
+	st0 = _opMode;	// Save the previous status
+	setOpMode(FSK_STANDBY_MODE);	// FSK standby mode to write in registers
+
+	// BitRate = Fxosc / (BitRate(15:0) + BitRateFrac/16), in 1/16 steps
+	value = 512000000UL / bitrate;
+	writeRegister(REG_BITRATE_MSB, (value >> 12) & 0xFF);
+	writeRegister(REG_BITRATE_LSB, (value >> 4) & 0xFF);
+	writeRegister(REG_BIT_RATE_FRAC, value & 0x0F);
+
+	// check registers
+	if( (readRegister(REG_BITRATE_MSB) == ((value >> 12) & 0xFF))
+		&& (readRegister(REG_BITRATE_LSB) == ((value >> 4) & 0xFF)) )
+	{
+		_bitRate = bitrate;
+		state = 0;
+		#if (SX1278_debug_mode > 1)
+			Serial.print(F("## Bit rate "));
+			Serial.print(bitrate, DEC);
+			Serial.println(F(" has been successfully set ##"));
+			Serial.println();
+		#endif
+	}
+	else
+	{
+		state = 1;
+	}
+	setOpMode(st0);	// Getting back to previous status
+	return state;
+}
+
+/*
+ Function: Sets the FSK frequency deviation.
+ Returns: Integer that determines if there has been any error
+   state = 2  --> The command has not been executed
+   state = 1  --> There has been an error while executing the command
+   state = 0  --> The command has been executed with no errors
+   state = -1 --> Forbidden command for this protocol
+ Parameters:
+   fdev: frequency deviation in Hz.
+*/
+int8_t SX1278::setFSKDeviation(uint32_t fdev)
+{
+	int8_t state = 2;
+	byte st0;
+	uint16_t value;
+
+	#if (SX1278_debug_mode > 1)
+		Serial.println();
+		Serial.println(F("Starting 'setFSKDeviation'"));
+	#endif
+
+	if( _modem == LORA )
+	{
+		return -1;
+	}
+	// Fdev + BitRate/2 <= 250 kHz
+	if( (fdev > MAX_FDEV_FSK) || (fdev + _bitRate/2 > MAX_RX_BW_FSK) )
+	{
+		#if (SX1278_debug_mode > 1)
+			Serial.println(F("** Deviation plus half the bit rate must not exceed 250 kHz **"));
+			Serial.println();
+		#endif
+		return 1;
+	}
+
+	st0 = _opMode;	// Save the previous status
+	setOpMode(FSK_STANDBY_MODE);	// FSK standby mode to write in registers
+
+	// Fdev = Fstep * Fdev(13:0), Fstep = 61.035 Hz
+	value = (uint16_t)((float)fdev / 61.03515625 + 0.5);
+	writeRegister(REG_FDEV_MSB, (value >> 8) & 0x3F);
+	writeRegister(REG_FDEV_LSB, value & 0xFF);
+
+	// check registers
+	if( (readRegister(REG_FDEV_MSB) == ((value >> 8) & 0x3F))
+		&& (readRegister(REG_FDEV_LSB) == (value & 0xFF)) )
+	{
+		_deviation = fdev;
+		state = 0;
+		#if (SX1278_debug_mode > 1)
+			Serial.print(F("## Deviation "));
+			Serial.print(fdev, DEC);
+			Serial.println(F(" has been successfully set ##"));
+			Serial.println();
+		#endif
+	}
+	else
+	{
+		state = 1;
+	}
+	setOpMode(st0);	// Getting back to previous status
+	return state;
+}
+
+/*
+ Function: Sets the FSK receiver and AFC bandwidth.
+ Returns: Integer that determines if there has been any error
+   state = 2  --> The command has not been executed
+   state = 1  --> There has been an error while executing the command
+   state = 0  --> The command has been executed with no errors
+   state = -1 --> Forbidden command for this protocol
+ Parameters:
+   bw: single side bandwidth in Hz.
+*/
+int8_t SX1278::setFSKRxBandwidth(uint32_t bw)
+{
+	int8_t state = 2;
+	byte st0;
+	byte config = 0;
+	uint32_t best = 0;
+	uint32_t value;
+
+	#if (SX1278_debug_mode > 1)
+		Serial.println();
+		Serial.println(F("Starting 'setFSKRxBandwidth'"));
+	#endif
+
+	if( _modem == LORA )
+	{
+		return -1;
+	}
+	if( bw > MAX_RX_BW_FSK )
+	{
+		return 1;
+	}
+
+	// RxBw = Fxosc / (RxBwMant * 2^(RxBwExp + 2)), RxBwMant = 16, 20 or 24
+	for( uint8_t exp = 1; exp <= 7; exp++ )
+	{
+		for( uint8_t mant = 0; mant <= 2; mant++ )
+		{
+			value = 32000000UL / ((16 + 4*mant) * (1UL << (exp + 2)));
+			if( (value >= bw) && ((best == 0) || (value < best)) )
+			{
+				best = value;
+				config = (mant << 3) | exp;
+			}
+		}
+	}
+
+	st0 = _opMode;	// Save the previous status
+	setOpMode(FSK_STANDBY_MODE);	// FSK standby mode to write in registers
+	writeRegister(REG_RX_BW, config);
+	writeRegister(REG_AFC_BW, config);
+
+	// check registers
+	if( (readRegister(REG_RX_BW) & B00011111) == config )
+	{
+		state = 0;
+		#if (SX1278_debug_mode > 1)
+			Serial.print(F("## Rx bandwidth "));
+			Serial.print(best, DEC);
+			Serial.println(F(" has been successfully set ##"));
+			Serial.println();
+		#endif
+	}
+	else
+	{
+		state = 1;
+	}
+	setOpMode(st0);	// Getting back to previous status
+	return state;
+}
+
+/*
+ Function: Sets bit rate, deviation and receiver bandwidth from a preset.
+ Returns: Integer that determines if there has been any error
+   state = 2  --> The command has not been executed
+   state = 1  --> There has been an error while executing the command
+   state = 0  --> The command has been executed with no errors
+   state = -1 --> Forbidden command for this protocol
+ Parameters:
+   preset: FSK_PRESET_4K8, FSK_PRESET_38K4, FSK_PRESET_100K,
+           FSK_PRESET_250K or FSK_PRESET_300K.
+*/
+int8_t SX1278::setFSKPreset(uint8_t preset)
+{
+	int8_t state = 2;
+	uint32_t bitrate;
+	uint32_t fdev;
+	uint32_t bw;
+
+	#if (SX1278_debug_mode > 1)
+		Serial.println();
+		Serial.println(F("Starting 'setFSKPreset'"));
+	#endif
+
+	// Modulation index 2*Fdev/BitRate >= 0.5 and RxBw >= Fdev + BitRate/2
+	switch( preset )
+	{
+		case FSK_PRESET_4K8:	bitrate = 4800;
+								fdev = 5000;
+								bw = 10400;
+								break;
+		case FSK_PRESET_38K4:	bitrate = 38400;
+								fdev = 20000;
+								bw = 41700;
+								break;
+		case FSK_PRESET_100K:	bitrate = 100000;
+								fdev = 50000;
+								bw = 125000;
+								break;
+		case FSK_PRESET_250K:	bitrate = 250000;
+								fdev = 100000;
+								bw = 250000;
+								break;
+		case FSK_PRESET_300K:	bitrate = 300000;
+								fdev = 100000;
+								bw = 250000;
+								break;
+		default:				return 1;
+	}
+
+	// Deviation is checked against the bit rate, so it is set after it
+	state = setFSKBitrate(bitrate);
+	if( state == 0 )
+	{
+		state = setFSKDeviation(fdev);
+	}
+	if( state == 0 )
+	{
+		state = setFSKRxBandwidth(bw);
+	}
+	return state;
+}
+
+/*
+ Function: Gets the bandwidth, coding rate and spreading factor of the LoRa modulation.
+ Returns: Integer that determines if there has been any error
+   state = 2  --> The command has not been executed
+   state = 1  --> There has been an error while executing the command
+   state = 0  --> The command has been executed with no errors
+*/
+uint8_t SX1278::getMode()
+{
+	byte st0;
+	int8_t state = 2;
+	byte value = 0x00;
+
+	#if (SX1278_debug_mode > 1)
+	  Serial.println();
+	  Serial.println(F("Starting 'getMode'"));
+	#endif
+
+	// Save the previous status
+	st0 = _opMode;
+	// Setting LoRa mode
+	if( _modem == FSK )
+	{
+		setLORA();					
+	}
+	value = readRegister(REG_MODEM_CONFIG1);
+	_bandwidth = (value >> 4);   				// Storing 4 MSB from REG_MODEM_CONFIG1 (=_bandwidth)
+	_codingRate = (value >> 1) & 0x07;  		// Storing first, second and third bits from
+	value = readRegister(REG_MODEM_CONFIG2);	// REG_MODEM_CONFIG1 (=_codingRate)
+	_spreadingFactor = (value >> 4) & 0x0F; 	// Storing 4 MSB from REG_MODEM_CONFIG2 (=_spreadingFactor)
+	state = 1;
+
+	if( isBW(_bandwidth) )		// Checking available values for:
+	{								//		_bandwidth
+		if( isCR(_codingRate) )		//		_codingRate
+		{							//		_spreadingFactor
+			if( isSF(_spreadingFactor) )
+			{
+				state = 0;
+			}
+		}
+	}
+
+	#if (SX1278_debug_mode > 1)
+	  Serial.println(F("## Parameters from configuration mode are:"));
+	  Serial.print(F("Bandwidth: "));
+	  Serial.print(_bandwidth, HEX);
+	  Serial.println();
+	  Serial.print(F("\t Coding Rate: "));
+	  Serial.print(_codingRate, HEX);
+	  Serial.println();
+	  Serial.print(F("\t Spreading Factor: "));
+	  Serial.print(_spreadingFactor, HEX);
 	  Serial.println(F(" ##"));
 	  Serial.println();
 	#endif
 
-	writeRegister(REG_OP_MODE, st0);	// Getting back to previous status
+	setOpMode(st0);	// Getting back to previous status
 	return state;
 }
 
@@ -407,6 +1619,7 @@ uint8_t SX1278::getMode()
 int8_t SX1278::setMode(uint8_t mode)
 {
 	int8_t state = 2;
+	int8_t batch;
 	byte st0;
 	byte config1 = 0x00;
 	byte config2 = 0x00;
@@ -416,7 +1629,7 @@ int8_t SX1278::setMode(uint8_t mode)
 		Serial.println(F("Starting 'setMode'"));
 	#endif
 
-	st0 = readRegister(REG_OP_MODE);		// Save the previous status
+	st0 = _opMode;		// Save the previous status
 
 	// 'setMode' function only can be called in LoRa mode
 	if( _modem == FSK )
@@ -425,7 +1638,11 @@ int8_t SX1278::setMode(uint8_t mode)
 	}
 	
 	// LoRa standby mode
-	writeRegister(REG_OP_MODE, LORA_STANDBY_MODE);	
+	setOpMode(LORA_STANDBY_MODE);	
+
+	// 'setCR', 'setSF' and 'setBW' modify the same registers, they are
+	// written once at the end, in bursts
+	beginBatch();
 
 	switch (mode)
 	{
@@ -493,6 +1710,7 @@ int8_t SX1278::setMode(uint8_t mode)
 
 	};
 
+	batch = flushBatch();
 
 	// Check proper register configuration
 	if( state == -1 )	// if state = -1, don't change its value
@@ -613,6 +1831,10 @@ int8_t SX1278::setMode(uint8_t mode)
 				}
 				break;
 		}// end switch
+		if( batch != 0 )
+		{
+			state = 1;
+		}
 	}
 	
 	#if (SX1278_debug_mode > 1)
@@ -631,7 +1853,7 @@ int8_t SX1278::setMode(uint8_t mode)
 	#endif
 	
 	// Getting back to previous status
-	writeRegister(REG_OP_MODE, st0);	
+	setOpMode(st0);	
 	
 	return state;
 }
@@ -652,8 +1874,8 @@ uint8_t	SX1278::getHeader()
 		Serial.println(F("Starting 'getHeader'"));
 	#endif
 
-	// take out bit 2 from REG_MODEM_CONFIG1 indicates ImplicitHeaderModeOn
-	if( bitRead(REG_MODEM_CONFIG1, 0) == 0 )
+	// take out bit 0 from REG_MODEM_CONFIG1 indicates ImplicitHeaderModeOn
+	if( bitRead(readRegister(REG_MODEM_CONFIG1), 0) == 0 )
 	{ // explicit header mode (ON)
 		_header = HEADER_ON;
 		state = 1;
@@ -785,16 +2007,16 @@ int8_t	SX1278::setHeaderOFF()
 		// Read config1 to modify only the header bit
 		config1 = readRegister(REG_MODEM_CONFIG1);	
 		
-		// sets bit 2 from REG_MODEM_CONFIG1 = headerOFF
+		// sets bit 0 from REG_MODEM_CONFIG1 = headerOFF
 		config1 = config1 | B00000001;		
 		// Update config1		
 		writeRegister(REG_MODEM_CONFIG1,config1);		
 
 		// check register
 		config1 = readRegister(REG_MODEM_CONFIG1);
-		if( bitRead(config1, 2) == HEADER_OFF )
+		if( bitRead(config1, 0) == 1 )
 		{ 
-			// checking headerOFF taking out bit 2 from REG_MODEM_CONFIG1
+			// checking headerOFF taking out bit 0 from REG_MODEM_CONFIG1
 			state = 0;
 			_header = HEADER_OFF;
 
@@ -816,75 +2038,231 @@ int8_t	SX1278::setHeaderOFF()
 }
 
 /*
- Function: Indicates if module is configured with or without checking CRC.
+ Function: Sets a fixed payload length in implicit header mode. Only the payload
+           is sent, so both ends must agree on the length. ACKs can not be
+           sent or received with a fixed length, and the payload can not be
+           encrypted.
  Returns: Integer that determines if there has been any error
    state = 2  --> The command has not been executed
    state = 1  --> There has been an error while executing the command
    state = 0  --> The command has been executed with no errors
+   state = -1 --> Forbidden command for this protocol or with encryption
+ Parameters:
+   length: fixed payload length. '0' returns to explicit header mode.
 */
-uint8_t	SX1278::getCRC()
+int8_t	SX1278::setFixedLength(uint8_t length)
 {
 	int8_t state = 2;
-	byte value;
 
 	#if (SX1278_debug_mode > 1)
 		Serial.println();
-		Serial.println(F("Starting 'getCRC'"));
+		Serial.println(F("Starting 'setFixedLength'"));
 	#endif
 
-	if( _modem == LORA )
-	{ // LoRa mode
-
-		// take out bit 2 from REG_MODEM_CONFIG2 indicates RxPayloadCrcOn
-		value = readRegister(REG_MODEM_CONFIG2);
-		if( bitRead(value, 2) == CRC_OFF )
-		{ // CRCoff
-			_CRC = CRC_OFF;
-			#if (SX1278_debug_mode > 1)
-				Serial.println(F("## CRC is desactivated ##"));
-				Serial.println();
-			#endif
-			state = 0;
-		}
-		else
-		{ // CRCon
-			_CRC = CRC_ON;
-			#if (SX1278_debug_mode > 1)
-				Serial.println(F("## CRC is activated ##"));
-				Serial.println();
-			#endif
-			state = 0;
-		}
+	if( _modem == FSK )
+	{
+		state = -1;		// implicit header is not available in FSK mode
+		#if (SX1278_debug_mode > 1)
+			Serial.println(F("## Notice that FSK mode packets hasn't header ##"));
+			Serial.println();
+		#endif
 	}
-	else
-	{ // FSK mode
-
-		// take out bit 2 from REG_PACKET_CONFIG1 indicates CrcOn
-		value = readRegister(REG_PACKET_CONFIG1);
-		if( bitRead(value, 4) == CRC_OFF )
-		{ // CRCoff
-			_CRC = CRC_OFF;
-			#if (SX1278_debug_mode > 1)
-				Serial.println(F("## CRC is desactivated ##"));
-				Serial.println();
-			#endif
-			state = 0;
-		}
-		else
-		{ // CRCon
-			_CRC = CRC_ON;
-			#if (SX1278_debug_mode > 1)
-				Serial.println(F("## CRC is activated ##"));
-				Serial.println();
-			#endif
-			state = 0;
-		}
+	else if( length == 0 )
+	{ // Back to explicit header with addressing bytes
+		_fixedLength = 0;
+		state = setHeaderON();
 	}
-	if( state != 0 )
+	else if( _security != SECURITY_NONE )
 	{
-		state = 1;
+		state = -1;		// the payload would be sent in plaintext
 		#if (SX1278_debug_mode > 1)
-			Serial.println(F("** There has been an error while getting configured CRC **"));
+			Serial.println(F("** Fixed length is not available with encryption **"));
+			Serial.println();
+		#endif
+	}
+	else
+	{
+		state = setHeaderOFF();
+		if( state == 0 )
+		{
+			_fixedLength = length;
+			state = setPacketLength(length);
+		}
+		#if (SX1278_debug_mode > 1)
+			if( state == 0 )
+			{
+				Serial.print(F("## Fixed length "));
+				Serial.print(length, DEC);
+				Serial.println(F(" has been successfully set ##"));
+				Serial.println();
+			}
+		#endif
+	}
+	return state;
+}
+
+/*
+ Function: Sets the software frame format of the packets.
+ Returns: Integer that determines if there has been any error
+   state = 2  --> The command has not been executed
+   state = 1  --> There has been an error while executing the command
+   state = 0  --> The command has been executed with no errors
+   state = -1 --> Forbidden command for this protocol
+ Parameters:
+   format: FRAME_FORMAT_LEGACY or FRAME_FORMAT_COMPACT.
+*/
+int8_t	SX1278::setFrameFormat(uint8_t format)
+{
+	int8_t state = 2;
+
+	#if (SX1278_debug_mode > 1)
+		Serial.println();
+		Serial.println(F("Starting 'setFrameFormat'"));
+	#endif
+
+	if( _modem == FSK )
+	{
+		// compact format relies on the length of the LoRa header
+		state = -1;
+	}
+	else if( (format != FRAME_FORMAT_LEGACY) && (format != FRAME_FORMAT_COMPACT) )
+	{
+		state = 1;
+		#if (SX1278_debug_mode > 1)
+			Serial.println(F("** Unknown frame format **"));
+			Serial.println();
+		#endif
+	}
+	else
+	{
+		_frameFormat = format;
+		state = 0;
+		#if (SX1278_debug_mode > 1)
+			if( _frameFormat == FRAME_FORMAT_COMPACT )
+			{
+				Serial.println(F("## Compact frame format has been set ##"));
+			}
+			else
+			{
+				Serial.println(F("## Legacy frame format has been set ##"));
+			}
+			Serial.println();
+		#endif
+	}
+	return state;
+}
+
+/*
+ Function: Gets the number of framing bytes sent with the payload.
+ Returns: Number of bytes of the software header
+ Parameters:
+   dest: destination of the frame.
+*/
+uint8_t	SX1278::frameOverhead(uint8_t dest)
+{
+	if( (_modem == LORA) && (_frameFormat == FRAME_FORMAT_COMPACT) )
+	{
+		// format|src|packnum plus 'dst' when it is not a broadcast
+		if( dest == BROADCAST_0 )
+		{
+			return 3;
+		}
+		return 4;
+	}
+	return OFFSET_PAYLOADLENGTH;
+}
+
+/*
+ Function: Gets the largest number of bytes added to the payload before it
+           is sent: the codec byte of a payload that does not compress and
+           the security trailer.
+ Returns: Number of bytes added to the payload
+*/
+uint8_t	SX1278::payloadOverhead()
+{
+	uint8_t overhead = 0;
+
+	if( (_compression != COMPRESSION_NONE) && (_fixedLength == 0) )
+	{
+		overhead++;
+	}
+	if( _security != SECURITY_NONE )
+	{
+		overhead += SECURITY_OVERHEAD;
+	}
+	return overhead;
+}
+
+/*
+ Function: Indicates if module is configured with or without checking CRC.
+ Returns: Integer that determines if there has been any error
+   state = 2  --> The command has not been executed
+   state = 1  --> There has been an error while executing the command
+   state = 0  --> The command has been executed with no errors
+*/
+uint8_t	SX1278::getCRC()
+{
+	int8_t state = 2;
+	byte value;
+
+	#if (SX1278_debug_mode > 1)
+		Serial.println();
+		Serial.println(F("Starting 'getCRC'"));
+	#endif
+
+	if( _modem == LORA )
+	{ // LoRa mode
+
+		// take out bit 2 from REG_MODEM_CONFIG2 indicates RxPayloadCrcOn
+		value = readRegister(REG_MODEM_CONFIG2);
+		if( bitRead(value, 2) == CRC_OFF )
+		{ // CRCoff
+			_CRC = CRC_OFF;
+			#if (SX1278_debug_mode > 1)
+				Serial.println(F("## CRC is desactivated ##"));
+				Serial.println();
+			#endif
+			state = 0;
+		}
+		else
+		{ // CRCon
+			_CRC = CRC_ON;
+			#if (SX1278_debug_mode > 1)
+				Serial.println(F("## CRC is activated ##"));
+				Serial.println();
+			#endif
+			state = 0;
+		}
+	}
+	else
+	{ // FSK mode
+
+		// take out bit 2 from REG_PACKET_CONFIG1 indicates CrcOn
+		value = readRegister(REG_PACKET_CONFIG1);
+		if( bitRead(value, 4) == CRC_OFF )
+		{ // CRCoff
+			_CRC = CRC_OFF;
+			#if (SX1278_debug_mode > 1)
+				Serial.println(F("## CRC is desactivated ##"));
+				Serial.println();
+			#endif
+			state = 0;
+		}
+		else
+		{ // CRCon
+			_CRC = CRC_ON;
+			#if (SX1278_debug_mode > 1)
+				Serial.println(F("## CRC is activated ##"));
+				Serial.println();
+			#endif
+			state = 0;
+		}
+	}
+	if( state != 0 )
+	{
+		state = 1;
+		#if (SX1278_debug_mode > 1)
+			Serial.println(F("** There has been an error while getting configured CRC **"));
 			Serial.println();
 		#endif
 	}
@@ -1121,7 +2499,7 @@ uint8_t	SX1278::setSF(uint8_t spr)
 		Serial.println(F("Starting 'setSF'"));
 	#endif
 
-	st0 = readRegister(REG_OP_MODE);	// Save the previous status
+	st0 = _opMode;	// Save the previous status
 
 	if( _modem == FSK )
 	{
@@ -1136,7 +2514,7 @@ uint8_t	SX1278::setSF(uint8_t spr)
 	{ 
 		/// LoRa mode
 		// LoRa standby mode
-		writeRegister(REG_OP_MODE, LORA_STANDBY_MODE);	
+		setOpMode(LORA_STANDBY_MODE);	
 		
 		// Read config2 to modify SF value (bits 7-4)
 		config2 = (readRegister(REG_MODEM_CONFIG2));
@@ -1289,7 +2667,7 @@ uint8_t	SX1278::setSF(uint8_t spr)
 	}
   }
 
-  writeRegister(REG_OP_MODE, st0);	// Getting back to previous status
+  setOpMode(st0);	// Getting back to previous status
 
   if( isSF(spr) )
   { // Checking available value for _spreadingFactor
@@ -1427,7 +2805,7 @@ int8_t	SX1278::setBW(uint16_t band)
 	  Serial.println(F("Starting 'setBW'"));
   #endif
 
-  st0 = readRegister(REG_OP_MODE);	// Save the previous status
+  st0 = _opMode;	// Save the previous status
 
   if( _modem == FSK )
   {
@@ -1437,7 +2815,7 @@ int8_t	SX1278::setBW(uint16_t band)
 	  #endif
 	  state = setLORA();
   }
-  writeRegister(REG_OP_MODE, LORA_STANDBY_MODE);	// LoRa standby mode
+  setOpMode(LORA_STANDBY_MODE);	// LoRa standby mode
   config1 = (readRegister(REG_MODEM_CONFIG1));	// Save config1 to modify the BW
   config3 = (readRegister(REG_MODEM_CONFIG3));	// Save config3 to modify the Low Data Rate Optimization
   switch(band)
@@ -1810,7 +3188,7 @@ int8_t	SX1278::setBW(uint16_t band)
 		  Serial.println();
 	  #endif
   }
-  writeRegister(REG_OP_MODE, st0);	// Getting back to previous status
+  setOpMode(st0);	// Getting back to previous status
   return state;
 }
 
@@ -1914,7 +3292,7 @@ int8_t	SX1278::setCR(uint8_t cod)
 	  Serial.println(F("Starting 'setCR'"));
   #endif
 
-  st0 = readRegister(REG_OP_MODE);		// Save the previous status
+  st0 = _opMode;		// Save the previous status
 
   if( _modem == FSK )
   {
@@ -1926,7 +3304,7 @@ int8_t	SX1278::setCR(uint8_t cod)
   }
   else
   {
-	  writeRegister(REG_OP_MODE, LORA_STANDBY_MODE);		// Set Standby mode to write in registers
+	  setOpMode(LORA_STANDBY_MODE);		// Set Standby mode to write in registers
 
 	  config1 = readRegister(REG_MODEM_CONFIG1);	// Save config1 to modify only the CR
 	  switch(cod)
@@ -1991,7 +3369,7 @@ int8_t	SX1278::setCR(uint8_t cod)
 		  Serial.println();
 	  #endif
   }
-  writeRegister(REG_OP_MODE,st0);	// Getting back to previous status
+  setOpMode(st0);	// Getting back to previous status
   return state;
 }
 
@@ -2127,48 +3505,35 @@ int8_t SX1278::setChannel(uint32_t ch)
 {
   byte st0;
   int8_t state = 2;
-  unsigned int freq3;
-  unsigned int freq2;
-  uint8_t freq1;
-  uint32_t freq;
+  uint8_t frf[3];
 
   #if (SX1278_debug_mode > 1)
 	  Serial.println();
 	  Serial.println(F("Starting 'setChannel'"));
   #endif
 
-  st0 = readRegister(REG_OP_MODE);	// Save the previous status
+  st0 = _opMode;	// Save the previous status
   if( _modem == LORA )
   {
 	  // LoRa Stdby mode in order to write in registers
-	  writeRegister(REG_OP_MODE, LORA_STANDBY_MODE);
+	  setOpMode(LORA_STANDBY_MODE);
   }
   else
   {
 	  // FSK Stdby mode in order to write in registers
-	  writeRegister(REG_OP_MODE, FSK_STANDBY_MODE);
+	  setOpMode(FSK_STANDBY_MODE);
   }
 
-  freq3 = ((ch >> 16) & 0x0FF);		// frequency channel MSB
-  freq2 = ((ch >> 8) & 0x0FF);		// frequency channel MIB
-  freq1 = (ch & 0xFF);				// frequency channel LSB
-
-  writeRegister(REG_FRF_MSB, freq3);
-  writeRegister(REG_FRF_MID, freq2);
-  writeRegister(REG_FRF_LSB, freq1);
-
-  // storing MSB in freq channel value
-  freq3 = (readRegister(REG_FRF_MSB));
-  freq = (freq3 << 8) & 0xFFFFFF;
-
-  // storing MID in freq channel value
-  freq2 = (readRegister(REG_FRF_MID));
-  freq = (freq << 8) + ((freq2 << 8) & 0xFFFFFF);
+  frf[0] = ((ch >> 16) & 0x0FF);		// frequency channel MSB
+  frf[1] = ((ch >> 8) & 0x0FF);		// frequency channel MIB
+  frf[2] = (ch & 0xFF);				// frequency channel LSB
 
-  // storing LSB in freq channel value
-  freq = freq + ((readRegister(REG_FRF_LSB)) & 0xFFFFFF);
+  // MSB, MID and LSB are contiguous: one burst to write them, the
+  // frequency is changed when the LSB is written
+  writeRegisters(REG_FRF_MSB, frf, 3);
 
-  if( freq == ch )
+  // and one burst to read them back
+  if( checkRegisters(REG_FRF_MSB, frf, 3) )
   {
     state = 0;
     _channel = ch;
@@ -2195,10 +3560,170 @@ int8_t SX1278::setChannel(uint32_t ch)
 	 #endif
   }
 
-  writeRegister(REG_OP_MODE, st0);	// Getting back to previous status
+  setOpMode(st0);	// Getting back to previous status
   return state;
 }
 
+/*
+ Function: Sets the intra-packet frequency hopping (FHSS) in LoRa mode. Long
+   frames hop across 'channels' every 'period' symbols, the first channel
+   of the list is used for the preamble and the header.
+ Returns: Integer that determines if there has been any error
+   state = 2  --> The command has not been executed
+   state = 1  --> There has been an error while executing the command
+   state = 0  --> The command has been executed with no errors
+   state = -1 --> Forbidden command for this protocol or invalid channels
+                  or period
+ Parameters:
+   channels: list of frequency channels to hop across.
+   number: number of channels in the list.
+   period: symbol periods between frequency hops.
+*/
+int8_t SX1278::setFHSS(const uint32_t *channels, uint8_t number, uint8_t period)
+{
+	byte st0;
+	int8_t state = 2;
+
+	#if (SX1278_debug_mode > 1)
+		Serial.println();
+		Serial.println(F("Starting 'setFHSS'"));
+	#endif
+
+	if( _modem == FSK )
+	{
+		state = -1;		// FHSS is only available in LoRa mode
+		#if (SX1278_debug_mode > 1)
+			Serial.println(F("** FSK mode hasn't frequency hopping **"));
+			Serial.println();
+		#endif
+		return state;
+	}
+
+	if( (number < 2) || (number > MAX_HOP_CHANNELS) || (period == 0) )
+	{
+		state = -1;
+		#if (SX1278_debug_mode > 1)
+			Serial.println(F("** FHSS needs from 2 to 16 channels and a period > 0 **"));
+			Serial.println();
+		#endif
+		return state;
+	}
+
+	for(uint8_t i = 0; i < number; i++)
+	{
+		if( not isChannel(channels[i]) )
+		{
+			state = -1;
+			#if (SX1278_debug_mode > 1)
+				Serial.print(F("** Frequency channel "));
+				Serial.print(channels[i], HEX);
+				Serial.println(F(" is not a correct value **"));
+				Serial.println();
+			#endif
+			return state;
+		}
+		_hopChannels[i] = channels[i];
+	}
+	_hopChannelsNb = number;
+
+	st0 = _opMode;	// Save the previous status
+	setOpMode(LORA_STANDBY_MODE);	// LoRa standby mode
+
+	writeRegister(REG_HOP_PERIOD, period);
+	if( readRegister(REG_HOP_PERIOD) == period )
+	{
+		_hopPeriod = period;
+		state = 0;
+		#if (SX1278_debug_mode > 1)
+			Serial.print(F("## FHSS set with "));
+			Serial.print(number, DEC);
+			Serial.print(F(" channels every "));
+			Serial.print(period, DEC);
+			Serial.println(F(" symbols ##"));
+			Serial.println();
+		#endif
+	}
+	else
+	{
+		_hopPeriod = 0;
+		state = 1;
+	}
+
+	setOpMode(st0);	// Getting back to previous status
+
+	if( state == 0 )
+	{
+		// preamble and header are always sent in the first channel
+		state = setChannel(_hopChannels[0]);
+	}
+	return state;
+}
+
+/*
+ Function: Disables the intra-packet frequency hopping.
+ Returns: Integer that determines if there has been any error
+   state = 2  --> The command has not been executed
+   state = 1  --> There has been an error while executing the command
+   state = 0  --> The command has been executed with no errors
+   state = -1 --> Forbidden command for this protocol
+*/
+int8_t SX1278::setFHSS_OFF()
+{
+	byte st0;
+	int8_t state = 2;
+
+	#if (SX1278_debug_mode > 1)
+		Serial.println();
+		Serial.println(F("Starting 'setFHSS_OFF'"));
+	#endif
+
+	st0 = _opMode;	// Save the previous status
+	if( _modem == LORA )
+	{
+		setOpMode(LORA_STANDBY_MODE);	// LoRa standby mode
+		writeRegister(REG_HOP_PERIOD, 0x00);
+		setOpMode(st0);	// Getting back to previous status
+		state = 0;
+	}
+	else
+	{
+		state = -1;		// FHSS is only available in LoRa mode
+	}
+	_hopPeriod = 0;
+	_hopChannelsNb = 0;
+	return state;
+}
+
+/*
+ Function: Services the FhssChangeChannel interruption. The modem counts the
+   hops in REG_HOP_CHANNEL, so the next frequency of the list is written in
+   the FRF registers (allowed in Tx/Rx while hopping) and the flag is cleared.
+ Returns: Nothing
+*/
+void SX1278::hopChannel()
+{
+	uint32_t ch;
+	uint8_t index;
+
+	if( _hopChannelsNb == 0 )
+	{
+		// Clearing FhssChangeChannel flag
+		writeRegister(REG_IRQ_FLAGS, B00000010);
+		return;
+	}
+
+	// FhssPresentChannel: bits 5-0 from REG_HOP_CHANNEL
+	index = (readRegister(REG_HOP_CHANNEL) & B00111111) % _hopChannelsNb;
+	ch = _hopChannels[index];
+
+	writeRegister(REG_FRF_MSB, (ch >> 16) & 0xFF);
+	writeRegister(REG_FRF_MID, (ch >> 8) & 0xFF);
+	writeRegister(REG_FRF_LSB, ch & 0xFF);
+
+	// Clearing FhssChangeChannel flag
+	writeRegister(REG_IRQ_FLAGS, B00000010);
+}
+
 /*
  Function: Gets the signal power within the module is configured.
  Returns: Integer that determines if there has been any error
@@ -2252,21 +3777,20 @@ int8_t SX1278::setPower(char p)
 {
   byte st0;
   int8_t state = 2;
-  byte value = 0x00;
 
   #if (SX1278_debug_mode > 1)
 	  Serial.println();
 	  Serial.println(F("Starting 'setPower'"));
   #endif
 
-  st0 = readRegister(REG_OP_MODE);	  // Save the previous status
+  st0 = _opMode;	  // Save the previous status
   if( _modem == LORA )
   { // LoRa Stdby mode to write in registers
-	  writeRegister(REG_OP_MODE, LORA_STANDBY_MODE);
+	  setOpMode(LORA_STANDBY_MODE);
   }
   else
   { // FSK Stdby mode to write in registers
-	  writeRegister(REG_OP_MODE, FSK_STANDBY_MODE);
+	  setOpMode(FSK_STANDBY_MODE);
   }
 
   writeRegister(REG_PA_DAC, 0x84);
@@ -2296,9 +3820,8 @@ int8_t SX1278::setPower(char p)
   }
 
   writeRegister(REG_PA_CONFIG, _power);	// Setting output power value
-  value = readRegister(REG_PA_CONFIG);
 
-  if( value == _power )
+  if( checkRegisters(REG_PA_CONFIG, &_power, 1) )
   {
 	  state = 0;
 	  #if (SX1278_debug_mode > 1)
@@ -2311,7 +3834,7 @@ int8_t SX1278::setPower(char p)
 	  state = 1;
   }
 
-  writeRegister(REG_OP_MODE, st0);	// Getting back to previous status
+  setOpMode(st0);	// Getting back to previous status
   return state;
 }
 
@@ -2330,21 +3853,20 @@ int8_t SX1278::setPowerNum(uint8_t pow)
 {
   byte st0;
   int8_t state = 2;
-  byte value = 0x00;
 
   #if (SX1278_debug_mode > 1)
 	  Serial.println();
 	  Serial.println(F("Starting 'setPower'"));
   #endif
 
-  st0 = readRegister(REG_OP_MODE);	  // Save the previous status
+  st0 = _opMode;	  // Save the previous status
   if( _modem == LORA )
   { // LoRa Stdby mode to write in registers
-	  writeRegister(REG_OP_MODE, LORA_STANDBY_MODE);
+	  setOpMode(LORA_STANDBY_MODE);
   }
   else
   { // FSK Stdby mode to write in registers
-	  writeRegister(REG_OP_MODE, FSK_STANDBY_MODE);
+	  setOpMode(FSK_STANDBY_MODE);
   }
   
   if ( (pow >= 2) && (pow <= 20) )
@@ -2368,9 +3890,8 @@ int8_t SX1278::setPowerNum(uint8_t pow)
   }
 
   writeRegister(REG_PA_CONFIG, _power);	// Setting output power value
-  value = readRegister(REG_PA_CONFIG);
 
-  if( value == _power )
+  if( checkRegisters(REG_PA_CONFIG, &_power, 1) )
   {
 	  state = 0;
 	  #if (SX1278_debug_mode > 1)
@@ -2383,7 +3904,7 @@ int8_t SX1278::setPowerNum(uint8_t pow)
 	  state = 1;
   }
 
-  writeRegister(REG_OP_MODE, st0);	// Getting back to previous status
+  setOpMode(st0);	// Getting back to previous status
   return state;
 }
 
@@ -2452,7 +3973,8 @@ uint8_t SX1278::getPreambleLength()
 uint8_t SX1278::setPreambleLength(uint16_t l)
 {
 	byte st0;
-	uint8_t p_length;
+	uint8_t p_length[2];
+	boolean verified;
 	int8_t state = 2;
 
 	#if (SX1278_debug_mode > 1)
@@ -2460,38 +3982,40 @@ uint8_t SX1278::setPreambleLength(uint16_t l)
 		Serial.println(F("Starting 'setPreambleLength'"));
 	#endif
 
-	st0 = readRegister(REG_OP_MODE);	// Save the previous status
+	st0 = _opMode;	// Save the previous status
 	state = 1;
 	if( _modem == LORA )
   	{ // LoRa mode
-  		writeRegister(REG_OP_MODE, LORA_STANDBY_MODE);    // Set Standby mode to write in registers
-  		p_length = ((l >> 8) & 0x0FF);
-  		// Storing MSB preamble length in LoRa mode
-		writeRegister(REG_PREAMBLE_MSB_LORA, p_length);
-		p_length = (l & 0x0FF);
-		// Storing LSB preamble length in LoRa mode
-		writeRegister(REG_PREAMBLE_LSB_LORA, p_length);
+  		setOpMode(LORA_STANDBY_MODE);    // Set Standby mode to write in registers
+  		p_length[0] = ((l >> 8) & 0x0FF);
+		p_length[1] = (l & 0x0FF);
+		// Storing MSB and LSB preamble length in LoRa mode
+		writeRegisters(REG_PREAMBLE_MSB_LORA, p_length, 2);
+		verified = checkRegisters(REG_PREAMBLE_MSB_LORA, p_length, 2);
 	}
 	else
 	{ // FSK mode
-		writeRegister(REG_OP_MODE, FSK_STANDBY_MODE);    // Set Standby mode to write in registers
-		p_length = ((l >> 8) & 0x0FF);
-  		// Storing MSB preamble length in FSK mode
-		writeRegister(REG_PREAMBLE_MSB_FSK, p_length);
-		p_length = (l & 0x0FF);
-  		// Storing LSB preamble length in FSK mode
-		writeRegister(REG_PREAMBLE_LSB_FSK, p_length);
+		setOpMode(FSK_STANDBY_MODE);    // Set Standby mode to write in registers
+		p_length[0] = ((l >> 8) & 0x0FF);
+		p_length[1] = (l & 0x0FF);
+  		// Storing MSB and LSB preamble length in FSK mode
+		writeRegisters(REG_PREAMBLE_MSB_FSK, p_length, 2);
+		verified = checkRegisters(REG_PREAMBLE_MSB_FSK, p_length, 2);
 	}
 
-	state = 0;
-	#if (SX1278_debug_mode > 1)
-		Serial.print(F("## Preamble length "));
-		Serial.print(l, HEX);
-		Serial.println(F(" has been successfully set ##"));
-		Serial.println();
-	#endif
+	_preamblelength = l;
+	if( verified )
+	{
+		state = 0;
+		#if (SX1278_debug_mode > 1)
+			Serial.print(F("## Preamble length "));
+			Serial.print(l, HEX);
+			Serial.println(F(" has been successfully set ##"));
+			Serial.println();
+		#endif
+	}
 
-	writeRegister(REG_OP_MODE, st0);	// Getting back to previous status
+	setOpMode(st0);	// Getting back to previous status
 	return state;
 }
 
@@ -2547,13 +4071,29 @@ int8_t SX1278::setPacketLength()
 {
 	uint16_t length;
 
-	length = _payloadlength + OFFSET_PAYLOADLENGTH;
-	return setPacketLength(length);
-}
-
-/*
- Function: Sets the packet length in the module.
- Returns: Integer that determines if there has been any error
+	if( _fixedLength != 0 )
+	{ // Implicit header: the length is fixed on both sides
+		length = _fixedLength;
+	}
+	else
+	{
+		length = _payloadlength + frameOverhead(packet_sent.dst);
+	}
+	if( length > MAX_LENGTH )
+	{
+		// The length field of the frame and REG_PAYLOAD_LENGTH are 8 bits
+		#if (SX1278_debug_mode > 1)
+			Serial.println(F("** Packet length must be less than 256 **"));
+			Serial.println();
+		#endif
+		return 1;
+	}
+	return setPacketLength(length);
+}
+
+/*
+ Function: Sets the packet length in the module.
+ Returns: Integer that determines if there has been any error
    state = 2  --> The command has not been executed
    state = 1  --> There has been an error while executing the command
    state = 0  --> The command has been executed with no errors
@@ -2564,7 +4104,7 @@ int8_t SX1278::setPacketLength()
 int8_t SX1278::setPacketLength(uint8_t l)
 {
 	byte st0;
-	byte value = 0x00;
+	boolean verified;
 	int8_t state = 2;
 
 	#if (SX1278_debug_mode > 1)
@@ -2572,27 +4112,27 @@ int8_t SX1278::setPacketLength(uint8_t l)
 		Serial.println(F("Starting 'setPacketLength'"));
 	#endif
 
-	st0 = readRegister(REG_OP_MODE);	// Save the previous status
+	st0 = _opMode;	// Save the previous status
 	//----
 	//	truncPayload(l);
 	packet_sent.length = l;
 	//
 	if( _modem == LORA )
   	{ // LORA mode
-  		writeRegister(REG_OP_MODE, LORA_STANDBY_MODE);    // Set LoRa Standby mode to write in registers
+  		setOpMode(LORA_STANDBY_MODE);    // Set LoRa Standby mode to write in registers
 		writeRegister(REG_PAYLOAD_LENGTH_LORA, packet_sent.length);
 		// Storing payload length in LoRa mode
-		value = readRegister(REG_PAYLOAD_LENGTH_LORA);
+		verified = checkRegisters(REG_PAYLOAD_LENGTH_LORA, &packet_sent.length, 1);
 	}
 	else
 	{ // FSK mode
-		writeRegister(REG_OP_MODE, FSK_STANDBY_MODE);    //  Set FSK Standby mode to write in registers
+		setOpMode(FSK_STANDBY_MODE);    //  Set FSK Standby mode to write in registers
 		writeRegister(REG_PAYLOAD_LENGTH_FSK, packet_sent.length);
 		// Storing payload length in FSK mode
-		value = readRegister(REG_PAYLOAD_LENGTH_FSK);
+		verified = checkRegisters(REG_PAYLOAD_LENGTH_FSK, &packet_sent.length, 1);
 	}
 
-	if( packet_sent.length == value )
+	if( verified )
 	{
 		state = 0;
 		#if (SX1278_debug_mode > 1)
@@ -2607,7 +4147,7 @@ int8_t SX1278::setPacketLength(uint8_t l)
 		state = 1;
 	}
 
-	writeRegister(REG_OP_MODE, st0);	// Getting back to previous status
+	setOpMode(st0);	// Getting back to previous status
   	//delay(250);
 	return state;
 }
@@ -2638,16 +4178,16 @@ uint8_t SX1278::getNodeAddress()
 	else
 	{
 		// FSK mode
-		st0 = readRegister(REG_OP_MODE);	// Save the previous status
+		st0 = _opMode;	// Save the previous status
 		
 		// Allowing access to FSK registers while in LoRa standby mode
-		writeRegister(REG_OP_MODE, LORA_STANDBY_FSK_REGS_MODE);
+		setOpMode(LORA_STANDBY_FSK_REGS_MODE);
 
 		// Read node address
 		_nodeAddress = readRegister(REG_NODE_ADRS);		
 		
 		// Getting back to previous status
-		writeRegister(REG_OP_MODE, st0);	
+		setOpMode(st0);	
 		
 		// update state
 		state = 0;
@@ -2668,14 +4208,15 @@ uint8_t SX1278::getNodeAddress()
    state = 2  --> The command has not been executed
    state = 1  --> There has been an error while executing the command
    state = 0  --> The command has been executed with no errors
-   state = -1 --> Forbidden command for this protocol
+   state = -1 --> The address is reserved for groups (0xE0 to 0xFF)
  Parameters:
    addr: address value to set as node address.
 */
 int8_t SX1278::setNodeAddress(uint8_t addr)
 {
 	byte st0;
-	byte value;
+	uint8_t value[2];
+	boolean verified;
 	uint8_t state = 2;
 
 	#if (SX1278_debug_mode > 1)
@@ -2683,12 +4224,12 @@ int8_t SX1278::setNodeAddress(uint8_t addr)
 		Serial.println(F("Starting 'setNodeAddress'"));
 	#endif
 
-	// check address value is within valid range
-	if( addr > 255 )
+	// check address value is within valid range, group addresses are reserved
+	if( isGroupAddress(addr) )
 	{
 		state = -1;
 		#if (SX1278_debug_mode > 1)
-			Serial.println(F("** Node address must be less than 255 **"));
+			Serial.println(F("** Node address must be less than 0xE0 **"));
 			Serial.println();
 		#endif
 	}
@@ -2696,7 +4237,7 @@ int8_t SX1278::setNodeAddress(uint8_t addr)
 	{
 		// Saving node address
 		_nodeAddress = addr;
-		st0 = readRegister(REG_OP_MODE);	  // Save the previous status
+		st0 = _opMode;	  // Save the previous status
 
 		// in LoRa mode
 		state = 0;
@@ -2710,16 +4251,17 @@ int8_t SX1278::setNodeAddress(uint8_t addr)
 		else if( _modem == FSK )
 		{ 
 			//Set FSK Standby mode to write in registers
-			writeRegister(REG_OP_MODE, FSK_STANDBY_MODE);		
+			setOpMode(FSK_STANDBY_MODE);		
 
 			// Storing node and broadcast address
-			writeRegister(REG_NODE_ADRS, addr);
-			writeRegister(REG_BROADCAST_ADRS, BROADCAST_0);
+			value[0] = addr;
+			value[1] = BROADCAST_0;
+			writeRegisters(REG_NODE_ADRS, value, 2);
 
-			value = readRegister(REG_NODE_ADRS);
-			writeRegister(REG_OP_MODE, st0);		// Getting back to previous status
+			verified = checkRegisters(REG_NODE_ADRS, value, 2);
+			setOpMode(st0);		// Getting back to previous status
 
-			if( value == _nodeAddress )
+			if( verified )
 			{
 				state = 0;
 				#if (SX1278_debug_mode > 1)
@@ -2742,6 +4284,147 @@ int8_t SX1278::setNodeAddress(uint8_t addr)
 	return state;
 }
 
+/*
+ Function: Joins a multicast group.
+ Returns: Integer that determines if there has been any error
+   state = 2  --> The command has not been executed
+   state = 1  --> There has been an error while executing the command
+   state = 0  --> The command has been executed with no errors
+   state = -1 --> Forbidden command for this protocol
+ Parameters:
+   group: group address, from MULTICAST_FIRST to 255.
+*/
+int8_t SX1278::addGroup(uint8_t group)
+{
+	int8_t state = 2;
+
+	#if (SX1278_debug_mode > 1)
+		Serial.println();
+		Serial.println(F("Starting 'addGroup'"));
+	#endif
+
+	if( !isGroupAddress(group) )
+	{
+		state = -1;
+		#if (SX1278_debug_mode > 1)
+			Serial.println(F("** Group address must be from 0xE0 to 0xFF **"));
+			Serial.println();
+		#endif
+	}
+	else
+	{
+		bitSet(_groups, group - MULTICAST_FIRST);
+		state = setAddressFilter();
+	}
+	return state;
+}
+
+/*
+ Function: Leaves a multicast group.
+ Returns: Integer that determines if there has been any error
+   state = 2  --> The command has not been executed
+   state = 1  --> There has been an error while executing the command
+   state = 0  --> The command has been executed with no errors
+   state = -1 --> Forbidden command for this protocol
+ Parameters:
+   group: group address, from MULTICAST_FIRST to 255.
+*/
+int8_t SX1278::removeGroup(uint8_t group)
+{
+	int8_t state = 2;
+
+	#if (SX1278_debug_mode > 1)
+		Serial.println();
+		Serial.println(F("Starting 'removeGroup'"));
+	#endif
+
+	if( !isGroupAddress(group) )
+	{
+		state = -1;
+	}
+	else
+	{
+		bitClear(_groups, group - MULTICAST_FIRST);
+		state = setAddressFilter();
+	}
+	return state;
+}
+
+/*
+ Function: Indicates if an address is a multicast group address.
+*/
+boolean SX1278::isGroupAddress(uint8_t addr)
+{
+	return (addr >= MULTICAST_FIRST);
+}
+
+/*
+ Function: Indicates if a frame sent to 'dest' is not acknowledged, that is,
+           if it is sent to the broadcast address or to a group.
+*/
+boolean SX1278::isMulticast(uint8_t dest)
+{
+	return ((dest == BROADCAST_0) || isGroupAddress(dest));
+}
+
+/*
+ Function: Indicates if a frame sent to 'dest' must be received by this node.
+*/
+boolean SX1278::isForMe(uint8_t dest)
+{
+	if( (dest == _nodeAddress) || (dest == BROADCAST_0) )
+	{
+		return true;
+	}
+	return (isGroupAddress(dest) && (bitRead(_groups, dest - MULTICAST_FIRST) == 1));
+}
+
+/*
+ Function: Sets the FSK address filtering with the node and broadcast
+           addresses. The hardware only knows these two addresses, so it is
+           disabled while the node belongs to a group and 'availableData'
+           filters the frames.
+ Returns: Integer that determines if there has been any error
+   state = 2  --> The command has not been executed
+   state = 1  --> There has been an error while executing the command
+   state = 0  --> The command has been executed with no errors
+*/
+int8_t SX1278::setAddressFilter()
+{
+	int8_t state = 2;
+	byte st0;
+	byte config1;
+
+	if( _modem == LORA )
+	{
+		// in LoRa mode, address is SW controlled
+		return 0;
+	}
+
+	st0 = _opMode;	// Save the previous status
+	setOpMode(FSK_STANDBY_MODE);	// Set FSK Standby mode to write in registers
+	// Foreign frames are dropped by the packet handler before PayloadReady
+	writeRegister(REG_NODE_ADRS, _nodeAddress);
+	writeRegister(REG_BROADCAST_ADRS, BROADCAST_0);
+	config1 = readRegister(REG_PACKET_CONFIG1);
+	config1 = config1 & B11111001;		// clears AddressFiltering bits
+	if( _groups == 0 )
+	{
+		config1 = config1 | B00000100;	// AddressFiltering = NodeAddress + BroadcastAddress
+	}
+	writeRegister(REG_PACKET_CONFIG1, config1);
+	if( readRegister(REG_PACKET_CONFIG1) == config1 )
+	{
+		state = 0;
+	}
+	else
+	{
+		state = 1;
+	}
+	setOpMode(st0);	// Getting back to previous status
+	return state;
+}
+
 /*
  Function: Gets the SNR value in LoRa mode.
  Returns: Integer that determines if there has been any error
@@ -3040,17 +4723,17 @@ int8_t SX1278::setMaxCurrent(uint8_t rate)
 		rate |= B00100000;
 		
 		state = 1;
-		st0 = readRegister(REG_OP_MODE);	// Save the previous status
+		st0 = _opMode;	// Save the previous status
 		if( _modem == LORA )
 		{ // LoRa mode
-			writeRegister(REG_OP_MODE, LORA_STANDBY_MODE);	// Set LoRa Standby mode to write in registers
+			setOpMode(LORA_STANDBY_MODE);	// Set LoRa Standby mode to write in registers
 		}
 		else
 		{ // FSK mode
-			writeRegister(REG_OP_MODE, FSK_STANDBY_MODE);	// Set FSK Standby mode to write in registers
+			setOpMode(FSK_STANDBY_MODE);	// Set FSK Standby mode to write in registers
 		}
 		writeRegister(REG_OCP, rate);		// Modifying maximum current supply
-		writeRegister(REG_OP_MODE, st0);		// Getting back to previous status
+		setOpMode(st0);		// Getting back to previous status
 		state = 0;
 	}
 	return state;
@@ -3230,16 +4913,28 @@ uint8_t SX1278::setACK()
 		Serial.println();
 		Serial.println(F("Starting 'setACK'"));
 	#endif
+	SX1278_TIME_CALL(INSTR_SET_ACK);
+	SX1278_TRACE(TRACE_CALL, 0, INSTR_SET_ACK);
+
+	// ACKs have addressing bytes, a fixed length peer can not decode them
+	if( _fixedLength != 0 )
+	{
+		#if (SX1278_debug_mode > 1)
+			Serial.println(F("** ACKs are not available with a fixed length **"));
+			Serial.println();
+		#endif
+		return 1;
+	}
 
 	clearFlags();	// Initializing flags
 
 	if( _modem == LORA )
 	{ // LoRa mode
-		writeRegister(REG_OP_MODE, LORA_STANDBY_MODE);	// Stdby LoRa mode to write in FIFO
+		setOpMode(LORA_STANDBY_MODE);	// Stdby LoRa mode to write in FIFO
 	}
 	else
 	{ // FSK mode
-		writeRegister(REG_OP_MODE, FSK_STANDBY_MODE);	// Stdby FSK mode to write in FIFO
+		setOpMode(FSK_STANDBY_MODE);	// Stdby FSK mode to write in FIFO
 	}
 
 	// Setting ACK length in order to send it
@@ -3253,18 +4948,31 @@ uint8_t SX1278::setACK()
 		ACK.packnum = packet_received.packnum; // packet number that has been correctly received
 		ACK.length = 0;		  // length = 0 to show that's an ACK
 		ACK.data[0] = _reception;	// CRC of the received packet
+		_txDest = ACK.dst;
 
 		// Setting address pointer in FIFO data buffer
 		writeRegister(REG_FIFO_ADDR_PTR, 0x00);
 		writeRegister(REG_FIFO_TX_BASE_ADDR, 0x00);  
+		_txArmed = false;	// The ACK overwrites the armed packet
 
 		state = 1;
 
 		// Writing ACK to send in FIFO
-		writeRegister(REG_FIFO, ACK.dst); 		// Writing the destination in FIFO
-		writeRegister(REG_FIFO, ACK.src);		// Writing the source in FIFO
-		writeRegister(REG_FIFO, ACK.packnum);	// Writing the packet number in FIFO
-		writeRegister(REG_FIFO, ACK.length); 	// Writing the packet length in FIFO
+		if( (_modem == LORA) && (_frameFormat == FRAME_FORMAT_COMPACT) )
+		{
+			// Compact format: the ACK flag replaces the length field
+			writeRegister(REG_FIFO, FRAME_VERSION_COMPACT | FRAME_FLAG_ACK);
+			writeRegister(REG_FIFO, ACK.dst); 		// Writing the destination in FIFO
+			writeRegister(REG_FIFO, ACK.src);		// Writing the source in FIFO
+			writeRegister(REG_FIFO, ACK.packnum);	// Writing the packet number in FIFO
+		}
+		else
+		{
+			writeRegister(REG_FIFO, ACK.dst); 		// Writing the destination in FIFO
+			writeRegister(REG_FIFO, ACK.src);		// Writing the source in FIFO
+			writeRegister(REG_FIFO, ACK.packnum);	// Writing the packet number in FIFO
+			writeRegister(REG_FIFO, ACK.length); 	// Writing the packet length in FIFO
+		}
 		writeRegister(REG_FIFO, ACK.data[0]);	// Writing the ACK in FIFO
 
 		#if (SX1278_debug_mode > 0)
@@ -3288,6 +4996,7 @@ uint8_t SX1278::setACK()
 		_reception = CORRECT_PACKET;		// Updating value to next packet
 
 		delay(500);
+		SX1278_COUNT_N(ackDelay, 500);
 	}
 	return state;
 }
@@ -3310,6 +5019,10 @@ uint8_t SX1278::receive()
 
 	// Initializing packet_received struct
 	memset( &packet_received, 0x00, sizeof(packet_received) );	
+	_txArmed = false;	// The received packet overwrites the armed one
+
+	// Registers can be written in sleep mode but the wake up is accounted
+	wake();
 
 	// Setting Testmode
 	writeRegister(0x31,0x43);
@@ -3317,21 +5030,34 @@ uint8_t SX1278::receive()
 	writeRegister(REG_PA_RAMP, 0x09);
 	// Set LNA gain: Highest gain. LnaBoost:Improved sensitivity
 	writeRegister(REG_LNA, 0x23);
-	// Setting address pointer in FIFO data buffer		
-	writeRegister(REG_FIFO_ADDR_PTR, 0x00);  	
+	// Setting the base address of the reception area in FIFO data buffer
+	writeRegister(REG_FIFO_RX_BASE_ADDR, 0x00);
+	// Setting address pointer in FIFO data buffer
+	writeRegister(REG_FIFO_ADDR_PTR, 0x00);
 	// change RegSymbTimeoutLsb 
 	writeRegister(REG_SYMB_TIMEOUT_LSB, 0xFF);
-	// Setting current value of reception buffer pointer
-	writeRegister(REG_FIFO_RX_BYTE_ADDR, 0x00); 
 	
 	// Proceed depending on the protocol selected
 	if( _modem == LORA )
 	{ 
 		/// LoRa mode
 		// With MAX_LENGTH gets all packets with length < MAX_LENGTH	
-		state = setPacketLength(MAX_LENGTH);	
+		// In implicit header mode the modem needs the exact length
+		if( _fixedLength != 0 )
+		{
+			state = setPacketLength(_fixedLength);
+		}
+		else
+		{
+			state = setPacketLength(MAX_LENGTH);
+		}
+		// With FHSS the packet always starts in the first channel
+		if( _hopPeriod != 0 )
+		{
+			setChannel(_hopChannels[0]);
+		}
 		// Set LORA mode - Rx
-		writeRegister(REG_OP_MODE, LORA_RX_MODE);  	  
+		setOpMode(LORA_RX_MODE);  	  
 		
 		#if (SX1278_debug_mode > 1)
 			Serial.println(F("## Receiving LoRa mode activated with success ##"));
@@ -3343,7 +5069,7 @@ uint8_t SX1278::receive()
 		/// FSK mode
 		state = setPacketLength();
 		// FSK mode - Rx
-		writeRegister(REG_OP_MODE, FSK_RX_MODE);  
+		setOpMode(FSK_RX_MODE);  
 		#if (SX1278_debug_mode > 1)
 			Serial.println(F("## Receiving FSK mode activated with success ##"));
 			Serial.println();
@@ -3357,6 +5083,34 @@ uint8_t SX1278::receive()
 	return state;
 }
 
+/*
+ Function: Drops the frame being received and listens again, without the
+           configuration done by 'receive'.
+ Returns: Nothing
+*/
+void SX1278::restartRx()
+{
+	if( _modem == LORA )
+	{
+		setOpMode(LORA_STANDBY_MODE);
+		writeRegister(REG_IRQ_FLAGS, 0xFF);
+		writeRegister(REG_FIFO_ADDR_PTR, 0x00);
+		// With FHSS the packet always starts in the first channel
+		if( _hopPeriod != 0 )
+		{
+			setChannel(_hopChannels[0]);
+		}
+		setOpMode(LORA_RX_MODE);
+	}
+	else
+	{
+		setOpMode(FSK_STANDBY_MODE);
+		writeRegister(REG_IRQ_FLAGS1, 0xFF);
+		writeRegister(REG_IRQ_FLAGS2, 0xFF);	// FifoOverrun flag also clears the FIFO
+		setOpMode(FSK_RX_MODE);
+	}
+}
+
 /*
  Function: Configures the module to receive information.
  Returns: Integer that determines if there has been any error
@@ -3420,6 +5174,7 @@ uint8_t SX1278::receivePacketTimeout(uint32_t wait)
 	{
 		state_f = state;
 	}
+	idle();
 	return state_f;
 }
 
@@ -3493,7 +5248,19 @@ uint8_t SX1278::receivePacketTimeoutACK(uint32_t wait)
 	}
 	
 	
-	if( (state == 0) || (state == 3) )
+	if( ((state == 0) || (state == 3)) && isMulticast(packet_received.dst) )
+	{
+		// Broadcast and group packets are not acknowledged
+		if( _reception == INCORRECT_PACKET )
+		{
+			state_f = 4;  // The packet has been incorrectly received
+		}
+		else
+		{
+			state_f = 0;
+		}
+	}
+	else if( (state == 0) || (state == 3) )
 	{
 		if( _reception == INCORRECT_PACKET )
 		{
@@ -3530,6 +5297,7 @@ uint8_t SX1278::receivePacketTimeoutACK(uint32_t wait)
 	{
 		state_f = 1;
 	}
+	idle();
 	return state_f;
 }
 
@@ -3565,7 +5333,7 @@ uint8_t SX1278::receiveAll(uint32_t wait)
 	if( _modem == FSK )
 	{ 
 		/// FSK mode
-		writeRegister(REG_OP_MODE, FSK_STANDBY_MODE);		// Setting standby FSK mode
+		setOpMode(FSK_STANDBY_MODE);		// Setting standby FSK mode
 		config1 = readRegister(REG_PACKET_CONFIG1);
 		config1 = config1 & B11111001;			// clears bits 2-1 from REG_PACKET_CONFIG1
 		writeRegister(REG_PACKET_CONFIG1, config1);		// AddressFiltering = None
@@ -3588,1731 +5356,4614 @@ uint8_t SX1278::receiveAll(uint32_t wait)
 }
 
 /*
- Function: If a packet is received, checks its destination.
- Returns: Boolean that's 'true' if the packet is for the module and
-		  it's 'false' if the packet is not for the module.
+ Function: Starts a continuous reception session. The module is configured
+   only once and it stays in Rx mode across packets, so between frames just
+   the FIFO pointer and the flags are updated.
+ Returns: Integer that determines if there has been any error
+   state = 2  --> The command has not been executed
+   state = 1  --> There has been an error while executing the command
+   state = 0  --> The command has been executed with no errors
+   state = -1 --> Forbidden command for this protocol
 */
-boolean	SX1278::availableData()
+int8_t SX1278::startRxContinuous()
 {
-	return availableData(MAX_TIMEOUT);
+	int8_t state = 2;
+
+	#if (SX1278_debug_mode > 1)
+		Serial.println();
+		Serial.println(F("Starting 'startRxContinuous'"));
+	#endif
+
+	if( _modem == FSK )
+	{
+		state = -1;
+		#if (SX1278_debug_mode > 1)
+			Serial.println(F("** Continuous reception is only available in LoRa mode **"));
+			Serial.println();
+		#endif
+		return state;
+	}
+
+	// Configure the reception only once
+	clearFlags();
+	state = receive();
+	if( state == 0 )
+	{
+		_rxContinuous = true;
+	}
+	return state;
 }
 
 /*
- Function: If a packet is received, checks its destination.
- Returns: Boolean that's 'true' if the packet is for the module and
-		  it's 'false' if the packet is not for the module.
+ Function: Gets the next packet addressed to the module during the continuous
+   reception session. Packets for other nodes and corrupted packets are
+   dropped while the module keeps receiving.
+ Returns: Integer that determines if there has been any error
+   state = 2  --> The command has not been executed
+   state = 1  --> There has been an error while executing the command
+   state = 0  --> The command has been executed with no errors
+   state = -1 --> Forbidden command for this protocol
  Parameters:
-   wait: time to wait while there is no a valid header received.
+   wait: time to wait to receive something.
 */
-boolean	SX1278::availableData(uint32_t wait)
+int8_t SX1278::receivePacketContinuous(uint32_t wait)
 {
-	byte value;
-	byte header = 0;
-	boolean forme = false;
-	unsigned long previous;	
-	
-	// update attribute
-	_hreceived = false;
+	int8_t state = 2;
+	byte value = 0x00;
+	unsigned long previous;
+	boolean p_received = false;
 
-	#if (SX1278_debug_mode > 0)
+	#if (SX1278_debug_mode > 1)
 		Serial.println();
-		Serial.println(F("Starting 'availableData'"));
+		Serial.println(F("Starting 'receivePacketContinuous'"));
 	#endif
 
+	if( _modem == FSK )
+	{
+		return -1;
+	}
+	if( _rxContinuous == false )
+	{
+		#if (SX1278_debug_mode > 1)
+			Serial.println(F("** The continuous reception session is not started **"));
+			Serial.println();
+		#endif
+		return 1;
+	}
+
 	previous = millis();
-	
-	if( _modem == LORA )
-	{ 
-		/// LoRa mode		
-		// read REG_IRQ_FLAGS
+	while( (p_received == false) && (millis()-previous < wait) )
+	{
 		value = readRegister(REG_IRQ_FLAGS);
-		
-		// Wait to ValidHeader interrupt in REG_IRQ_FLAGS
-		while( (bitRead(value, 4) == 0) && (millis()-previous < (unsigned long)wait) )
+
+		// FhssChangeChannel flag
+		if( bitRead(value, 1) == 1 )
 		{
-			// read REG_IRQ_FLAGS
-			value = readRegister(REG_IRQ_FLAGS);
-			
-			// Condition to avoid an overflow (DO NOT REMOVE)
-			if( millis() < previous )
-			{
-				previous = millis();
-			}
+			hopChannel();
 		}
-		
-		// Check if ValidHeader was received
-		if( bitRead(value, 4) == 1 )
+
+		// RxDone flag
+		if( bitRead(value, 6) == 1 )
 		{
-			#if (SX1278_debug_mode > 0)
-				Serial.println(F("## Valid Header received in LoRa mode ##"));
-			#endif
-			_hreceived = true;
-			while( (header == 0) && (millis()-previous < (unsigned long)wait) )
-			{ 
-				// Wait for the increment of the RX buffer pointer
-				header = readRegister(REG_FIFO_RX_BYTE_ADDR);
-				
-				// Condition to avoid an overflow (DO NOT REMOVE)
-				if( millis() < previous )
+			// Latch the last packet and clear its flags before draining it, so
+			// the modem goes on receiving the next packet in the following
+			// FIFO region and its RxDone is not lost
+			_rxNbBytes = readRegister(REG_RX_NB_BYTES);
+			writeRegister(REG_FIFO_ADDR_PTR, readRegister(REG_FIFO_RX_CURRENT_ADDR));
+			writeRegister(REG_IRQ_FLAGS, B01110000);
+			// With FHSS the next packet starts in the first channel
+			if( _hopPeriod != 0 )
+			{
+				setChannel(_hopChannels[0]);
+			}
+
+			if( bitRead(value, 5) == 0 )
+			{
+				// Read from the beginning of the last packet received
+				if( _fixedLength != 0 )
 				{
-					previous = millis();
+					// Implicit header: there are no addressing bytes
+					_destination = _nodeAddress;
+				}
+				else
+				{
+					_destination = readDestination();
+				}
+
+				if( isForMe(_destination) )
+				{
+					packet_received.dst = _destination;
+					if( readPacket() == 0 )
+					{
+						p_received = true;
+						_reception = CORRECT_PACKET;
+					}
+				}
+				#if (SX1278_debug_mode > 0)
+				else
+				{
+					Serial.println(F("## Packet received is not for me ##"));
 				}
+				#endif
 			}
-			
-			// If packet received: Read first byte of the received packet
-			if( header != 0 )
-			{ 				
-				_destination = readRegister(REG_FIFO);
+			else
+			{
+				// CRC incorrect
+				_reception = INCORRECT_PACKET;
+				#if (SX1278_debug_mode > 0)
+					Serial.println(F("** The CRC is incorrect **"));
+				#endif
 			}
 		}
-		else
+
+		// Condition to avoid an overflow (DO NOT REMOVE)
+		if( millis() < previous )
 		{
-			forme = false;
-			_hreceived = false;
-			#if (SX1278_debug_mode > 0)
-				Serial.println(F("** The timeout has expired **"));
-				Serial.println();
-			#endif
+			previous = millis();
 		}
 	}
+
+	if( p_received == true )
+	{
+		state = 0;
+	}
 	else
 	{
-		/// FSK mode
-		// read REG_IRQ_FLAGS2
-		value = readRegister(REG_IRQ_FLAGS2);
-		// Wait to Payload Ready interrupt
-		while( (bitRead(value, 2) == 0) && (millis() - previous < wait) )
+		state = 1;
+		#if (SX1278_debug_mode > 0)
+			Serial.println(F("** The timeout has expired **"));
+			Serial.println();
+		#endif
+	}
+	return state;
+}
+
+/*
+ Function: Stops the continuous reception session.
+ Returns: Integer that determines if there has been any error
+   state = 2  --> The command has not been executed
+   state = 1  --> There has been an error while executing the command
+   state = 0  --> The command has been executed with no errors
+*/
+int8_t SX1278::stopRxContinuous()
+{
+	#if (SX1278_debug_mode > 1)
+		Serial.println();
+		Serial.println(F("Starting 'stopRxContinuous'"));
+	#endif
+
+	_rxContinuous = false;
+	if( _modem == LORA )
+	{
+		// Setting standby LoRa mode
+		setOpMode(LORA_STANDBY_MODE);
+	}
+	else
+	{
+		// Setting standby FSK mode
+		setOpMode(FSK_STANDBY_MODE);
+	}
+	clearFlags();
+	return 0;
+}
+
+/*
+ Function: Sends a frame longer than the FSK FIFO, refilling the FIFO on the
+           FifoLevel flag while the packet is being sent.
+ Returns: Integer that determines if there has been any error
+   state = 2  --> The command has not been executed
+   state = 1  --> There has been an error while executing the command
+   state = 0  --> The command has been executed with no errors
+   state = 3  --> The FIFO ran empty before the end of the frame (underrun)
+   state = -1 --> Forbidden command for this protocol
+ Parameters:
+   dest: destination of the frame.
+   data: data to send.
+   length: data length.
+   wait: time to wait to send the frame.
+*/
+int8_t SX1278::sendFSKStream(uint8_t dest, uint8_t *data, uint16_t length, uint32_t wait)
+{
+	int8_t state = 2;
+	byte value = 0x00;
+	byte config2;
+	byte thresh;
+	uint16_t total;
+	uint16_t sent = 0;
+	uint16_t n;
+	unsigned long previous;
+
+	#if (SX1278_debug_mode > 1)
+		Serial.println();
+		Serial.println(F("Starting 'sendFSKStream'"));
+	#endif
+
+	if( _modem == LORA )
+	{
+		return -1;
+	}
+	if( (length == 0) || (length > MAX_LENGTH_FSK_STREAM) )
+	{
+		return 1;
+	}
+
+	setOpMode(FSK_STANDBY_MODE);	// Stdby FSK mode to write in FIFO
+	clearFlags();
+	_txArmed = false;	// The stream overwrites the armed packet
+	config2 = readRegister(REG_PACKET_CONFIG2);
+	thresh = readRegister(REG_FIFO_THRESH);
+
+	// Fixed length of 11 bits: PayloadLength(10:8) is in REG_PACKET_CONFIG2
+	total = length + 1;
+	writeRegister(REG_PACKET_CONFIG2, (config2 & B11111000) | ((total >> 8) & 0x07));
+	writeRegister(REG_PAYLOAD_LENGTH_FSK, total & 0xFF);
+	// Tx starts when the FIFO is not empty, FifoLevel over the threshold
+	writeRegister(REG_FIFO_THRESH, B10000000 | FSK_FIFO_THRESHOLD);
+
+	// Fill the whole FIFO before starting
+	writeRegister(REG_FIFO, dest);
+	sent = min(length, FSK_FIFO_SIZE - 1);
+	writeRegisters(REG_FIFO, data, sent);
+
+	setOpMode(FSK_TX_MODE);	// FSK mode - Tx
+	state = 1;
+	previous = millis();
+	while( millis()-previous < wait )
+	{
+		// Polled and refilled without delays to keep up with the bitrate
+		readRegisters(REG_IRQ_FLAGS2, &value, 1);
+
+		// PacketSent flag
+		if( bitRead(value, 3) == 1 )
 		{
-			value = readRegister(REG_IRQ_FLAGS2);
-			// Condition to avoid an overflow (DO NOT REMOVE)
-			if( millis() < previous )
+			if( sent == length )
 			{
-				previous = millis();
+				state = 0;
 			}
-		}// end while (millis)
-		if( bitRead(value, 2) == 1 )	// something received
+			break;
+		}
+
+		if( sent < length )
 		{
-			_hreceived = true;
-			#if (SX1278_debug_mode > 0)
-				Serial.println(F("## Valid Preamble detected in FSK mode ##"));
-			#endif
-			// Reading first byte of the received packet
-			_destination = readRegister(REG_FIFO);
+			// FifoEmpty flag before the end of the frame
+			if( bitRead(value, 6) == 1 )
+			{
+				state = 3;
+				#if (SX1278_debug_mode > 0)
+					Serial.println(F("** FIFO underrun while sending the stream **"));
+				#endif
+				break;
+			}
+			// FifoLevel flag clear: there is room for the bytes over the threshold
+			if( bitRead(value, 5) == 0 )
+			{
+				n = min(length - sent, FSK_FIFO_SIZE - FSK_FIFO_THRESHOLD - 1);
+				writeRegisters(REG_FIFO, &data[sent], n);
+				sent += n;
+			}
 		}
-		else
+
+		// Condition to avoid an overflow (DO NOT REMOVE)
+		if( millis() < previous )
 		{
-			forme = false;
-			_hreceived = false;
-			#if (SX1278_debug_mode > 0)
-				Serial.println(F("** The timeout has expired **"));
-				Serial.println();
-			#endif
+			previous = millis();
 		}
 	}
-	
-	
-	/* We use '_hreceived' because we need to ensure that '_destination' value 
-	 * is correctly updated and is not the '_destination' value from the
-	 * previously packet
-	 */
-	if( _hreceived == true )
-	{ 
-		#if (SX1278_debug_mode > 0)
-			Serial.println(F("## Checking destination ##"));
-		#endif
-		
-		// Checking destination
-		if( (_destination == _nodeAddress) || (_destination == BROADCAST_0) )
-		{ // LoRa or FSK mode
-			forme = true;
-			#if (SX1278_debug_mode > 0)
-				Serial.println(F("## Packet received is for me ##"));
-			#endif
+
+	#if (SX1278_debug_mode > 1)
+		if( state == 0 )
+		{
+			Serial.println(F("## Stream has been successfully sent ##"));
+			Serial.println();
 		}
-		else
+	#endif
+
+	// Getting back to the packet configuration
+	setOpMode(FSK_STANDBY_MODE);
+	writeRegister(REG_PACKET_CONFIG2, config2);
+	writeRegister(REG_FIFO_THRESH, thresh);
+	clearFlags();
+	return state;
+}
+
+/*
+ Function: Receives a frame longer than the FSK FIFO, draining the FIFO on the
+           FifoLevel flag while the packet is being received.
+ Returns: Integer that determines if there has been any error
+   state = 2  --> The command has not been executed
+   state = 1  --> There has been an error while executing the command
+   state = 0  --> The command has been executed with no errors
+   state = 3  --> The FIFO overran or the CRC is incorrect
+   state = -1 --> Forbidden command for this protocol
+ Parameters:
+   data: buffer to store the received data.
+   length: expected data length.
+   wait: time to wait to receive the frame.
+*/
+int8_t SX1278::receiveFSKStream(uint8_t *data, uint16_t length, uint32_t wait)
+{
+	int8_t state = 2;
+	byte value = 0x00;
+	byte config2;
+	byte thresh;
+	uint16_t total;
+	uint16_t count = 0;
+	uint16_t n;
+	unsigned long previous;
+
+	#if (SX1278_debug_mode > 1)
+		Serial.println();
+		Serial.println(F("Starting 'receiveFSKStream'"));
+	#endif
+
+	if( _modem == LORA )
+	{
+		return -1;
+	}
+	if( (length == 0) || (length > MAX_LENGTH_FSK_STREAM) )
+	{
+		return 1;
+	}
+
+	setOpMode(FSK_STANDBY_MODE);	// Stdby FSK mode to write in registers
+	clearFlags();
+	config2 = readRegister(REG_PACKET_CONFIG2);
+	thresh = readRegister(REG_FIFO_THRESH);
+
+	// Fixed length of 11 bits: PayloadLength(10:8) is in REG_PACKET_CONFIG2
+	total = length + 1;
+	writeRegister(REG_PACKET_CONFIG2, (config2 & B11111000) | ((total >> 8) & 0x07));
+	writeRegister(REG_PAYLOAD_LENGTH_FSK, total & 0xFF);
+	writeRegister(REG_FIFO_THRESH, (thresh & B10000000) | FSK_FIFO_THRESHOLD);
+
+	setOpMode(FSK_RX_MODE);	// FSK mode - Rx
+	state = 1;
+	previous = millis();
+	while( millis()-previous < wait )
+	{
+		// Polled and emptied without delays to keep up with the bitrate
+		readRegisters(REG_IRQ_FLAGS2, &value, 1);
+
+		// FifoOverrun flag: data has been lost
+		if( bitRead(value, 4) == 1 )
 		{
-			forme = false;
+			state = 3;
+			writeRegister(REG_IRQ_FLAGS2, B00010000);
 			#if (SX1278_debug_mode > 0)
-				Serial.println(F("## Packet received is not for me ##"));
-				Serial.println(millis());
+				Serial.println(F("** FIFO overrun while receiving the stream **"));
 			#endif
-			
-			// If it is not a correct destination address, then change to
-			// STANDBY to minimize power consumption
-			if( _modem == LORA )	
-			{ 
-				// Setting standby LoRa mode
-				writeRegister(REG_OP_MODE, LORA_STANDBY_MODE);	
+			break;
+		}
+
+		n = 0;
+		if( bitRead(value, 2) == 1 )
+		{
+			// PayloadReady: the rest of the frame is in FIFO
+			n = total - count;
+		}
+		else if( bitRead(value, 5) == 1 )
+		{
+			// FifoLevel: there are more bytes than the threshold
+			n = FSK_FIFO_THRESHOLD;
+			if( n > total - count )
+			{
+				n = total - count;
+			}
+		}
+		if( (count == 0) && (n > 0) )
+		{
+			readRegisters(REG_FIFO, &_destination, 1);
+			count++;
+			n--;
+		}
+		if( n > 0 )
+		{
+			readRegisters(REG_FIFO, &data[count - 1], n);
+			count += n;
+		}
+
+		if( bitRead(value, 2) == 1 )
+		{
+			if( (_CRC == CRC_ON) && (bitRead(value, 1) == 0) )
+			{
+				state = 3;
+				_reception = INCORRECT_PACKET;
+				#if (SX1278_debug_mode > 0)
+					Serial.println(F("** The CRC is incorrect **"));
+				#endif
 			}
 			else
-			{ 
-				// Setting standby FSK mode
-				writeRegister(REG_OP_MODE, FSK_STANDBY_MODE);	
+			{
+				state = 0;
+				_reception = CORRECT_PACKET;
 			}
+			break;
+		}
+
+		// Condition to avoid an overflow (DO NOT REMOVE)
+		if( millis() < previous )
+		{
+			previous = millis();
 		}
 	}
-	else
-	{ 
-		// If timeout has expired, then change to
-		// STANDBY to minimize power consumption
+
+	#if (SX1278_debug_mode > 1)
+		if( state == 0 )
+		{
+			Serial.println(F("## Stream has been successfully received ##"));
+			Serial.println();
+		}
+	#endif
+
+	// Getting back to the packet configuration
+	setOpMode(FSK_STANDBY_MODE);
+	writeRegister(REG_PACKET_CONFIG2, config2);
+	writeRegister(REG_FIFO_THRESH, thresh);
+	clearFlags();
+	return state;
+}
+
+/*
+ Function: If a packet is received, checks its destination.
+ Returns: Boolean that's 'true' if the packet is for the module and
+		  it's 'false' if the packet is not for the module.
+*/
+boolean	SX1278::availableData()
+{
+	return availableData(MAX_TIMEOUT);
+}
+
+/*
+ Function: If a packet is received, checks its destination.
+ Returns: Boolean that's 'true' if the packet is for the module and
+		  it's 'false' if the packet is not for the module.
+ Parameters:
+   wait: time to wait while there is no a valid header received.
+*/
+boolean	SX1278::availableData(uint32_t wait)
+{
+	uint8_t state;
+	unsigned long previous;
+	unsigned long elapsed;
+
+	#if (SX1278_debug_mode > 0)
+		Serial.println();
+		Serial.println(F("Starting 'availableData'"));
+	#endif
+	SX1278_TIME_CALL(INSTR_AVAILABLE_DATA);
+	SX1278_TRACE(TRACE_CALL, 0, INSTR_AVAILABLE_DATA);
+
+	previous = millis();
+	state = receiveHeader(wait);
+	while( state == 2 )
+	{
+		// A foreign frame has been dropped, listen for the rest of 'wait'
+		elapsed = millis() - previous;
+		state = receiveHeader((elapsed < wait) ? wait - elapsed : 0);
+	}
+	return (state == 1);
+}
+
+/*
+ Function: Waits for a header and checks its destination. A frame for another
+           node is dropped right after its header while 'wait' has not expired.
+ Returns: Integer that determines the header received
+   state = 2  --> A foreign frame has been dropped and the reception restarted
+   state = 1  --> The packet is for the module
+   state = 0  --> The timeout has expired or the packet is not for the module
+ Parameters:
+   wait: time to wait while there is no a valid header received.
+*/
+uint8_t SX1278::receiveHeader(uint32_t wait)
+{
+	byte value;
+	byte header = 0;
+	byte hflag = 4;
+	byte hbytes = 1;
+	boolean forme = false;
+	unsigned long previous;	
+	
+	// update attribute
+	_hreceived = false;
+
+	previous = millis();
+	
+	if( _modem == LORA )
+	{ 
+		/// LoRa mode		
+		// In implicit header mode there is no ValidHeader interrupt, so
+		// the whole fixed length frame is waited (RxDone)
+		if( _fixedLength != 0 )
+		{
+			hflag = 6;
+		}
+		// In compact format the destination follows the format byte
+		if( _frameFormat == FRAME_FORMAT_COMPACT )
+		{
+			hbytes = 2;
+		}
+
+		// read REG_IRQ_FLAGS
+		value = readRegister(REG_IRQ_FLAGS);
+		
+		// Wait to ValidHeader interrupt in REG_IRQ_FLAGS
+		while( (bitRead(value, hflag) == 0) && (millis()-previous < (unsigned long)wait) )
+		{
+			// FhssChangeChannel flag
+			if( bitRead(value, 1) == 1 )
+			{
+				hopChannel();
+			}
+			// read REG_IRQ_FLAGS
+			value = readRegister(REG_IRQ_FLAGS);
+			
+			// Condition to avoid an overflow (DO NOT REMOVE)
+			if( millis() < previous )
+			{
+				previous = millis();
+			}
+		}
+		
+		// Check if ValidHeader was received
+		if( (bitRead(value, hflag) == 1) && (_fixedLength != 0) )
+		{
+			// Implicit header: there are no addressing bytes
+			_hreceived = true;
+			_destination = _nodeAddress;
+		}
+		else if( bitRead(value, 4) == 1 )
+		{
+			#if (SX1278_debug_mode > 0)
+				Serial.println(F("## Valid Header received in LoRa mode ##"));
+			#endif
+			_hreceived = true;
+			while( (header < hbytes) && (millis()-previous < (unsigned long)wait) )
+			{ 
+				// Wait for the increment of the RX buffer pointer
+				header = readRegister(REG_FIFO_RX_BYTE_ADDR);
+
+				// Hops can start right after the header
+				if( (_hopPeriod != 0) && (bitRead(readRegister(REG_IRQ_FLAGS), 1) == 1) )
+				{
+					hopChannel();
+				}
+
+				// Condition to avoid an overflow (DO NOT REMOVE)
+				if( millis() < previous )
+				{
+					previous = millis();
+				}
+			}
+			
+			// If packet received: Read first byte of the received packet
+			if( header >= hbytes )
+			{ 				
+				_destination = readDestination();
+			}
+		}
+		else
+		{
+			forme = false;
+			_hreceived = false;
+			#if (SX1278_debug_mode > 0)
+				Serial.println(F("** The timeout has expired **"));
+				Serial.println();
+			#endif
+		}
+	}
+	else
+	{
+		/// FSK mode
+		// read REG_IRQ_FLAGS2
+		value = readRegister(REG_IRQ_FLAGS2);
+		// Wait to Payload Ready interrupt
+		while( (bitRead(value, 2) == 0) && (millis() - previous < wait) )
+		{
+			value = readRegister(REG_IRQ_FLAGS2);
+			// Condition to avoid an overflow (DO NOT REMOVE)
+			if( millis() < previous )
+			{
+				previous = millis();
+			}
+		}// end while (millis)
+		if( bitRead(value, 2) == 1 )	// something received
+		{
+			_hreceived = true;
+			_rxDoneTime = millis();
+			#if (SX1278_debug_mode > 0)
+				Serial.println(F("## Valid Preamble detected in FSK mode ##"));
+			#endif
+			// Reading first byte of the received packet
+			_destination = readRegister(REG_FIFO);
+		}
+		else
+		{
+			forme = false;
+			_hreceived = false;
+			#if (SX1278_debug_mode > 0)
+				Serial.println(F("** The timeout has expired **"));
+				Serial.println();
+			#endif
+		}
+	}
+	
+	
+	/* We use '_hreceived' because we need to ensure that '_destination' value 
+	 * is correctly updated and is not the '_destination' value from the
+	 * previously packet
+	 */
+	if( _hreceived == true )
+	{ 
+		#if (SX1278_debug_mode > 0)
+			Serial.println(F("## Checking destination ##"));
+		#endif
+		
+		// Checking destination: node, broadcast or one of its groups
+		if( isForMe(_destination) )
+		{ // LoRa or FSK mode
+			forme = true;
+			#if (SX1278_debug_mode > 0)
+				Serial.println(F("## Packet received is for me ##"));
+			#endif
+		}
+		else
+		{
+			forme = false;
+			#if (SX1278_debug_mode > 0)
+				Serial.println(F("## Packet received is not for me ##"));
+				Serial.println(millis());
+			#endif
+			
+			if( millis() - previous < wait )
+			{
+				// Abort the foreign frame right after its header, the
+				// caller listens again for the rest of 'wait'
+				_hreceived = false;
+				restartRx();
+				return 2;
+			}
+			// If it is not a correct destination address, then change to
+			// STANDBY to minimize power consumption
+			if( _modem == LORA )	
+			{ 
+				// Setting standby LoRa mode
+				setOpMode(LORA_STANDBY_MODE);	
+			}
+			else
+			{ 
+				// Setting standby FSK mode
+				setOpMode(FSK_STANDBY_MODE);	
+			}
+		}
+	}
+	else
+	{ 
+		// If timeout has expired, then change to
+		// STANDBY to minimize power consumption
+		if( _modem == LORA )
+		{				
+			// Setting standby LoRa mode
+//~ 			setOpMode(LORA_STANDBY_MODE);	
+		}
+		else
+		{
+			// Setting standby FSK mode
+			setOpMode(FSK_STANDBY_MODE);	
+		}
+	}
+	return forme;
+}
+
+/*
+ Function: It gets and stores a packet if it is received before MAX_TIMEOUT expires.
+ Returns:  Integer that determines if there has been any error
+   state = 2  --> The command has not been executed
+   state = 1  --> There has been an error while executing the command
+   state = 0  --> The command has been executed with no errors
+*/
+uint8_t SX1278::getPacketMAXTimeout()
+{
+	return getPacket(MAX_TIMEOUT);
+}
+
+/*
+ Function: It gets and stores a packet if it is received.
+ Returns:  Integer that determines if there has been any error
+   state = 2  --> The command has not been executed
+   state = 1  --> There has been an error while executing the command
+   state = 0  --> The command has been executed with no errors
+*/
+int8_t SX1278::getPacket()
+{
+	return getPacket(MAX_TIMEOUT);
+}
+
+/*
+ Function: It gets and stores a packet if it is received before ending 'wait' time.
+ Returns:  Integer that determines if there has been any error
+   state = 2  --> The command has not been executed
+   state = 1  --> There has been an error while executing the command
+   state = 0  --> The command has been executed with no errors
+   state = -1 --> Forbidden parameter value for this function
+ Parameters:
+   wait: time to wait while there is no a valid header received.
+*/
+int8_t SX1278::getPacket(uint32_t wait)
+{
+	uint8_t state = 2;
+	uint8_t state_f = 2;
+	byte value = 0x00;
+	unsigned long previous;
+	boolean p_received = false;
+
+	#if (SX1278_debug_mode > 0)
+		Serial.println();
+		Serial.println(F("Starting 'getPacket'"));
+	#endif
+	SX1278_TIME_CALL(INSTR_GET_PACKET);
+	SX1278_TRACE(TRACE_CALL, 0, INSTR_GET_PACKET);
+
+	previous = millis();
+	
+	if( _modem == LORA )
+	{
+		/// LoRa mode
+		// read REG_IRQ_FLAGS
+		value = readRegister(REG_IRQ_FLAGS);
+		
+		// Wait until the packet is received (RxDone flag) or the timeout expires
+		while( (bitRead(value, 6) == 0) && (millis()-previous < (unsigned long)wait) )
+		{
+			// FhssChangeChannel flag
+			if( bitRead(value, 1) == 1 )
+			{
+				hopChannel();
+			}
+			value = readRegister(REG_IRQ_FLAGS);
+			
+			// Condition to avoid an overflow (DO NOT REMOVE)
+			if( millis() < previous )
+			{
+				previous = millis();
+			}
+		}
+		// End of the frame, used by the TDMA synchronization
+		_rxDoneTime = millis();
+
+		// Check if 'RxDone' is true and 'PayloadCrcError' is correct
+		if( (bitRead(value, 6) == 1) && (bitRead(value, 5) == 0) )
+		{ 
+			// packet received & CRC correct
+			p_received = true;	// packet correctly received
+			_reception = CORRECT_PACKET;
+			#if (SX1278_debug_mode > 0)
+				Serial.println(F("## Packet correctly received in LoRa mode ##"));
+			#endif
+		}
+		else
+		{
+			if( bitRead(value, 6) != 1 )
+			{ 
+				#if (SX1278_debug_mode > 0)
+					Serial.println(F("NOT 'RxDone' flag"));
+				#endif
+			}
+			
+			if( _CRC != CRC_ON )
+			{ 
+				#if (SX1278_debug_mode > 0)
+					Serial.println(F("NOT 'CRC_ON' enabled"));
+				#endif
+			}
+			
+			if( (bitRead(value, 5) == 0) && (_CRC == CRC_ON) )
+			{ 
+				// CRC is correct
+				_reception = CORRECT_PACKET;
+			}
+			else
+			{ 
+				// CRC incorrect
+				_reception = INCORRECT_PACKET;
+				state = 3;
+				#if (SX1278_debug_mode > 0)
+					Serial.println(F("** The CRC is incorrect **"));
+					Serial.println();
+				#endif
+			}
+		}			
+
+	}
+	else
+	{ 
+		/// FSK mode
+		value = readRegister(REG_IRQ_FLAGS2);
+		while( (bitRead(value, 2) == 0) && (millis() - previous < wait) )
+		{
+			value = readRegister(REG_IRQ_FLAGS2);
+			// Condition to avoid an overflow (DO NOT REMOVE)
+			if( millis() < previous )
+			{
+				previous = millis();
+			}
+		} // end while (millis)
+		if( bitRead(value, 2) == 1 )
+		{ // packet received
+ 			if( (bitRead(value, 1) == 1) && (_CRC == CRC_ON) )
+			{ // CRC correct
+				_reception = CORRECT_PACKET;
+				p_received = true;
+				#if (SX1278_debug_mode > 0)
+					Serial.println(F("## Packet correctly received in FSK mode ##"));
+				#endif
+			}
+			else
+			{ // CRC incorrect
+				_reception = INCORRECT_PACKET;
+				state = 3;
+				p_received = false;
+				#if (SX1278_debug_mode > 0)
+					Serial.println(F("## Packet incorrectly received in FSK mode ##"));
+				#endif
+			}
+		}
+		else
+		{
+			#if (SX1278_debug_mode > 0)
+				Serial.println(F("** The timeout has expired **"));
+				Serial.println();
+			#endif
+		}
+		setOpMode(FSK_STANDBY_MODE);	// Setting standby FSK mode
+	}
+	
+	/* If a new packet was received correctly, now the information must be 
+	 * filled inside the structures of the class 
+	 */
+	if( p_received == true )
+	{		
+		// Store the packet
+		if( _modem == LORA )
+		{
+			/// LoRa
+			// Number of bytes of the last packet received
+			_rxNbBytes = readRegister(REG_RX_NB_BYTES);
+			// Setting address pointer at the beginning of the last packet
+			writeRegister(REG_FIFO_ADDR_PTR, readRegister(REG_FIFO_RX_CURRENT_ADDR));
+			if( _fixedLength != 0 )
+			{
+				// Implicit header: there are no addressing bytes
+				packet_received.dst = _nodeAddress;
+			}
+			else
+			{
+				// Storing first byte(s) of the received packet
+				packet_received.dst = readDestination();
+			}
+		}
+		else
+		{
+			/// FSK
+			// First byte of the received packet, already read by 'availableData'
+			// with or without AddressFiltering
+			packet_received.dst = _destination;
+		}
+		
+		// Reading the rest of the received packet
+		state_f = readPacket();
+	}
+	else
+	{
+		// if packet was NOT received
+		state_f = 1;
+		if( (_reception == INCORRECT_PACKET) && (_retries < _maxRetries) && (state != 3) )
+		{
+			_retries++;
+			#if (SX1278_debug_mode > 0)
+				Serial.println(F("## Retrying to send the last packet ##"));
+				Serial.println();
+			#endif
+		}
+	}
+	
+	// Initializing flags	
+	clearFlags();	
+	
+	if( wait > MAX_WAIT )
+	{
+		state_f = -1;
+		#if (SX1278_debug_mode > 0)
+			Serial.println(F("** The timeout must be smaller than 12.5 seconds **"));
+			Serial.println();
+		#endif
+	}
+
+	return state_f;
+}
+
+/*
+ Function: It reads the received packet from the current FIFO address pointer,
+   once its destination has been stored in 'packet_received.dst'.
+ Returns:  Integer that determines if there has been any error
+   state = 2  --> The command has not been executed
+   state = 1  --> There has been an error while executing the command
+   state = 0  --> The command has been executed with no errors
+*/
+int8_t SX1278::readPacket()
+{
+	int8_t state = 2;
+	uint8_t offset = OFFSET_PAYLOADLENGTH;
+
+	if( (_modem == LORA) && (_fixedLength != 0) )
+	{
+		// Implicit header: the whole frame is payload
+		packet_received.src = 0;
+		packet_received.packnum = 0;
+		packet_received.length = _fixedLength;
+		packet_received.retry = 0;
+		_payloadlength = _fixedLength;
+		if( _rxNbBytes != _fixedLength )
+		{
+			#if (SX1278_debug_mode > 0)
+				Serial.println(F("Corrupted packet, length is not the fixed length"));
+			#endif
+			return 1;
+		}
+		readRegisters(REG_FIFO, packet_received.data, _payloadlength);
+		#if (SX1278_debug_mode > 0)
+			Serial.println(F("## Fixed length packet received ##"));
+		#endif
+		return 0;
+	}
+
+	if( (_modem == LORA) && (_frameFormat == FRAME_FORMAT_COMPACT) )
+	{
+		// Compact format: the length is the one of the LoRa header and
+		// the retry number is in the format byte
+		packet_received.src = readRegister(REG_FIFO);
+		packet_received.packnum = readRegister(REG_FIFO);
+		packet_received.length = _rxNbBytes;
+		packet_received.retry = _rxFormat & FRAME_RETRY_MASK;
+		offset = frameOverhead(packet_received.dst);
+		_payloadlength = packet_received.length - offset;
+
+		// check the version and that it is not an ACK
+		if( ((_rxFormat & FRAME_VERSION_MASK) != FRAME_VERSION_COMPACT)
+			|| ((_rxFormat & FRAME_FLAG_ACK) != 0) )
+		{
+			#if (SX1278_debug_mode > 0)
+				Serial.println(F("Unknown frame format"));
+			#endif
+			return 1;
+		}
+	}
+	else
+	{
+		// Reading second byte of the received packet
+		// Reading third byte of the received packet
+		// Reading fourth byte of the received packet
+		packet_received.src = readRegister(REG_FIFO);
+		packet_received.packnum = readRegister(REG_FIFO);
+		packet_received.length = readRegister(REG_FIFO);
+
+		// calculate the payload length
+		if( _modem == LORA )
+		{
+			_payloadlength = packet_received.length - OFFSET_PAYLOADLENGTH;
+		}
+	}
+
+	// check if length is incorrect: in LoRa mode the length field must match
+	// the number of bytes received by the modem
+	if( (packet_received.length < offset)
+		|| (_payloadlength > MAX_PAYLOAD)
+		|| ((_modem == LORA) && (packet_received.length != _rxNbBytes)) )
+	{
+		state = 1;
+		#if (SX1278_debug_mode > 0)
+			Serial.println(F("Corrupted packet, length must be less than 256"));
+		#endif
+	}
+	else
+	{
+		// Store payload in 'data'
+		readRegisters(REG_FIFO, packet_received.data, _payloadlength);
+		// Store 'retry'
+		if( offset == OFFSET_PAYLOADLENGTH )
+		{
+			packet_received.retry = readRegister(REG_FIFO);
+		}
+
+		// Print the packet if debug_mode
+		#if (SX1278_debug_mode > 0)
+			Serial.println(F("## Packet received:"));
+			Serial.print(packet_received.dst, HEX);	 	// Printing destination
+			Serial.print("|");
+			Serial.print(packet_received.src, HEX);		 	// Printing source
+			Serial.print("|");
+			Serial.print(packet_received.packnum, HEX);			// Printing packet number
+			Serial.print("|");
+			Serial.print(packet_received.length, HEX);			// Printing packet length
+			Serial.print("|");
+			for(unsigned int i = 0; i < _payloadlength; i++)
+			{
+				Serial.print(packet_received.data[i], HEX);		// Printing payload
+				Serial.print("|");
+			}
+			Serial.print(packet_received.retry, HEX);			// Printing number retry
+			Serial.println(F(" ##"));
+			Serial.println();
+		#endif
+		// Decrypting and decompressing the payload if enabled
+		state = decryptPayload();
+		if( state == 0 )
+		{
+			state = decompressPayload();
+		}
+		if( state == 0 )
+		{
+			SX1278_LINK(linkReceived());
+		}
+	}
+	return state;
+}
+
+/*
+ Function: It sets the packet destination.
+ Returns:  Integer that determines if there has been any error
+   state = 2  --> The command has not been executed
+   state = 1  --> There has been an error while executing the command
+   state = 0  --> The command has been executed with no errors
+ Parameters:
+   dest: destination value of the packet sent.
+*/
+int8_t SX1278::setDestination(uint8_t dest)
+{
+	int8_t state = 2;
+
+	#if (SX1278_debug_mode > 1)
+		Serial.println();
+		Serial.println(F("Starting 'setDestination'"));
+	#endif
+
+	state = 1;
+	_destination = dest; // Storing destination in a global variable
+	packet_sent.dst = dest;	 // Setting destination in packet structure
+	packet_sent.src = _nodeAddress; // Setting source in packet structure
+	packet_sent.packnum = _packetNumber;	// Setting packet number in packet structure
+	_packetNumber++;
+	state = 0;
+
+	#if (SX1278_debug_mode > 1)
+		Serial.print(F("## Destination "));
+		Serial.print(_destination, HEX);
+		Serial.println(F(" successfully set ##"));
+		Serial.print(F("## Source "));
+		Serial.print(packet_sent.src, DEC);
+		Serial.println(F(" successfully set ##"));
+		Serial.print(F("## Packet number "));
+		Serial.print(packet_sent.packnum, DEC);
+		Serial.println(F(" successfully set ##"));
+		Serial.println();
+	#endif
+	return state;
+}
+
+/*
+ Function: It sets the timeout according to the configured mode.
+ Link: http://www.semtech.com/images/datasheet/sx1276.pdf
+ Returns: Integer that determines if there has been any error
+   state = 2  --> The command has not been executed
+   state = 1  --> There has been an error while executing the command
+   state = 0  --> The command has been executed with no errors
+*/
+uint8_t SX1278::setTimeout()
+{
+	uint8_t state = 2;
+	uint16_t delay;
+
+	#if (SX1278_debug_mode > 1)
+		Serial.println();
+		Serial.println(F("Starting 'setTimeout'"));
+	#endif
+
+	state = 1;
+	if( _modem == LORA )
+	{
+		// calculate 'delay'
+		delay = ((0.1*_sendTime) + 1);		
+	
+		float Tpacket = timeOnAir();
+	
+		// calculate final send/receive timeout adding an offset and a random value
+		_sendTime = (uint16_t) Tpacket + (rand()%delay) + 1000;
+		SX1278_COUNT_N(timeoutPadding, _sendTime - (uint16_t)Tpacket);
+	
+		#if (SX1278_debug_mode > 2)		
+			Serial.print(F("Tsym (ms):"));
+			Serial.println(Tsym);
+			Serial.print(F("Tpreamble (ms):"));
+			Serial.println(Tpreamble);
+			Serial.print(F("payloadSymbNb:"));
+			Serial.println(payloadSymbNb);
+			Serial.print(F("Tpacket:"));
+			Serial.println(Tpacket);
+		#endif
+		
+		// update state
+		state = 0;
+	}
+	else 
+	{
+		// FSK time-on-air depends on the bit rate set
+		float Tpacket = timeOnAirFSK( _payloadlength );
+
+		// calculate final send/receive timeout adding an offset
+		_sendTime = (uint16_t) Tpacket + 1000;
+		
+		// update state
+		state = 0;
+	}
+
+	#if (SX1278_debug_mode > 1)	
+		Serial.print(F("Timeout to send/receive is: "));
+		Serial.println(_sendTime, DEC);	
+	#endif	
+	
+	return state;
+}
+
+
+/*
+ Function: It gets the theoretical value of the time-on-air of the packet
+ Link: http://www.semtech.com/images/datasheet/sx1276.pdf
+ Returns: Float that determines the time-on-air
+*/
+float SX1278::timeOnAir()
+{
+	return timeOnAir( _payloadlength );
+}
+
+/*
+ Function: It gets the theoretical value of the time-on-air of the packet
+ Link: http://www.semtech.com/images/datasheet/sx1276.pdf
+ Returns: Float that determines the time-on-air
+*/
+float SX1278::timeOnAir( uint16_t payloadlength )
+{
+	float DE = 0;
+	float SF = _spreadingFactor;
+	float PL = payloadlength + frameOverhead(packet_sent.dst);
+	float H = _header;
+	float CR = _codingRate;
+	
+	if( _modem == FSK )
+	{
+		return timeOnAirFSK( payloadlength );
+	}
+
+	// Dara rate optimization enabled if SF is 11 or 12
+	if( SF > 10) DE = 1.0;
+	else DE = 0.0;
+		
+	// payload correction
+	if( payloadlength == 0 ) PL = 255;
+
+	// implicit header: only the fixed length payload is sent
+	if( _fixedLength != 0 )
+	{
+		PL = _fixedLength;
+		H = 1;
+	}
+
+	// Calculation steps:
+	float Tsym = symbolTime(); // ms
+	float Tpreamble = (_preamblelength+4.25)*Tsym;// ms
+	float argument1 = ceil( (8.0*PL-4.0*SF+28.0+16.0-20.0*H)/(4.0*(SF-2.0*DE)) )*(CR+4.0);
+	float argument2 = 0;
+	float payloadSymbNb = 8 + max( argument1, argument2);
+	float Tpayload = payloadSymbNb * Tsym;
+	float Tpacket = Tpreamble + Tpayload;	
+	
+	return Tpacket;
+}
+
+/*
+ Function: It gets the duration of a LoRa symbol
+ Returns: Float with the symbol time in ms
+*/
+float SX1278::symbolTime()
+{
+	float BW;
+
+	// Bandwidth value setting
+	if( _bandwidth == BW_125 ) 		BW = 125.0;
+	else if( _bandwidth == BW_250 ) BW = 250.0;
+	else if( _bandwidth == BW_500 ) BW = 500.0;
+	else BW = 125.0;
+
+	return pow(2,_spreadingFactor)/(BW);
+}
+
+/*
+ Function: It gets the theoretical value of the time-on-air of a FSK packet
+ Link: http://www.semtech.com/images/datasheet/sx1276.pdf
+ Returns: Float that determines the time-on-air
+*/
+float SX1278::timeOnAirFSK( uint16_t payloadlength )
+{
+	uint16_t bytes;
+	byte value;
+
+	// Preamble
+	bytes = ((uint16_t)readRegister(REG_PREAMBLE_MSB_FSK) << 8) | readRegister(REG_PREAMBLE_LSB_FSK);
+	// Sync word: SyncSize + 1 bytes when SyncOn
+	value = readRegister(REG_SYNC_CONFIG);
+	if( bitRead(value, 4) == 1 )
+	{
+		bytes += (value & B00000111) + 1;
+	}
+	// Length byte in variable length format
+	if( bitRead(readRegister(REG_PACKET_CONFIG1), 7) == 1 )
+	{
+		bytes++;
+	}
+	// Packet and CRC
+	bytes += payloadlength + OFFSET_PAYLOADLENGTH;
+	if( _CRC == CRC_ON )
+	{
+		bytes += 2;
+	}
+
+	return (8.0 * bytes * 1000.0) / _bitRate;
+}
+
+
+
+
+/*
+ Function: It sets a char array payload packet in a packet struct.
+ Returns:  Integer that determines if there has been any error
+   state = 2  --> The command has not been executed
+   state = 1  --> There has been an error while executing the command
+   state = 0  --> The command has been executed with no errors
+*/
+uint8_t SX1278::setPayload(char *payload)
+{
+	uint8_t state = 2;
+	uint8_t state_f = 2;
+	uint16_t length16;
+
+	#if (SX1278_debug_mode > 1)
+		Serial.println();
+		Serial.println(F("Starting 'setPayload'"));
+	#endif
+
+	state = 1;
+	length16 = (uint16_t)strlen(payload);
+	state = truncPayload(length16);
+	if( state == 0 )
+	{
+		// fill data field until the end of the string
+		for(unsigned int i = 0; i < _payloadlength; i++)
+		{
+			packet_sent.data[i] = payload[i];
+		}
+	}
+	else
+	{
+		state_f = state;
+	}
+	
+	// In the case of FSK mode, the max payload is more restrictive
+	if( ( _modem == FSK ) && ( _payloadlength > MAX_PAYLOAD_FSK ) )
+	{
+		_payloadlength = MAX_PAYLOAD_FSK;
+		state = 1;
+		#if (SX1278_debug_mode > 1)
+			Serial.println(F("In FSK, payload length must be less than 60 bytes."));
+			Serial.println();
+		#endif
+	}
+	
+	// Compressing and encrypting the payload if enabled
+	state = compressPayload();
+	if( state == 0 )
+	{
+		state = encryptPayload();
+	}
+	if( state != 0 )
+	{
+		return state;	// It must not be sent
+	}
+
+	// Set length with the actual counter value
+	// Setting packet length in packet structure
+	state_f = setPacketLength();	
+	return state_f;
+}
+
+/*
+ Function: It sets an uint8_t array payload packet in a packet struct.
+ Returns:  Integer that determines if there has been any error
+   state = 2  --> The command has not been executed
+   state = 1  --> There has been an error while executing the command
+   state = 0  --> The command has been executed with no errors
+*/
+uint8_t SX1278::setPayload(uint8_t *payload)
+{
+	uint8_t state = 2;
+
+	#if (SX1278_debug_mode > 1)
+		Serial.println();
+		Serial.println(F("Starting 'setPayload'"));
+	#endif
+
+	state = 1;
+	if( ( _modem == FSK ) && ( _payloadlength > MAX_PAYLOAD_FSK ) )
+	{
+		_payloadlength = MAX_PAYLOAD_FSK;
+		state = 1;
+		#if (SX1278_debug_mode > 1)
+			Serial.println(F("In FSK, payload length must be less than 60 bytes."));
+			Serial.println();
+		#endif
+	}
+	for(unsigned int i = 0; i < _payloadlength; i++)
+	{
+		packet_sent.data[i] = payload[i];	// Storing payload in packet structure
+	}
+	state = compressPayload();	// Compressing the payload if enabled
+	if( state == 0 )
+	{
+		state = encryptPayload();	// Encrypting the payload if enabled
+	}
+	if( state != 0 )
+	{
+		return state;	// It must not be sent
+	}
+	// set length with the actual counter value
+    state = setPacketLength();	// Setting packet length in packet structure
+	return state;
+}
+
+#if (SX1278_compression_mode > 0)
+// Dictionary of COMPRESSION_DICT: length prefixed words, '0' ends it.
+// Word 'i' is sent as byte 0x80 + i, byte 0xFF escapes a byte >= 0x80.
+static const char compressionDictionary[] PROGMEM =
+	"\x07" " packet" "\x06" "Packet" "\x09" " received" "\x05" " sent"
+	"\x05" " same" "\x04" " the" "\x03" " to" "\x03" " is" "\x03" " if"
+	"\x03" " as" "\x04" " see" "\x08" " wanting" "\x0A" " broadcast"
+	"\x05" " test" "\x0B" "temperature" "\x08" "humidity" "\x08" "pressure"
+	"\x07" "battery" "\x07" "voltage" "\x06" "sensor" "\x06" "status"
+	"\x05" "value" "\x05" "count" "\x05" "level" "\x05" "alarm" "\x05" "speed"
+	"\x04" "Temp" "\x03" "Hum" "\x05" "Press" "\x04" "Batt" "\x04" "Volt"
+	"\x04" "RSSI" "\x03" "SNR" "\x04" "Node" "\x04" "node" "\x03" "Lat"
+	"\x03" "Lon" "\x03" "Alt" "\x03" "GPS" "\x04" "time" "\x04" "data"
+	"\x04" "wind" "\x04" "rain" "\x04" "soil" "\x05" "water" "\x05" "light"
+	"\x02" "OK" "\x05" "ERROR" "\x02" "ID" "\x02" "{\"" "\x02" "\":"
+	"\x03" "\",\"" "\x02" "\"}" "\x02" ", " "\x02" ": " "\x02" ".0" "\x02" "00"
+	"\x02" "0." "\x02" "1." "\x02" "2." "\x02" "10" "\x02" "20" "\x02" " ="
+	"\x02" "= " "\x02" "\r\n";
+
+// Scratch buffer shared by compressPayload() and decompressPayload(), so
+// that they do not take MAX_PAYLOAD bytes of stack each.
+static uint8_t compressionBuffer[MAX_PAYLOAD];
+#endif
+
+/*
+ Function: Sets the compression of the payloads sent and received.
+ Returns: Integer that determines if there has been any error
+   state = 2  --> The command has not been executed
+   state = 1  --> There has been an error while executing the command
+   state = 0  --> The command has been executed with no errors
+ Parameters:
+   mode: COMPRESSION_NONE, COMPRESSION_DELTA, COMPRESSION_DICT or
+         COMPRESSION_CUSTOM.
+*/
+int8_t SX1278::setCompression(uint8_t mode)
+{
+	int8_t state = 2;
+
+	#if (SX1278_debug_mode > 1)
+		Serial.println();
+		Serial.println(F("Starting 'setCompression'"));
+	#endif
+
+	if( (mode > COMPRESSION_CUSTOM)
+		|| ((SX1278_compression_mode == 0) && (mode != COMPRESSION_NONE))
+		|| ((mode == COMPRESSION_CUSTOM) && ((_compressHandler == NULL) || (_decompressHandler == NULL))) )
+	{
+		state = 1;
+		#if (SX1278_debug_mode > 1)
+			Serial.println(F("** Unknown compression or handlers not set **"));
+			Serial.println();
+		#endif
+	}
+	else
+	{
+		_compression = mode;
+		state = 0;
+	}
+	return state;
+}
+
+/*
+ Function: Sets the handlers used with COMPRESSION_CUSTOM.
+ Parameters:
+   encode: payload compressor.
+   decode: payload decompressor.
+*/
+void SX1278::setCompressionHandler(compressHandler encode, compressHandler decode)
+{
+	_compressHandler = encode;
+	_decompressHandler = decode;
+}
+
+#if (SX1278_compression_mode > 0)
+/*
+ Function: Compresses the payload stored in 'packet_sent', adding the codec
+           byte. The payload is sent as is when it does not compress.
+ Returns: Integer that determines if there has been any error
+   state = 0  --> The command has been executed with no errors
+   state = 1  --> The payload is too long to fit the codec byte
+*/
+uint8_t SX1278::compressPayload()
+{
+	uint8_t state = 0;
+	uint8_t *buf = compressionBuffer;
+	uint16_t limit;
+	uint16_t n = 0;
+
+	if( (_compression == COMPRESSION_NONE) || (_fixedLength != 0) )
+	{
+		return 0;
+	}
+
+	// One byte is left for the codec and room for the security trailer
+	limit = ((_modem == LORA) ? MAX_PAYLOAD : MAX_PAYLOAD_FSK) - 1;
+	if( _security != SECURITY_NONE )
+	{
+		limit -= SECURITY_OVERHEAD;
+	}
+	switch( _compression )
+	{
+		case COMPRESSION_DELTA:		n = deltaEncode(packet_sent.data, _payloadlength, buf, limit);
+									break;
+		case COMPRESSION_DICT:		n = dictEncode(packet_sent.data, _payloadlength, buf, limit);
+									break;
+		case COMPRESSION_CUSTOM:	n = _compressHandler(packet_sent.data, _payloadlength, buf, limit);
+									break;
+	}
+
+	if( (n != 0) && (n < _payloadlength) )
+	{
+		memcpy( &packet_sent.data[1], buf, n );
+		packet_sent.data[0] = _compression;
+		_payloadlength = n + 1;
+	}
+	else
+	{
+		// Not compressed
+		if( _payloadlength > limit )
+		{
+			_payloadlength = limit;
+			state = 1;
+		}
+		memmove( &packet_sent.data[1], packet_sent.data, _payloadlength );
+		packet_sent.data[0] = COMPRESSION_NONE;
+		_payloadlength++;
+	}
+
+	#if (SX1278_debug_mode > 1)
+		Serial.print(F("## Payload compressed to "));
+		Serial.print(_payloadlength, DEC);
+		Serial.println(F(" bytes ##"));
+	#endif
+	return state;
+}
+
+/*
+ Function: Decompresses the payload stored in 'packet_received' according to
+           its codec byte.
+ Returns: Integer that determines if there has been any error
+   state = 0  --> The command has been executed with no errors
+   state = 1  --> There has been an error while executing the command
+*/
+uint8_t SX1278::decompressPayload()
+{
+	uint8_t *buf = compressionBuffer;
+	uint16_t n = 0;
+
+	if( (_compression == COMPRESSION_NONE) || (_fixedLength != 0) )
+	{
+		return 0;
+	}
+	if( _payloadlength == 0 )
+	{
+		return 1;
+	}
+
+	switch( packet_received.data[0] )
+	{
+		case COMPRESSION_NONE:		memmove( packet_received.data, &packet_received.data[1], _payloadlength - 1 );
+									_payloadlength--;
+									return 0;
+		case COMPRESSION_DELTA:		n = deltaDecode(&packet_received.data[1], _payloadlength - 1, buf, MAX_PAYLOAD);
+									break;
+		case COMPRESSION_DICT:		n = dictDecode(&packet_received.data[1], _payloadlength - 1, buf, MAX_PAYLOAD);
+									break;
+		case COMPRESSION_CUSTOM:	if( _decompressHandler != NULL )
+									{
+										n = _decompressHandler(&packet_received.data[1], _payloadlength - 1, buf, MAX_PAYLOAD);
+									}
+									break;
+	}
+
+	if( n == 0 )
+	{
+		#if (SX1278_debug_mode > 0)
+			Serial.println(F("** Payload can not be decompressed **"));
+		#endif
+		return 1;
+	}
+	memcpy( packet_received.data, buf, n );
+	_payloadlength = n;
+	return 0;
+}
+
+/*
+ Function: Encodes little endian int16 values as zigzag varint deltas.
+ Returns: Bytes written in 'out', '0' on error
+*/
+uint16_t SX1278::deltaEncode(uint8_t *in, uint16_t length, uint8_t *out, uint16_t size)
+{
+	uint16_t n = 0;
+	uint16_t prev = 0;
+	uint16_t value;
+	uint16_t z;
+	int16_t d;
+
+	if( (length == 0) || (length % 2 != 0) )
+	{
+		return 0;
+	}
+	for( uint16_t i = 0; i < length; i += 2 )
+	{
+		value = in[i] | ((uint16_t)in[i + 1] << 8);
+		d = (int16_t)(value - prev);
+		z = ((uint16_t)d << 1) ^ (uint16_t)(d >> 15);
+		prev = value;
+		while( z >= 0x80 )
+		{
+			if( n >= size )
+			{
+				return 0;
+			}
+			out[n++] = (z & 0x7F) | 0x80;
+			z >>= 7;
+		}
+		if( n >= size )
+		{
+			return 0;
+		}
+		out[n++] = z;
+	}
+	return n;
+}
+
+/*
+ Function: Decodes zigzag varint deltas to little endian int16 values.
+ Returns: Bytes written in 'out', '0' on error
+*/
+uint16_t SX1278::deltaDecode(uint8_t *in, uint16_t length, uint8_t *out, uint16_t size)
+{
+	uint16_t n = 0;
+	uint16_t prev = 0;
+	uint16_t z = 0;
+	uint8_t shift = 0;
+
+	for( uint16_t i = 0; i < length; i++ )
+	{
+		z |= (uint16_t)(in[i] & 0x7F) << shift;
+		if( in[i] & 0x80 )
+		{
+			shift += 7;
+			if( shift > 14 )
+			{
+				return 0;
+			}
+			continue;
+		}
+		if( n + 2 > size )
+		{
+			return 0;
+		}
+		prev += (z >> 1) ^ (uint16_t)(-(int16_t)(z & 0x01));
+		out[n++] = prev & 0xFF;
+		out[n++] = prev >> 8;
+		z = 0;
+		shift = 0;
+	}
+	// A varint can not be left unfinished
+	if( shift != 0 )
+	{
+		return 0;
+	}
+	return n;
+}
+
+/*
+ Function: Replaces the longest words of the static dictionary by one byte.
+ Returns: Bytes written in 'out', '0' on error
+*/
+uint16_t SX1278::dictEncode(uint8_t *in, uint16_t length, uint8_t *out, uint16_t size)
+{
+	uint16_t n = 0;
+	uint16_t i = 0;
+	uint16_t p;
+	uint8_t len;
+	uint8_t word;
+	uint8_t best;
+	uint8_t bestLen;
+	uint8_t k;
+
+	while( i < length )
+	{
+		// Longest word of the dictionary at this position
+		best = 0;
+		bestLen = 0;
+		p = 0;
+		word = 0;
+		while( (len = pgm_read_byte(&compressionDictionary[p])) != 0 )
+		{
+			if( (len > bestLen) && (len <= length - i) )
+			{
+				for( k = 0; k < len; k++ )
+				{
+					if( pgm_read_byte(&compressionDictionary[p + 1 + k]) != in[i + k] )
+					{
+						break;
+					}
+				}
+				if( k == len )
+				{
+					best = word;
+					bestLen = len;
+				}
+			}
+			p += len + 1;
+			word++;
+		}
+
+		if( bestLen != 0 )
+		{
+			if( n >= size )
+			{
+				return 0;
+			}
+			out[n++] = 0x80 + best;
+			i += bestLen;
+		}
+		else if( in[i] >= 0x80 )
+		{
+			if( n + 2 > size )
+			{
+				return 0;
+			}
+			out[n++] = 0xFF;
+			out[n++] = in[i++];
+		}
+		else
+		{
+			if( n >= size )
+			{
+				return 0;
+			}
+			out[n++] = in[i++];
+		}
+	}
+	return n;
+}
+
+/*
+ Function: Expands the words of the static dictionary.
+ Returns: Bytes written in 'out', '0' on error
+*/
+uint16_t SX1278::dictDecode(uint8_t *in, uint16_t length, uint8_t *out, uint16_t size)
+{
+	uint16_t n = 0;
+	uint16_t p;
+	uint8_t len;
+	uint8_t word;
+
+	for( uint16_t i = 0; i < length; i++ )
+	{
+		if( in[i] < 0x80 )
+		{
+			if( n >= size )
+			{
+				return 0;
+			}
+			out[n++] = in[i];
+		}
+		else if( in[i] == 0xFF )
+		{
+			if( (i + 1 >= length) || (n >= size) )
+			{
+				return 0;
+			}
+			out[n++] = in[++i];
+		}
+		else
+		{
+			// Look for the word in the dictionary
+			p = 0;
+			word = 0;
+			while( ((len = pgm_read_byte(&compressionDictionary[p])) != 0) && (word < in[i] - 0x80) )
+			{
+				p += len + 1;
+				word++;
+			}
+			if( (len == 0) || (n + len > size) )
+			{
+				return 0;
+			}
+			for( uint8_t k = 0; k < len; k++ )
+			{
+				out[n++] = pgm_read_byte(&compressionDictionary[p + 1 + k]);
+			}
+		}
+	}
+	return n;
+}
+#else
+/*
+ Function: Compression is not compiled, the payload is sent as is.
+ Returns: '0'
+*/
+uint8_t SX1278::compressPayload()
+{
+	return 0;
+}
+
+/*
+ Function: Compression is not compiled, the payload is received as is.
+ Returns: '0'
+*/
+uint8_t SX1278::decompressPayload()
+{
+	return 0;
+}
+#endif
+
+/*
+ AES S-box, used by 'aesEncrypt'.
+*/
+static const uint8_t aesSbox[256] PROGMEM = {
+	0x63, 0x7C, 0x77, 0x7B, 0xF2, 0x6B, 0x6F, 0xC5, 0x30, 0x01, 0x67, 0x2B, 0xFE, 0xD7, 0xAB, 0x76,
+	0xCA, 0x82, 0xC9, 0x7D, 0xFA, 0x59, 0x47, 0xF0, 0xAD, 0xD4, 0xA2, 0xAF, 0x9C, 0xA4, 0x72, 0xC0,
+	0xB7, 0xFD, 0x93, 0x26, 0x36, 0x3F, 0xF7, 0xCC, 0x34, 0xA5, 0xE5, 0xF1, 0x71, 0xD8, 0x31, 0x15,
+	0x04, 0xC7, 0x23, 0xC3, 0x18, 0x96, 0x05, 0x9A, 0x07, 0x12, 0x80, 0xE2, 0xEB, 0x27, 0xB2, 0x75,
+	0x09, 0x83, 0x2C, 0x1A, 0x1B, 0x6E, 0x5A, 0xA0, 0x52, 0x3B, 0xD6, 0xB3, 0x29, 0xE3, 0x2F, 0x84,
+	0x53, 0xD1, 0x00, 0xED, 0x20, 0xFC, 0xB1, 0x5B, 0x6A, 0xCB, 0xBE, 0x39, 0x4A, 0x4C, 0x58, 0xCF,
+	0xD0, 0xEF, 0xAA, 0xFB, 0x43, 0x4D, 0x33, 0x85, 0x45, 0xF9, 0x02, 0x7F, 0x50, 0x3C, 0x9F, 0xA8,
+	0x51, 0xA3, 0x40, 0x8F, 0x92, 0x9D, 0x38, 0xF5, 0xBC, 0xB6, 0xDA, 0x21, 0x10, 0xFF, 0xF3, 0xD2,
+	0xCD, 0x0C, 0x13, 0xEC, 0x5F, 0x97, 0x44, 0x17, 0xC4, 0xA7, 0x7E, 0x3D, 0x64, 0x5D, 0x19, 0x73,
+	0x60, 0x81, 0x4F, 0xDC, 0x22, 0x2A, 0x90, 0x88, 0x46, 0xEE, 0xB8, 0x14, 0xDE, 0x5E, 0x0B, 0xDB,
+	0xE0, 0x32, 0x3A, 0x0A, 0x49, 0x06, 0x24, 0x5C, 0xC2, 0xD3, 0xAC, 0x62, 0x91, 0x95, 0xE4, 0x79,
+	0xE7, 0xC8, 0x37, 0x6D, 0x8D, 0xD5, 0x4E, 0xA9, 0x6C, 0x56, 0xF4, 0xEA, 0x65, 0x7A, 0xAE, 0x08,
+	0xBA, 0x78, 0x25, 0x2E, 0x1C, 0xA6, 0xB4, 0xC6, 0xE8, 0xDD, 0x74, 0x1F, 0x4B, 0xBD, 0x8B, 0x8A,
+	0x70, 0x3E, 0xB5, 0x66, 0x48, 0x03, 0xF6, 0x0E, 0x61, 0x35, 0x57, 0xB9, 0x86, 0xC1, 0x1D, 0x9E,
+	0xE1, 0xF8, 0x98, 0x11, 0x69, 0xD9, 0x8E, 0x94, 0x9B, 0x1E, 0x87, 0xE9, 0xCE, 0x55, 0x28, 0xDF,
+	0x8C, 0xA1, 0x89, 0x0D, 0xBF, 0xE6, 0x42, 0x68, 0x41, 0x99, 0x2D, 0x0F, 0xB0, 0x54, 0xBB, 0x16
+};
+
+/*
+ Function: Enables the authenticated encryption (AES-128-CCM) of the payloads
+           sent and received.
+ Returns: Integer that determines if there has been any error
+   state = 2  --> The command has not been executed
+   state = 1  --> There has been an error while executing the command
+   state = 0  --> The command has been executed with no errors
+   state = -1 --> Forbidden command in fixed length mode
+ Parameters:
+   key: 16 bytes AES key, NULL to disable the encryption.
+*/
+int8_t SX1278::setSecurity(const uint8_t *key)
+{
+	int8_t state = 2;
+
+	#if (SX1278_debug_mode > 1)
+		Serial.println();
+		Serial.println(F("Starting 'setSecurity'"));
+	#endif
+
+	if( key == NULL )
+	{
+		_security = SECURITY_NONE;
+		memset( _secKey, 0x00, sizeof(_secKey) );
+		state = 0;
+	}
+	else if( _fixedLength != 0 )
+	{
+		state = -1;		// fixed length frames are sent in plaintext
+		#if (SX1278_debug_mode > 1)
+			Serial.println(F("** Encryption is not available with a fixed length **"));
+			Serial.println();
+		#endif
+	}
+	else
+	{
+		memcpy( _secKey, key, sizeof(_secKey) );
+		_security = SECURITY_AES_CCM;
+		_secPeers = 0;	// The counters of the peers belong to the old key
+		state = 0;
+	}
+	return state;
+}
+
+/*
+ Function: Sets the frame counter used in the nonce. It must never go back
+           with the same key, so it should be stored before a reset.
+ Parameters:
+   counter: next frame counter (24 bits).
+*/
+void SX1278::setSecurityCounter(uint32_t counter)
+{
+	_secCounter = counter;
+}
+
+/*
+ Function: Encrypts a 16 bytes block with AES-128. The round keys are
+           computed on the fly to save RAM.
+ Parameters:
+   block: block to encrypt in place.
+*/
+void SX1278::aesEncrypt(uint8_t *block)
+{
+	uint8_t rk[16];
+	uint8_t rcon = 0x01;
+	uint8_t a0, a1, a2, a3, all;
+	uint8_t tmp;
+
+	memcpy( rk, _secKey, 16 );
+	for( uint8_t i = 0; i < 16; i++ )
+	{
+		block[i] ^= rk[i];
+	}
+	for( uint8_t round = 1; round <= 10; round++ )
+	{
+		// SubBytes
+		for( uint8_t i = 0; i < 16; i++ )
+		{
+			block[i] = pgm_read_byte(&aesSbox[block[i]]);
+		}
+		// ShiftRows
+		tmp = block[1];
+		block[1] = block[5];
+		block[5] = block[9];
+		block[9] = block[13];
+		block[13] = tmp;
+		tmp = block[2];
+		block[2] = block[10];
+		block[10] = tmp;
+		tmp = block[6];
+		block[6] = block[14];
+		block[14] = tmp;
+		tmp = block[15];
+		block[15] = block[11];
+		block[11] = block[7];
+		block[7] = block[3];
+		block[3] = tmp;
+		// MixColumns, not in the last round
+		if( round < 10 )
+		{
+			for( uint8_t c = 0; c < 16; c += 4 )
+			{
+				a0 = block[c];
+				a1 = block[c + 1];
+				a2 = block[c + 2];
+				a3 = block[c + 3];
+				all = a0 ^ a1 ^ a2 ^ a3;
+				block[c] ^= all ^ aesXtime(a0 ^ a1);
+				block[c + 1] ^= all ^ aesXtime(a1 ^ a2);
+				block[c + 2] ^= all ^ aesXtime(a2 ^ a3);
+				block[c + 3] ^= all ^ aesXtime(a3 ^ a0);
+			}
+		}
+		// Next round key
+		rk[0] ^= pgm_read_byte(&aesSbox[rk[13]]) ^ rcon;
+		rk[1] ^= pgm_read_byte(&aesSbox[rk[14]]);
+		rk[2] ^= pgm_read_byte(&aesSbox[rk[15]]);
+		rk[3] ^= pgm_read_byte(&aesSbox[rk[12]]);
+		for( uint8_t i = 4; i < 16; i++ )
+		{
+			rk[i] ^= rk[i - 4];
+		}
+		rcon = aesXtime(rcon);
+		// AddRoundKey
+		for( uint8_t i = 0; i < 16; i++ )
+		{
+			block[i] ^= rk[i];
+		}
+	}
+}
+
+/*
+ Function: Multiplies by x in GF(2^8) with the AES polynomial.
+*/
+uint8_t SX1278::aesXtime(uint8_t a)
+{
+	return (a & 0x80) ? ((a << 1) ^ 0x1B) : (a << 1);
+}
+
+/*
+ Function: Builds a CCM block: flags, 13 bytes nonce and a 16 bits value
+           (message length or counter).
+*/
+void SX1278::ccmBlock(uint8_t *block, uint8_t flags, uint8_t *nonce, uint16_t value)
+{
+	block[0] = flags;
+	memcpy( &block[1], nonce, CCM_NONCE_LENGTH );
+	block[14] = value >> 8;
+	block[15] = value & 0xFF;
+}
+
+/*
+ Function: Computes the CBC-MAC of a CCM message (without associated data).
+ Parameters:
+   data: plaintext.
+   length: plaintext length.
+   nonce: 13 bytes nonce.
+   tag: where the SECURITY_TAG bytes of the MAC are written.
+*/
+void SX1278::ccmMAC(uint8_t *data, uint16_t length, uint8_t *nonce, uint8_t *tag)
+{
+	uint8_t x[16];
+
+	ccmBlock(x, CCM_FLAGS_MAC, nonce, length);
+	aesEncrypt(x);
+	for( uint16_t i = 0; i < length; i += 16 )
+	{
+		for( uint8_t k = 0; (k < 16) && (i + k < length); k++ )
+		{
+			x[k] ^= data[i + k];
+		}
+		aesEncrypt(x);
+	}
+	memcpy( tag, x, SECURITY_TAG );
+}
+
+/*
+ Function: Encrypts or decrypts a CCM message and its tag in counter mode.
+ Parameters:
+   data: message, changed in place.
+   length: message length.
+   nonce: 13 bytes nonce.
+   tag: SECURITY_TAG bytes tag, changed in place.
+*/
+void SX1278::ccmCTR(uint8_t *data, uint16_t length, uint8_t *nonce, uint8_t *tag)
+{
+	uint8_t s[16];
+
+	// A0 encrypts the tag
+	ccmBlock(s, CCM_FLAGS_CTR, nonce, 0);
+	aesEncrypt(s);
+	for( uint8_t k = 0; k < SECURITY_TAG; k++ )
+	{
+		tag[k] ^= s[k];
+	}
+	for( uint16_t i = 0; i < length; i += 16 )
+	{
+		ccmBlock(s, CCM_FLAGS_CTR, nonce, (i / 16) + 1);
+		aesEncrypt(s);
+		for( uint8_t k = 0; (k < 16) && (i + k < length); k++ )
+		{
+			data[i + k] ^= s[k];
+		}
+	}
+}
+
+/*
+ Function: Builds the nonce of a frame from its header and its counter.
+*/
+void SX1278::ccmNonce(uint8_t *nonce, uint8_t src, uint8_t dst, uint8_t packnum, uint32_t counter)
+{
+	memset( nonce, 0x00, CCM_NONCE_LENGTH );
+	nonce[0] = src;
+	nonce[1] = dst;
+	nonce[2] = packnum;
+	nonce[3] = counter & 0xFF;
+	nonce[4] = (counter >> 8) & 0xFF;
+	nonce[5] = (counter >> 16) & 0xFF;
+}
+
+/*
+ Function: Encrypts the payload stored in 'packet_sent' and appends the frame
+           counter and the tag.
+ Returns: Integer that determines if there has been any error
+   state = 0  --> The command has been executed with no errors
+   state = 1  --> The payload is too long or the counter is exhausted
+*/
+uint8_t SX1278::encryptPayload()
+{
+	uint8_t state = 0;
+	uint8_t nonce[CCM_NONCE_LENGTH];
+	uint8_t *trailer;
+	uint16_t limit;
+
+	if( (_security == SECURITY_NONE) || (_fixedLength != 0) )
+	{
+		return 0;
+	}
+	if( _secCounter > MAX_SECURITY_COUNTER )
+	{
+		#if (SX1278_debug_mode > 0)
+			Serial.println(F("** Frame counter exhausted, a new key must be set **"));
+		#endif
+		_payloadlength = 0;
+		return 1;
+	}
+
+	limit = ((_modem == LORA) ? MAX_PAYLOAD : MAX_PAYLOAD_FSK) - SECURITY_OVERHEAD;
+	if( _payloadlength > limit )
+	{
+		#if (SX1278_debug_mode > 0)
+			Serial.println(F("** Payload too long to be encrypted **"));
+		#endif
+		return 1;
+	}
+
+	ccmNonce(nonce, packet_sent.src, packet_sent.dst, packet_sent.packnum, _secCounter);
+	trailer = &packet_sent.data[_payloadlength];
+	trailer[0] = _secCounter & 0xFF;
+	trailer[1] = (_secCounter >> 8) & 0xFF;
+	trailer[2] = (_secCounter >> 16) & 0xFF;
+	ccmMAC(packet_sent.data, _payloadlength, nonce, &trailer[SECURITY_COUNTER]);
+	ccmCTR(packet_sent.data, _payloadlength, nonce, &trailer[SECURITY_COUNTER]);
+	_payloadlength += SECURITY_OVERHEAD;
+	_secCounter++;
+	return state;
+}
+
+/*
+ Function: Encrypts again the payload stored in 'packet_sent' with a new frame
+           counter, so that the receiver does not reject a retry as a replay.
+ Returns: Integer that determines if there has been any error
+   state = 0  --> The command has been executed with no errors
+   state = 1  --> The counter is exhausted
+*/
+uint8_t SX1278::renewPayload()
+{
+	uint8_t nonce[CCM_NONCE_LENGTH];
+	uint8_t *trailer;
+	uint32_t counter;
+
+	if( (_security == SECURITY_NONE) || (_fixedLength != 0) || (_payloadlength < SECURITY_OVERHEAD) )
+	{
+		return 0;
+	}
+
+	// CTR mode is symmetric, so this gets the plaintext back
+	_payloadlength -= SECURITY_OVERHEAD;
+	trailer = &packet_sent.data[_payloadlength];
+	counter = trailer[0] | ((uint32_t)trailer[1] << 8) | ((uint32_t)trailer[2] << 16);
+	ccmNonce(nonce, packet_sent.src, packet_sent.dst, packet_sent.packnum, counter);
+	ccmCTR(packet_sent.data, _payloadlength, nonce, &trailer[SECURITY_COUNTER]);
+	return encryptPayload();
+}
+
+/*
+ Function: Checks the tag and decrypts the payload stored in 'packet_received'.
+ Returns: Integer that determines if there has been any error
+   state = 0  --> The command has been executed with no errors
+   state = 1  --> The frame is not authentic or it is a replay
+*/
+uint8_t SX1278::decryptPayload()
+{
+	uint8_t nonce[CCM_NONCE_LENGTH];
+	uint8_t tag[SECURITY_TAG];
+	uint8_t *trailer;
+	uint8_t diff = 0;
+	uint8_t peer;
+	uint32_t counter;
+
+	if( (_security == SECURITY_NONE) || (_fixedLength != 0) )
+	{
+		return 0;
+	}
+	if( _payloadlength < SECURITY_OVERHEAD )
+	{
+		return 1;
+	}
+
+	_payloadlength -= SECURITY_OVERHEAD;
+	trailer = &packet_received.data[_payloadlength];
+	counter = trailer[0] | ((uint32_t)trailer[1] << 8) | ((uint32_t)trailer[2] << 16);
+	ccmNonce(nonce, packet_received.src, packet_received.dst, packet_received.packnum, counter);
+	ccmCTR(packet_received.data, _payloadlength, nonce, &trailer[SECURITY_COUNTER]);
+	ccmMAC(packet_received.data, _payloadlength, nonce, tag);
+	for( uint8_t k = 0; k < SECURITY_TAG; k++ )
+	{
+		diff |= tag[k] ^ trailer[SECURITY_COUNTER + k];
+	}
+	if( diff != 0 )
+	{
+		#if (SX1278_debug_mode > 0)
+			Serial.println(F("** Packet not authentic, tag mismatch **"));
+		#endif
+		// Do not leave the unauthenticated plaintext
+		memset( packet_received.data, 0x00, _payloadlength );
+		_payloadlength = 0;
+		return 1;
+	}
+
+	// The counter of each source must grow, an older frame is a replay
+	for( peer = 0; peer < _secPeers; peer++ )
+	{
+		if( _secPeer[peer] == packet_received.src )
+		{
+			break;
+		}
+	}
+	if( (peer < _secPeers) && (counter <= _secPeerCounter[peer]) )
+	{
+		#if (SX1278_debug_mode > 0)
+			Serial.println(F("** Packet rejected, replayed frame counter **"));
+		#endif
+		memset( packet_received.data, 0x00, _payloadlength );
+		_payloadlength = 0;
+		return 1;
+	}
+	if( peer == _secPeers )
+	{
+		if( _secPeers < SECURITY_PEERS )
+		{
+			_secPeers++;
+		}
+		else
+		{
+			peer--;		// The least recently heard source is forgotten
+		}
+	}
+	// The table is kept from the most to the least recently heard source
+	for( ; peer > 0; peer-- )
+	{
+		_secPeer[peer] = _secPeer[peer - 1];
+		_secPeerCounter[peer] = _secPeerCounter[peer - 1];
+	}
+	_secPeer[0] = packet_received.src;
+	_secPeerCounter[0] = counter;
+	return 0;
+}
+
+/*
+ Function: It sets a packet struct in FIFO in order to send it.
+ Returns:  Integer that determines if there has been any error
+   state = 2  --> The command has not been executed
+   state = 1  --> There has been an error while executing the command
+   state = 0  --> The command has been executed with no errors
+*/
+uint8_t SX1278::setPacket(uint8_t dest, char *payload)
+{
+	int8_t state = 2;
+	byte st0;
+
+	#if (SX1278_debug_mode > 1)
+		Serial.println();
+		Serial.println(F("Starting 'setPacket'"));
+	#endif
+	SX1278_TIME_CALL(INSTR_SET_PACKET);
+	SX1278_TRACE(TRACE_CALL, 0, INSTR_SET_PACKET);
+	
+	// The FIFO is not available in sleep mode
+	wake();
+	// Save the previous status
+	st0 = _opMode;
+	// Initializing flags
+	clearFlags();	
+	// The new packet overwrites the one armed by 'prepareTx'
+	_txArmed = false;
+
+	if( _modem == LORA )
+	{ // LoRa mode
+		setOpMode(LORA_STANDBY_MODE);	// Stdby LoRa mode to write in FIFO
+	}
+	else
+	{ // FSK mode
+		setOpMode(FSK_STANDBY_MODE);	// Stdby FSK mode to write in FIFO
+	}
+	
+	// Updating incorrect value
+	_reception = CORRECT_PACKET;	
+	
+	
+	if (_retries == 0)
+	{ 
+		// Updating these values only if it is the first try
+		// Setting destination in packet structure
+		state = setDestination(dest);	
+		if( state == 0 )
+		{
+			state = setPayload(payload);
+		}
+	}
+	else
+	{
+		state = renewPayload();	// A new frame counter for the retry
+		if( state == 0 )
+		{
+			state = setPacketLength();
+		}
+		packet_sent.retry = _retries;
+		#if (SX1278_debug_mode > 0)
+			Serial.print(F("** Retrying to send last packet "));
+			Serial.print(_retries, DEC);
+			Serial.println(F(" time **"));
+		#endif
+	}
+	
+	// Setting address pointer in FIFO data buffer
+	writeRegister(REG_FIFO_TX_BASE_ADDR, 0x00);  
+	writeRegister(REG_FIFO_ADDR_PTR, 0x00);  
+	if( state == 0 )
+	{
+		// Writing packet to send in FIFO
+		state = writePacket();
+		_txDest = packet_sent.dst;
+	}
+	setOpMode(st0);	// Getting back to previous status
+	return state;
+}
+
+/*
+ Function: It sets a packet struct in FIFO in order to sent it.
+ Returns:  Integer that determines if there has been any error
+   state = 2  --> The command has not been executed
+   state = 1  --> There has been an error while executing the command
+   state = 0  --> The command has been executed with no errors
+*/
+uint8_t SX1278::setPacket(uint8_t dest, uint8_t *payload)
+{
+	int8_t state = 2;
+	byte st0;
+
+	#if (SX1278_debug_mode > 1)
+		Serial.println();
+		Serial.println(F("Starting 'setPacket'"));
+	#endif
+	SX1278_TIME_CALL(INSTR_SET_PACKET);
+	SX1278_TRACE(TRACE_CALL, 0, INSTR_SET_PACKET);
+
+	wake();	// The FIFO is not available in sleep mode
+	st0 = _opMode;	// Save the previous status
+	clearFlags();	// Initializing flags
+	_txArmed = false;	// The new packet overwrites the armed one
+
+	if( _modem == LORA )
+	{ // LoRa mode
+		setOpMode(LORA_STANDBY_MODE);	// Stdby LoRa mode to write in FIFO
+	}
+	else
+	{ // FSK mode
+		setOpMode(FSK_STANDBY_MODE);	// Stdby FSK mode to write in FIFO
+	}
+
+	_reception = CORRECT_PACKET;	// Updating incorrect value to send a packet (old or new)
+	if(_retries == 0)
+	{ // Sending new packet
+		state = setDestination(dest);	// Setting destination in packet structure
+		if( state == 0 )
+		{
+			state = setPayload(payload);
+		}
+	}
+	else
+	{
+		state = renewPayload();	// A new frame counter for the retry
+		if( state == 0 )
+		{
+			state = setPacketLength();
+		}
+		packet_sent.retry = _retries;
+		#if (SX1278_debug_mode > 0)
+			Serial.print(F("** Retrying to send last packet "));
+			Serial.print(_retries, DEC);
+			Serial.println(F(" time **"));
+		#endif
+	}
+	writeRegister(REG_FIFO_TX_BASE_ADDR, 0x00);
+	writeRegister(REG_FIFO_ADDR_PTR, 0x00);  // Setting address pointer in FIFO data buffer
+	if( state == 0 )
+	{
+		// Writing packet to send in FIFO
+		state = writePacket();
+		_txDest = packet_sent.dst;
+	}
+	setOpMode(st0);	// Getting back to previous status
+	return state;
+}
+
+/*
+ Function: Writes the packet stored in 'packet_sent' in FIFO. In fixed length
+           mode only the payload is written, padded with zeros to the fixed length.
+ Returns:  Integer that determines if there has been any error
+   state = 2  --> The command has not been executed
+   state = 1  --> There has been an error while executing the command
+   state = 0  --> The command has been executed with no errors
+*/
+uint8_t SX1278::writePacket()
+{
+	uint8_t state = 2;
+	byte format;
+
+	#if (SX1278_debug_mode > 1)
+		Serial.println();
+		Serial.println(F("Starting 'writePacket'"));
+	#endif
+
+	state = 1;
+	if( _fixedLength != 0 )
+	{ // Implicit header: payload only, no addressing bytes
+		if( _payloadlength > _fixedLength )
+		{
+			#if (SX1278_debug_mode > 0)
+				Serial.println(F("** Payload longer than the fixed length **"));
+			#endif
+			return state;
+		}
+		// Writing the payload in FIFO
+		writeRegisters(REG_FIFO, packet_sent.data, _payloadlength);
+		for( uint16_t i = _payloadlength; i < _fixedLength; i++)
+		{
+			writeRegister(REG_FIFO, 0x00);	// Padding up to the fixed length
+		}
+		state = 0;
+		#if (SX1278_debug_mode > 0)
+			Serial.println(F("## Fixed length packet written in FIFO ##"));
+		#endif
+		return state;
+	}
+
+	if( (_modem == LORA) && (_frameFormat == FRAME_FORMAT_COMPACT) )
+	{
+		// Format byte: version, broadcast flag and retry number
+		format = FRAME_VERSION_COMPACT | (packet_sent.retry & FRAME_RETRY_MASK);
+		if( packet_sent.dst == BROADCAST_0 )
+		{
+			format |= FRAME_FLAG_BROADCAST;
+		}
+		writeRegister(REG_FIFO, format);
+		if( packet_sent.dst != BROADCAST_0 )
+		{
+			writeRegister(REG_FIFO, packet_sent.dst); 	// Writing the destination in FIFO
+		}
+		writeRegister(REG_FIFO, packet_sent.src);		// Writing the source in FIFO
+		writeRegister(REG_FIFO, packet_sent.packnum);	// Writing the packet number in FIFO
+		writeRegisters(REG_FIFO, packet_sent.data, _payloadlength);  // Writing the payload in FIFO
+		state = 0;
+		#if (SX1278_debug_mode > 0)
+			Serial.println(F("## Compact packet written in FIFO ##"));
+		#endif
+		return state;
+	}
+
+	writeRegister(REG_FIFO, packet_sent.dst); 		// Writing the destination in FIFO
+	writeRegister(REG_FIFO, packet_sent.src);		// Writing the source in FIFO
+	writeRegister(REG_FIFO, packet_sent.packnum);	// Writing the packet number in FIFO
+	writeRegister(REG_FIFO, packet_sent.length); 	// Writing the packet length in FIFO
+	writeRegisters(REG_FIFO, packet_sent.data, _payloadlength);  // Writing the payload in FIFO
+	writeRegister(REG_FIFO, packet_sent.retry);		// Writing the number retry in FIFO
+	state = 0;
+	#if (SX1278_debug_mode > 0)
+		Serial.println(F("## Packet set and written in FIFO ##"));
+		// Print the complete packet if debug_mode
+		Serial.print(F("## Packet to send: "));
+		Serial.print(packet_sent.dst, HEX);			 	// Printing destination
+		Serial.print("|");
+		Serial.print(packet_sent.src, HEX);			 	// Printing source
+		Serial.print("|");
+		Serial.print(packet_sent.packnum, HEX);			// Printing packet number
+		Serial.print("|");
+		Serial.print(packet_sent.length, HEX);			// Printing packet length
+		Serial.print("|");
+		for( uint16_t i = 0; i < _payloadlength; i++)
+		{
+			Serial.print(packet_sent.data[i], HEX);		// Printing payload
+			Serial.print("|");
+		}
+		Serial.print(packet_sent.retry, HEX);			// Printing retry number
+		Serial.println(F(" ##"));
+	#endif
+	return state;
+}
+
+/*
+ Function: Reads the destination at the current FIFO address pointer. In compact
+           format the format byte is read first and stored in '_rxFormat'.
+ Returns:  Destination of the received frame
+*/
+uint8_t SX1278::readDestination()
+{
+	if( (_modem == LORA) && (_frameFormat == FRAME_FORMAT_COMPACT) )
+	{
+		_rxFormat = readRegister(REG_FIFO);
+		if( bitRead(_rxFormat, 3) == 1 )
+		{
+			// Broadcast frames do not carry the destination
+			return BROADCAST_0;
+		}
+	}
+	return readRegister(REG_FIFO);
+}
+
+/*
+ Function: Configures the module to transmit information.
+ Returns: Integer that determines if there has been any error
+   state = 2  --> The command has not been executed
+   state = 1  --> There has been an error while executing the command
+   state = 0  --> The command has been executed with no errors
+*/
+uint8_t SX1278::sendWithMAXTimeout()
+{
+	return sendWithTimeout(MAX_TIMEOUT);
+}
+
+/*
+ Function: Configures the module to transmit information.
+ Returns: Integer that determines if there has been any error
+   state = 2  --> The command has not been executed
+   state = 1  --> There has been an error while executing the command
+   state = 0  --> The command has been executed with no errors
+*/
+uint8_t SX1278::sendWithTimeout()
+{
+	setTimeout();
+	return sendWithTimeout(_sendTime);
+}
+
+/*
+ Function: Configures the module to transmit information.
+ Returns: Integer that determines if there has been any error
+   state = 2  --> The command has not been executed
+   state = 1  --> There has been an error while executing the command
+   state = 0  --> The command has been executed with no errors
+*/
+uint8_t SX1278::sendWithTimeout(uint32_t wait)
+{
+	#if (SX1278_debug_mode > 1)
+		Serial.println();
+		Serial.println(F("Starting 'sendWithTimeout'"));
+	#endif
+	SX1278_TIME_CALL(INSTR_SEND);
+	SX1278_TRACE(TRACE_CALL, 0, INSTR_SEND);
+
+	armTx();
+	fireTx();
+	return waitTxDone(wait);
+}
+
+/*
+ Function: Loads the packet in FIFO and leaves the module ready to transmit
+ it with 'fireTx'. The module stays in standby until then.
+ Returns: Integer that determines if there has been any error
+   state = 2  --> The command has not been executed
+   state = 1  --> There has been an error while executing the command
+   state = 0  --> The command has been executed with no errors
+ Parameters:
+   dest: packet destination
+   payload: packet payload
+   length16: payload buffer length
+*/
+uint8_t SX1278::prepareTx(uint8_t dest, uint8_t *payload, uint16_t length16)
+{
+	uint8_t state = 2;
+
+	#if (SX1278_debug_mode > 1)
+		Serial.println();
+		Serial.println(F("Starting 'prepareTx'"));
+	#endif
+
+	state = truncPayload(length16);
+	if( state == 0 )
+	{
+		state = setPacket(dest, payload);	// Setting a packet with 'dest' destination
+	}										// and writing it in FIFO.
+	if( state == 0 )
+	{
 		if( _modem == LORA )
-		{				
-			// Setting standby LoRa mode
-//~ 			writeRegister(REG_OP_MODE, LORA_STANDBY_MODE);	
+		{
+			setOpMode(LORA_STANDBY_MODE);
 		}
 		else
 		{
-			// Setting standby FSK mode
-			writeRegister(REG_OP_MODE, FSK_STANDBY_MODE);	
+			setOpMode(FSK_STANDBY_MODE);
 		}
+		armTx();
 	}
-	return forme;
+	return state;
 }
 
 /*
- Function: It gets and stores a packet if it is received before MAX_TIMEOUT expires.
- Returns:  Integer that determines if there has been any error
-   state = 2  --> The command has not been executed
-   state = 1  --> There has been an error while executing the command
-   state = 0  --> The command has been executed with no errors
+ Function: Does the work needed before the transmission of the packet in FIFO
+ so that 'fireTx' only has to change the mode.
 */
-uint8_t SX1278::getPacketMAXTimeout()
+void SX1278::armTx()
 {
-	return getPacket(MAX_TIMEOUT);
+	// Initializing flags
+	clearFlags();
+	// With FHSS the packet always starts in the first channel
+	if( (_modem == LORA) && (_hopPeriod != 0) )
+	{
+		setChannel(_hopChannels[0]);
+	}
+	_txArmed = true;
 }
 
 /*
- Function: It gets and stores a packet if it is received.
- Returns:  Integer that determines if there has been any error
-   state = 2  --> The command has not been executed
-   state = 1  --> There has been an error while executing the command
+ Function: Starts the transmission of the packet armed by 'prepareTx' with a
+ single write of REG_OP_MODE.
+ Returns: Integer that determines if there has been any error
+   state = 1  --> There is no packet ready to transmit
    state = 0  --> The command has been executed with no errors
 */
-int8_t SX1278::getPacket()
+int8_t SX1278::fireTx()
 {
-	return getPacket(MAX_TIMEOUT);
+	unsigned long start = micros();
+	uint8_t mode;
+
+	if( !_txArmed )
+	{
+		return 1;
+	}
+	_txArmed = false;
+	_txStart = millis();
+	if( _modem == LORA )
+	{
+		mode = LORA_TX_MODE;	// LORA mode - Tx
+	}
+	else
+	{
+		mode = FSK_TX_MODE;		// FSK mode - Tx
+	}
+	updatePowerState(mode);
+	SX1278_COUNT(regWrites);
+	SX1278_COUNT(opModeWrites);
+	SX1278_TRACE(TRACE_WRITE, REG_OP_MODE, mode);
+
+	// Without the delay of 'writeRegister', the mode is changed as soon
+	// as the chip select goes high
+	digitalWrite(SX1278_SS,LOW);
+	SPI.transfer(REG_OP_MODE | 0x80);
+	SPI.transfer(mode);
+	digitalWrite(SX1278_SS,HIGH);
+
+	_fireLatency = micros() - start;
+	return 0;
 }
 
 /*
- Function: It gets and stores a packet if it is received before ending 'wait' time.
- Returns:  Integer that determines if there has been any error
+ Function: Waits for the end of the transmission started by 'fireTx'.
+ Returns: Integer that determines if there has been any error
    state = 2  --> The command has not been executed
    state = 1  --> There has been an error while executing the command
    state = 0  --> The command has been executed with no errors
-   state = -1 --> Forbidden parameter value for this function
  Parameters:
-   wait: time to wait while there is no a valid header received.
+   wait: time to wait since the transmission started
 */
-int8_t SX1278::getPacket(uint32_t wait)
+uint8_t SX1278::waitTxDone(uint32_t wait)
 {
 	uint8_t state = 2;
-	uint8_t state_f = 2;
 	byte value = 0x00;
 	unsigned long previous;
-	boolean p_received = false;
 
-	#if (SX1278_debug_mode > 0)
+	#if (SX1278_debug_mode > 1)
 		Serial.println();
-		Serial.println(F("Starting 'getPacket'"));
+		Serial.println(F("Starting 'waitTxDone'"));
 	#endif
 
-	previous = millis();
-	
+	// wait to TxDone flag
+	previous = _txStart;
 	if( _modem == LORA )
-	{
+	{ 
 		/// LoRa mode
-		// read REG_IRQ_FLAGS
 		value = readRegister(REG_IRQ_FLAGS);
-		
-		// Wait until the packet is received (RxDone flag) or the timeout expires
-		while( (bitRead(value, 6) == 0) && (millis()-previous < (unsigned long)wait) )
+
+		// Wait until the packet is sent (TX Done flag) or the timeout expires
+		while ((bitRead(value, 3) == 0) && (millis() - previous < wait))
 		{
+			// FhssChangeChannel flag
+			if( bitRead(value, 1) == 1 )
+			{
+				hopChannel();
+			}
 			value = readRegister(REG_IRQ_FLAGS);
-			
 			// Condition to avoid an overflow (DO NOT REMOVE)
 			if( millis() < previous )
 			{
 				previous = millis();
 			}
 		}
-
-		// Check if 'RxDone' is true and 'PayloadCrcError' is correct
-		if( (bitRead(value, 6) == 1) && (bitRead(value, 5) == 0) )
-		{ 
-			// packet received & CRC correct
-			p_received = true;	// packet correctly received
-			_reception = CORRECT_PACKET;
-			#if (SX1278_debug_mode > 0)
-				Serial.println(F("## Packet correctly received in LoRa mode ##"));
-			#endif
-		}
-		else
-		{
-			if( bitRead(value, 6) != 1 )
-			{ 
-				#if (SX1278_debug_mode > 0)
-					Serial.println(F("NOT 'RxDone' flag"));
-				#endif
-			}
-			
-			if( _CRC != CRC_ON )
-			{ 
-				#if (SX1278_debug_mode > 0)
-					Serial.println(F("NOT 'CRC_ON' enabled"));
-				#endif
-			}
-			
-			if( (bitRead(value, 5) == 0) && (_CRC == CRC_ON) )
-			{ 
-				// CRC is correct
-				_reception = CORRECT_PACKET;
-			}
-			else
-			{ 
-				// CRC incorrect
-				_reception = INCORRECT_PACKET;
-				state = 3;
-				#if (SX1278_debug_mode > 0)
-					Serial.println(F("** The CRC is incorrect **"));
-					Serial.println();
-				#endif
-			}
-		}			
-
+		state = 1;
 	}
 	else
 	{ 
 		/// FSK mode
 		value = readRegister(REG_IRQ_FLAGS2);
-		while( (bitRead(value, 2) == 0) && (millis() - previous < wait) )
+		// Wait until the packet is sent (Packet Sent flag) or the timeout expires
+		while ((bitRead(value, 3) == 0) && (millis() - previous < wait))
 		{
 			value = readRegister(REG_IRQ_FLAGS2);
+			
 			// Condition to avoid an overflow (DO NOT REMOVE)
 			if( millis() < previous )
 			{
 				previous = millis();
 			}
-		} // end while (millis)
-		if( bitRead(value, 2) == 1 )
-		{ // packet received
- 			if( (bitRead(value, 1) == 1) && (_CRC == CRC_ON) )
-			{ // CRC correct
-				_reception = CORRECT_PACKET;
-				p_received = true;
-				#if (SX1278_debug_mode > 0)
-					Serial.println(F("## Packet correctly received in FSK mode ##"));
-				#endif
-			}
-			else
-			{ // CRC incorrect
-				_reception = INCORRECT_PACKET;
-				state = 3;
-				p_received = false;
-				#if (SX1278_debug_mode > 0)
-					Serial.println(F("## Packet incorrectly received in FSK mode ##"));
-				#endif
-			}
-		}
-		else
-		{
-			#if (SX1278_debug_mode > 0)
-				Serial.println(F("** The timeout has expired **"));
-				Serial.println();
-			#endif
 		}
-		writeRegister(REG_OP_MODE, FSK_STANDBY_MODE);	// Setting standby FSK mode
+		state = 1;
 	}
-	
-	/* If a new packet was received correctly, now the information must be 
-	 * filled inside the structures of the class 
-	 */
-	if( p_received == true )
-	{		
-		// Store the packet
+	if( bitRead(value, 3) == 1 )
+	{
+		state = 0;	// Packet successfully sent
 		if( _modem == LORA )
 		{
-			/// LoRa
-			// Setting address pointer in FIFO data buffer
-			writeRegister(REG_FIFO_ADDR_PTR, 0x00);	
-			// Storing first byte of the received packet
-			packet_received.dst = readRegister(REG_FIFO);
+			// The module goes back to standby by itself
+			updatePowerState(LORA_STANDBY_MODE);
 		}
 		else
 		{
-			/// FSK
-			value = readRegister(REG_PACKET_CONFIG1);
-			if( (bitRead(value, 2) == 0) && (bitRead(value, 1) == 0) )
-			{
-				// Storing first byte of the received packet
-				packet_received.dst = readRegister(REG_FIFO); 
-			}
-			else
-			{
-				// Storing first byte of the received packet
-				packet_received.dst = _destination;
-			}
-		}
-		
-		// Reading second byte of the received packet
-		// Reading third byte of the received packet
-		// Reading fourth byte of the received packet	
-		packet_received.src = readRegister(REG_FIFO);
-		packet_received.packnum = readRegister(REG_FIFO);
-		packet_received.length = readRegister(REG_FIFO);
-		
-		// calculate the payload length
-		if( _modem == LORA )
-		{
-			_payloadlength = packet_received.length - OFFSET_PAYLOADLENGTH;
+			// The module stays in Tx until the mode is changed
+			setOpMode(FSK_STANDBY_MODE);
 		}
-		
-		// check if length is incorrect
-		if( packet_received.length > (MAX_LENGTH + 1) )
+		_txDoneTime = millis();
+		SX1278_LINK(linkSent(_txDest, _txDoneTime - previous));
+		#if (SX1278_debug_mode > 1)
+			Serial.println(F("## Packet successfully sent ##"));
+			Serial.println();
+		#endif
+	}
+	else
+	{
+		if( state == 1 )
 		{
-			#if (SX1278_debug_mode > 0)
-				Serial.println(F("Corrupted packet, length must be less than 256"));
+			#if (SX1278_debug_mode > 1)
+				Serial.println(F("** Timeout has expired **"));
+				Serial.println();
 			#endif
 		}
 		else
 		{
-			// Store payload in 'data'
-			for(unsigned int i = 0; i < _payloadlength; i++)
-			{
-				packet_received.data[i] = readRegister(REG_FIFO); 
-			}
-			// Store 'retry'
-			packet_received.retry = readRegister(REG_FIFO);
-			
-			// Print the packet if debug_mode
-			#if (SX1278_debug_mode > 0)
-				Serial.println(F("## Packet received:"));
-				Serial.print(packet_received.dst, HEX);	 	// Printing destination
-				Serial.print("|");
-				Serial.print(packet_received.src, HEX);		 	// Printing source
-				Serial.print("|");
-				Serial.print(packet_received.packnum, HEX);			// Printing packet number
-				Serial.print("|");
-				Serial.print(packet_received.length, HEX);			// Printing packet length
-				Serial.print("|");
-				for(unsigned int i = 0; i < _payloadlength; i++)
-				{
-					Serial.print(packet_received.data[i], HEX);		// Printing payload
-					Serial.print("|");
-				}
-				Serial.print(packet_received.retry, HEX);			// Printing number retry
-				Serial.println(F(" ##"));
+			#if (SX1278_debug_mode > 1)
+				Serial.println(F("** There has been an error and packet has not been sent **"));
 				Serial.println();
 			#endif
-			state_f = 0;
+		}
+		// Aborting the transmission, otherwise the setters that restore the
+		// previous mode would put the module in Tx with the next packet
+		if( _modem == LORA )
+		{
+			setOpMode(LORA_STANDBY_MODE);
+		}
+		else
+		{
+			setOpMode(FSK_STANDBY_MODE);
 		}
 	}
-	else
+	
+	// Initializing flags
+	clearFlags();		
+	idle();
+	return state;
+}
+
+/*
+ Function: Configures the module to transmit information.
+ Returns: Integer that determines if there has been any error
+   state = 2  --> The command has not been executed
+   state = 1  --> There has been an error while executing the command
+   state = 0  --> The command has been executed with no errors
+*/
+uint8_t SX1278::sendPacketMAXTimeout(uint8_t dest, char *payload)
+{
+	return sendPacketTimeout(dest, payload, MAX_TIMEOUT);
+}
+
+/*
+ Function: Configures the module to transmit information.
+ Returns: Integer that determines if there has been any error
+   state = 2  --> The command has not been executed
+   state = 1  --> There has been an error while executing the command
+   state = 0  --> The command has been executed with no errors
+*/
+uint8_t SX1278::sendPacketMAXTimeout(	uint8_t dest,  
+											uint8_t *payload, 
+											uint16_t length16)
+{
+	return sendPacketTimeout(dest, payload, length16, MAX_TIMEOUT);
+}
+
+/*
+ Function: Configures the module to transmit information.
+ Returns: Integer that determines if there has been any error
+   state = 2  --> The command has not been executed
+   state = 1  --> There has been an error while executing the command
+   state = 0  --> The command has been executed with no errors
+*/
+uint8_t SX1278::sendPacketTimeout(uint8_t dest, char *payload)
+{
+	uint8_t state = 2;
+
+	#if (SX1278_debug_mode > 1)
+		Serial.println();
+		Serial.println(F("Starting 'sendPacketTimeout'"));
+	#endif
+
+	// Setting a packet with 'dest' destination address, 'payload' data field
+	// and writing it in FIFO.
+	state = setPacket(dest, payload);	
+	if (state == 0)								
 	{
-		// if packet was NOT received
-		state_f = 1;
-		if( (_reception == INCORRECT_PACKET) && (_retries < _maxRetries) && (state != 3) )
-		{
-			_retries++;
-			#if (SX1278_debug_mode > 0)
-				Serial.println(F("## Retrying to send the last packet ##"));
-				Serial.println();
-			#endif
-		}
+		state = sendWithTimeout();	// Sending the packet
 	}
-	
-	// Setting address pointer in FIFO data buffer to 0x00 again
-	if( _modem == LORA )
+	return state;
+}
+
+/*
+ Function: Configures the module to transmit information.
+ Returns: Integer that determines if there has been any error
+   state = 2  --> The command has not been executed
+   state = 1  --> There has been an error while executing the command
+   state = 0  --> The command has been executed with no errors
+*/
+uint8_t SX1278::sendPacketTimeout(	uint8_t dest, 
+										uint8_t *payload, 
+										uint16_t length16)
+{
+	uint8_t state = 2;
+	uint8_t state_f = 2;
+
+	#if (SX1278_debug_mode > 1)
+		Serial.println();
+		Serial.println(F("Starting 'sendPacketTimeout'"));
+	#endif
+
+	state = truncPayload(length16);
+	if( state == 0 )
 	{
-		writeRegister(REG_FIFO_ADDR_PTR, 0x00);
+		state_f = setPacket(dest, payload);	// Setting a packet with 'dest' destination
+	}												// and writing it in FIFO.
+	else
+	{
+		state_f = state;
 	}
-	
-	// Initializing flags	
-	clearFlags();	
-	
-	if( wait > MAX_WAIT )
+	if( state_f == 0 )
 	{
-		state_f = -1;
-		#if (SX1278_debug_mode > 0)
-			Serial.println(F("** The timeout must be smaller than 12.5 seconds **"));
-			Serial.println();
-		#endif
+		state_f = sendWithTimeout();	// Sending the packet
 	}
-
 	return state_f;
 }
 
 /*
- Function: It sets the packet destination.
- Returns:  Integer that determines if there has been any error
+ Function: Configures the module to transmit information.
+ Returns: Integer that determines if there has been any error
    state = 2  --> The command has not been executed
    state = 1  --> There has been an error while executing the command
    state = 0  --> The command has been executed with no errors
- Parameters:
-   dest: destination value of the packet sent.
 */
-int8_t SX1278::setDestination(uint8_t dest)
+uint8_t SX1278::sendPacketTimeout(uint8_t dest, char *payload, uint32_t wait)
 {
-	int8_t state = 2;
+	uint8_t state = 2;
 
 	#if (SX1278_debug_mode > 1)
 		Serial.println();
-		Serial.println(F("Starting 'setDestination'"));
+		Serial.println(F("Starting 'sendPacketTimeout'"));
 	#endif
 
-	state = 1;
-	_destination = dest; // Storing destination in a global variable
-	packet_sent.dst = dest;	 // Setting destination in packet structure
-	packet_sent.src = _nodeAddress; // Setting source in packet structure
-	packet_sent.packnum = _packetNumber;	// Setting packet number in packet structure
-	_packetNumber++;
-	state = 0;
-
-	#if (SX1278_debug_mode > 1)
-		Serial.print(F("## Destination "));
-		Serial.print(_destination, HEX);
-		Serial.println(F(" successfully set ##"));
-		Serial.print(F("## Source "));
-		Serial.print(packet_sent.src, DEC);
-		Serial.println(F(" successfully set ##"));
-		Serial.print(F("## Packet number "));
-		Serial.print(packet_sent.packnum, DEC);
-		Serial.println(F(" successfully set ##"));
-		Serial.println();
-	#endif
+	state = setPacket(dest, payload);	// Setting a packet with 'dest' destination
+	if (state == 0)								// and writing it in FIFO.
+	{
+		state = sendWithTimeout(wait);	// Sending the packet
+	}
 	return state;
 }
 
 /*
- Function: It sets the timeout according to the configured mode.
- Link: http://www.semtech.com/images/datasheet/sx1276.pdf
+ Function: Configures the module to transmit information.
  Returns: Integer that determines if there has been any error
    state = 2  --> The command has not been executed
    state = 1  --> There has been an error while executing the command
    state = 0  --> The command has been executed with no errors
 */
-uint8_t SX1278::setTimeout()
+uint8_t SX1278::sendPacketTimeout(	uint8_t dest, 
+										uint8_t *payload, 
+										uint16_t length16, 
+										uint32_t wait)
 {
 	uint8_t state = 2;
-	uint16_t delay;
+	uint8_t state_f = 2;
 
 	#if (SX1278_debug_mode > 1)
 		Serial.println();
-		Serial.println(F("Starting 'setTimeout'"));
+		Serial.println(F("Starting 'sendPacketTimeout'"));
 	#endif
 
-	state = 1;
-	if( _modem == LORA )
+	state = truncPayload(length16);
+	if( state == 0 )
 	{
-		// calculate 'delay'
-		delay = ((0.1*_sendTime) + 1);		
-	
-		float Tpacket = timeOnAir();
-	
-		// calculate final send/receive timeout adding an offset and a random value
-		_sendTime = (uint16_t) Tpacket + (rand()%delay) + 1000;
-	
-		#if (SX1278_debug_mode > 2)		
-			Serial.print(F("Tsym (ms):"));
-			Serial.println(Tsym);
-			Serial.print(F("Tpreamble (ms):"));
-			Serial.println(Tpreamble);
-			Serial.print(F("payloadSymbNb:"));
-			Serial.println(payloadSymbNb);
-			Serial.print(F("Tpacket:"));
-			Serial.println(Tpacket);
-		#endif
-		
-		// update state
-		state = 0;
+		state_f = setPacket(dest, payload);	// Setting a packet with 'dest' destination
 	}
-	else 
+	else
 	{
-		// update state
-		_sendTime = MAX_TIMEOUT;
-		
-		// update state
-		state = 0;
+		state_f = state;
 	}
-
-	#if (SX1278_debug_mode > 1)	
-		Serial.print(F("Timeout to send/receive is: "));
-		Serial.println(_sendTime, DEC);	
-	#endif	
-	
-	return state;
+	if( state_f == 0 )								// and writing it in FIFO.
+	{
+		state_f = sendWithTimeout(wait);	// Sending the packet
+	}
+	return state_f;
 }
 
-
 /*
- Function: It gets the theoretical value of the time-on-air of the packet
- Link: http://www.semtech.com/images/datasheet/sx1276.pdf
- Returns: Float that determines the time-on-air
+ Function: Configures the module to transmit information.
+ Returns: Integer that determines if there has been any error
+   state = 2  --> The command has not been executed
+   state = 1  --> There has been an error while executing the command
+   state = 0  --> The command has been executed with no errors
 */
-float SX1278::timeOnAir()
+uint8_t SX1278::sendPacketMAXTimeoutACK(uint8_t dest, char *payload)
 {
-	return timeOnAir( _payloadlength );
+	return sendPacketTimeoutACK(dest, payload, MAX_TIMEOUT);
 }
 
 /*
- Function: It gets the theoretical value of the time-on-air of the packet
- Link: http://www.semtech.com/images/datasheet/sx1276.pdf
- Returns: Float that determines the time-on-air
+ Function: Configures the module to transmit information and receive an ACK.
+ Returns: Integer that determines if there has been any error
+   state = 2  --> The command has not been executed
+   state = 1  --> There has been an error while executing the command
+   state = 0  --> The command has been executed with no errors
 */
-float SX1278::timeOnAir( uint16_t payloadlength )
+uint8_t SX1278::sendPacketMAXTimeoutACK(uint8_t dest, 
+											uint8_t *payload, 
+											uint16_t length16)
 {
-	float BW;
-	float DE = 0;
-	float SF = _spreadingFactor;
-	float PL = payloadlength + OFFSET_PAYLOADLENGTH;
-	float H = _header;
-	float CR = _codingRate;
-	
-	// Dara rate optimization enabled if SF is 11 or 12
-	if( SF > 10) DE = 1.0;
-	else DE = 0.0;
-		
-	// payload correction
-	if( payloadlength == 0 ) PL = 255;
+	return sendPacketTimeoutACK(dest, payload, length16, MAX_TIMEOUT);
+}
 
-	// Bandwidth value setting
-	if( _bandwidth == BW_125 ) 		BW = 125.0;
-	else if( _bandwidth == BW_250 ) BW = 250.0;
-	else if( _bandwidth == BW_500 ) BW = 500.0;
-	else BW = 125.0;
+/*
+ Function: Configures the module to transmit information and receive an ACK.
+ Returns: Integer that determines if there has been any error
+   state = 9  --> The ACK lost (no data available)
+   state = 8  --> The ACK lost
+   state = 7  --> The ACK destination incorrectly received
+   state = 6  --> The ACK source incorrectly received
+   state = 5  --> The ACK number incorrectly received
+   state = 4  --> The ACK length incorrectly received
+   state = 3  --> N-ACK received
+   state = 2  --> The command has not been executed
+   state = 1  --> There has been an error while executing the command
+   state = 0  --> The command has been executed with no errors
+*/
+uint8_t SX1278::sendPacketTimeoutACK(uint8_t dest, char *payload)
+{
+	uint8_t state = 2;
+	uint8_t state_f = 2;
 
-	// Calculation steps:
-	float Tsym = pow(2,SF)/(BW); // ms
-	float Tpreamble = (8+4.25)*Tsym;// ms
-	float argument1 = ceil( (8.0*PL-4.0*SF+28.0+16.0-20.0*H)/(4.0*(SF-2.0*DE)) )*(CR+4.0);
-	float argument2 = 0;
-	float payloadSymbNb = 8 + max( argument1, argument2);
-	float Tpayload = payloadSymbNb * Tsym;
-	float Tpacket = Tpreamble + Tpayload;	
-	
-	return Tpacket;
-}
+	#if (SX1278_debug_mode > 1)
+		Serial.println();
+		Serial.println(F("Starting 'sendPacketTimeoutACK'"));
+	#endif
 
+	// ACKs have addressing bytes, a fixed length peer can not decode them
+	if( _fixedLength != 0 )
+	{
+		return 1;
+	}
 
+	state = sendPacketTimeout(dest, payload);	// Sending packet to 'dest' destination
+	// Nobody acknowledges a group or broadcast frame, it is done once sent
+	if( (state == 0) && isMulticast(dest) )
+	{
+		return state;
+	}
+	if( state == 0 )
+	{
+		state = receive();	// Setting Rx mode to wait an ACK
+	}
+	else
+	{
+		state_f = state;
+	}
+	if( state == 0 )
+	{
+		if( availableData() )
+		{
+			state_f = getACK();	// Getting ACK
+		}
+		else
+		{
+			state_f = 9;
+		}
+	}
+	else
+	{
+		state_f = state;
+	}
 
+	SX1278_LINK(linkACK(dest, state_f));
+	return state_f;
+}
 
 /*
- Function: It sets a char array payload packet in a packet struct.
- Returns:  Integer that determines if there has been any error
+ Function: Configures the module to transmit information and receive an ACK.
+ Returns: Integer that determines if there has been any error
+   state = 9  --> The ACK lost (no data available)
+   state = 8  --> The ACK lost
+   state = 7  --> The ACK destination incorrectly received
+   state = 6  --> The ACK source incorrectly received
+   state = 5  --> The ACK number incorrectly received
+   state = 4  --> The ACK length incorrectly received
+   state = 3  --> N-ACK received
+   state = 2  --> The ACK has not been received
    state = 2  --> The command has not been executed
    state = 1  --> There has been an error while executing the command
    state = 0  --> The command has been executed with no errors
 */
-uint8_t SX1278::setPayload(char *payload)
+uint8_t SX1278::sendPacketTimeoutACK(	uint8_t dest, 
+											uint8_t *payload, 
+											uint16_t length16)
 {
 	uint8_t state = 2;
 	uint8_t state_f = 2;
-	uint16_t length16;
 
 	#if (SX1278_debug_mode > 1)
 		Serial.println();
-		Serial.println(F("Starting 'setPayload'"));
+		Serial.println(F("Starting 'sendPacketTimeoutACK'"));
 	#endif
 
-	state = 1;
-	length16 = (uint16_t)strlen(payload);
-	state = truncPayload(length16);
+	// ACKs have addressing bytes, a fixed length peer can not decode them
+	if( _fixedLength != 0 )
+	{
+		return 1;
+	}
+
+	// Sending packet to 'dest' destination
+	state = sendPacketTimeout(dest, payload, length16);
+
+	// Nobody acknowledges a group or broadcast frame, it is done once sent
+	if( (state == 0) && isMulticast(dest) )
+	{
+		return state;
+	}
+
+	// Trying to receive the ACK
 	if( state == 0 )
 	{
-		// fill data field until the end of the string
-		for(unsigned int i = 0; i < _payloadlength; i++)
-		{
-			packet_sent.data[i] = payload[i];
-		}
+		state = receive();	// Setting Rx mode to wait an ACK
 	}
 	else
 	{
 		state_f = state;
 	}
-	
-	// In the case of FSK mode, the max payload is more restrictive
-	if( ( _modem == FSK ) && ( _payloadlength > MAX_PAYLOAD_FSK ) )
+	if( state == 0 )
 	{
-		_payloadlength = MAX_PAYLOAD_FSK;
-		state = 1;
-		#if (SX1278_debug_mode > 1)
-			Serial.println(F("In FSK, payload length must be less than 60 bytes."));
-			Serial.println();
-		#endif
+		if( availableData() )
+		{
+			state_f = getACK();	// Getting ACK
+		}
+		else
+		{
+			state_f = 9;
+		}
 	}
-	
-	// Set length with the actual counter value
-	// Setting packet length in packet structure
-	state_f = setPacketLength();	
+	else
+	{
+		state_f = state;
+	}
+
+	SX1278_LINK(linkACK(dest, state_f));
 	return state_f;
 }
 
 /*
- Function: It sets an uint8_t array payload packet in a packet struct.
- Returns:  Integer that determines if there has been any error
+ Function: Configures the module to transmit information and receive an ACK.
+ Returns: Integer that determines if there has been any error
+   state = 9  --> The ACK lost (no data available)
+   state = 8  --> The ACK lost
+   state = 7  --> The ACK destination incorrectly received
+   state = 6  --> The ACK source incorrectly received
+   state = 5  --> The ACK number incorrectly received
+   state = 4  --> The ACK length incorrectly received
+   state = 3  --> N-ACK received
+   state = 2  --> The ACK has not been received
    state = 2  --> The command has not been executed
    state = 1  --> There has been an error while executing the command
    state = 0  --> The command has been executed with no errors
 */
-uint8_t SX1278::setPayload(uint8_t *payload)
+uint8_t SX1278::sendPacketTimeoutACK(	uint8_t dest, 
+											char *payload,
+											uint32_t wait)
 {
 	uint8_t state = 2;
+	uint8_t state_f = 2;
 
 	#if (SX1278_debug_mode > 1)
 		Serial.println();
-		Serial.println(F("Starting 'setPayload'"));
+		Serial.println(F("Starting 'sendPacketTimeoutACK'"));
 	#endif
 
-	state = 1;
-	if( ( _modem == FSK ) && ( _payloadlength > MAX_PAYLOAD_FSK ) )
+	// ACKs have addressing bytes, a fixed length peer can not decode them
+	if( _fixedLength != 0 )
 	{
-		_payloadlength = MAX_PAYLOAD_FSK;
-		state = 1;
-		#if (SX1278_debug_mode > 1)
-			Serial.println(F("In FSK, payload length must be less than 60 bytes."));
-			Serial.println();
-		#endif
+		return 1;
 	}
-	for(unsigned int i = 0; i < _payloadlength; i++)
+
+	state = sendPacketTimeout(dest, payload, wait);	// Sending packet to 'dest' destination
+	// Nobody acknowledges a group or broadcast frame, it is done once sent
+	if( (state == 0) && isMulticast(dest) )
 	{
-		packet_sent.data[i] = payload[i];	// Storing payload in packet structure
+		return state;
 	}
-	// set length with the actual counter value
-    state = setPacketLength();	// Setting packet length in packet structure
-	return state;
-}
-
-/*
- Function: It sets a packet struct in FIFO in order to send it.
- Returns:  Integer that determines if there has been any error
-   state = 2  --> The command has not been executed
-   state = 1  --> There has been an error while executing the command
-   state = 0  --> The command has been executed with no errors
-*/
-uint8_t SX1278::setPacket(uint8_t dest, char *payload)
-{
-	int8_t state = 2;
-	byte st0;
-
-	#if (SX1278_debug_mode > 1)
-		Serial.println();
-		Serial.println(F("Starting 'setPacket'"));
-	#endif
-	
-	// Save the previous status
-	st0 = readRegister(REG_OP_MODE);	
-	// Initializing flags
-	clearFlags();	
-	
-	// Updating incorrect value
-	_reception = CORRECT_PACKET;	
-	
-	
-	if (_retries == 0)
-	{ 
-		// Updating these values only if it is the first try
-		// Setting destination in packet structure
-		state = setDestination(dest);	
-		if( state == 0 )
-		{
-			state = setPayload(payload);
-		}
+	if( state == 0 )
+	{
+		state = receive();	// Setting Rx mode to wait an ACK
 	}
 	else
 	{
-		state = setPacketLength();
-		packet_sent.retry = _retries;
-		#if (SX1278_debug_mode > 0)
-			Serial.print(F("** Retrying to send last packet "));
-			Serial.print(_retries, DEC);
-			Serial.println(F(" time **"));
-		#endif
+		state_f = 1;
 	}
-	
-	// Setting address pointer in FIFO data buffer
-	writeRegister(REG_FIFO_TX_BASE_ADDR, 0x00);  
-	writeRegister(REG_FIFO_ADDR_PTR, 0x00);  
 	if( state == 0 )
 	{
-		state = 1;
-		// Writing packet to send in FIFO
-		writeRegister(REG_FIFO, packet_sent.dst); 		// Writing the destination in FIFO
-		writeRegister(REG_FIFO, packet_sent.src);		// Writing the source in FIFO
-		writeRegister(REG_FIFO, packet_sent.packnum);	// Writing the packet number in FIFO
-		writeRegister(REG_FIFO, packet_sent.length); 	// Writing the packet length in FIFO
-		for( uint16_t i = 0; i < _payloadlength; i++)
+		if( availableData() )
 		{
-			writeRegister(REG_FIFO, packet_sent.data[i]);  // Writing the payload in FIFO
+			state_f = getACK();	// Getting ACK
+		}
+		else
+		{
+			state_f = 9;
 		}
-		writeRegister(REG_FIFO, packet_sent.retry);		// Writing the number retry in FIFO
-		state = 0;
-		#if (SX1278_debug_mode > 0)
-			Serial.println(F("## Packet set and written in FIFO ##"));
-			// Print the complete packet if debug_mode
-			Serial.print(F("## Packet to send: "));
-			Serial.print(packet_sent.dst, HEX);			 	// Printing destination
-			Serial.print("|");
-			Serial.print(packet_sent.src, HEX);			 	// Printing source
-			Serial.print("|");
-			Serial.print(packet_sent.packnum, HEX);			// Printing packet number
-			Serial.print("|");
-			Serial.print(packet_sent.length, HEX);			// Printing packet length
-			Serial.print("|");
-			for( uint16_t i = 0; i < _payloadlength; i++)
-			{
-				Serial.print(packet_sent.data[i], HEX);		// Printing payload
-				Serial.print("|");
-			}
-			Serial.print(packet_sent.retry, HEX);			// Printing retry number
-			Serial.println(F(" ##"));
-		#endif
 	}
-	writeRegister(REG_OP_MODE, st0);	// Getting back to previous status
-	return state;
+	else
+	{
+		state_f = 1;
+	}
+
+	SX1278_LINK(linkACK(dest, state_f));
+	return state_f;
 }
 
 /*
- Function: It sets a packet struct in FIFO in order to sent it.
- Returns:  Integer that determines if there has been any error
+ Function: Configures the module to transmit information and receive an ACK.
+ Returns: Integer that determines if there has been any error
+   state = 9  --> The ACK lost (no data available)
+   state = 8  --> The ACK lost
+   state = 7  --> The ACK destination incorrectly received
+   state = 6  --> The ACK source incorrectly received
+   state = 5  --> The ACK number incorrectly received
+   state = 4  --> The ACK length incorrectly received
+   state = 3  --> N-ACK received
    state = 2  --> The command has not been executed
    state = 1  --> There has been an error while executing the command
    state = 0  --> The command has been executed with no errors
 */
-uint8_t SX1278::setPacket(uint8_t dest, uint8_t *payload)
+uint8_t SX1278::sendPacketTimeoutACK(	uint8_t dest, 
+											uint8_t *payload, 
+											uint16_t length16, 
+											uint32_t wait)
 {
-	int8_t state = 2;
-	byte st0;
+	uint8_t state = 2;
+	uint8_t state_f = 2;
 
 	#if (SX1278_debug_mode > 1)
 		Serial.println();
-		Serial.println(F("Starting 'setPacket'"));
+		Serial.println(F("Starting 'sendPacketTimeoutACK'"));
 	#endif
 
-	st0 = readRegister(REG_OP_MODE);	// Save the previous status
-	clearFlags();	// Initializing flags
-
-	if( _modem == LORA )
-	{ // LoRa mode
-		writeRegister(REG_OP_MODE, LORA_STANDBY_MODE);	// Stdby LoRa mode to write in FIFO
-	}
-	else
-	{ // FSK mode
-		writeRegister(REG_OP_MODE, FSK_STANDBY_MODE);	// Stdby FSK mode to write in FIFO
+	// ACKs have addressing bytes, a fixed length peer can not decode them
+	if( _fixedLength != 0 )
+	{
+		return 1;
 	}
 
-	_reception = CORRECT_PACKET;	// Updating incorrect value to send a packet (old or new)
-	if(_retries == 0)
-	{ // Sending new packet
-		state = setDestination(dest);	// Setting destination in packet structure
-		if( state == 0 )
-		{
-			state = setPayload(payload);
-		}
+	state = sendPacketTimeout(dest, payload, length16, wait);	// Sending packet to 'dest' destination
+	// Nobody acknowledges a group or broadcast frame, it is done once sent
+	if( (state == 0) && isMulticast(dest) )
+	{
+		return state;
+	}
+	if( state == 0 )
+	{
+		state = receive();	// Setting Rx mode to wait an ACK
 	}
 	else
 	{
-		state = setPacketLength();
-		packet_sent.retry = _retries;
-		#if (SX1278_debug_mode > 0)
-			Serial.print(F("** Retrying to send last packet "));
-			Serial.print(_retries, DEC);
-			Serial.println(F(" time **"));
-		#endif
+		state_f = 1;
 	}
-	writeRegister(REG_FIFO_TX_BASE_ADDR, 0x00);
-	writeRegister(REG_FIFO_ADDR_PTR, 0x00);  // Setting address pointer in FIFO data buffer
 	if( state == 0 )
 	{
-		state = 1;
-		// Writing packet to send in FIFO
-		writeRegister(REG_FIFO, packet_sent.dst); 		// Writing the destination in FIFO
-		writeRegister(REG_FIFO, packet_sent.src);		// Writing the source in FIFO
-		writeRegister(REG_FIFO, packet_sent.packnum);	// Writing the packet number in FIFO
-		writeRegister(REG_FIFO, packet_sent.length); 	// Writing the packet length in FIFO
-		for(unsigned int i = 0; i < _payloadlength; i++)
+		if( availableData() )
 		{
-			writeRegister(REG_FIFO, packet_sent.data[i]);  // Writing the payload in FIFO
-		}
-		writeRegister(REG_FIFO, packet_sent.retry);		// Writing the number retry in FIFO
-		state = 0;
-		#if (SX1278_debug_mode > 0)
-			Serial.println(F("## Packet set and written in FIFO ##"));
-			// Print the complete packet if debug_mode
-			Serial.print(F("## Packet to send: "));
-			Serial.print(packet_sent.dst, HEX);			 	// Printing destination
-			Serial.print("|");
-			Serial.print(packet_sent.src, HEX);			 	// Printing source
-			Serial.print("|");
-			Serial.print(packet_sent.packnum, HEX);			// Printing packet number
-			Serial.print("|");
-			Serial.print(packet_sent.length, HEX);			// Printing packet length
-			Serial.print("|");
-			for(unsigned int i = 0; i < _payloadlength; i++)
-			{
-				Serial.print(packet_sent.data[i], HEX);		// Printing payload
-				Serial.print("|");
-			}
-			Serial.print(packet_sent.retry, HEX);			// Printing retry number
-			Serial.println(F(" ##"));
-		#endif
+			state_f = getACK();	// Getting ACK
+		}
+		else
+		{
+			state_f = 9;
+		}
+	}
+	else
+	{
+		state_f = 1;
 	}
-	writeRegister(REG_OP_MODE, st0);	// Getting back to previous status
-	return state;
-}
 
-/*
- Function: Configures the module to transmit information.
- Returns: Integer that determines if there has been any error
-   state = 2  --> The command has not been executed
-   state = 1  --> There has been an error while executing the command
-   state = 0  --> The command has been executed with no errors
-*/
-uint8_t SX1278::sendWithMAXTimeout()
-{
-	return sendWithTimeout(MAX_TIMEOUT);
+	SX1278_LINK(linkACK(dest, state_f));
+	return state_f;
 }
 
 /*
- Function: Configures the module to transmit information.
- Returns: Integer that determines if there has been any error
-   state = 2  --> The command has not been executed
-   state = 1  --> There has been an error while executing the command
-   state = 0  --> The command has been executed with no errors
+ Function: It gets and stores an ACK if it is received.
+ Returns:
 */
-uint8_t SX1278::sendWithTimeout()
+uint8_t SX1278::getACK()
 {
-	setTimeout();
-	return sendWithTimeout(_sendTime);
+	return getACK(MAX_TIMEOUT);
 }
 
 /*
- Function: Configures the module to transmit information.
- Returns: Integer that determines if there has been any error
-   state = 2  --> The command has not been executed
-   state = 1  --> There has been an error while executing the command
-   state = 0  --> The command has been executed with no errors
+ Function: It gets and stores an ACK if it is received, before ending 'wait' time.
+ Returns: Integer that determines if there has been any error 
+   state = 8  --> The ACK lost
+   state = 7  --> The ACK destination incorrectly received
+   state = 6  --> The ACK source incorrectly received
+   state = 5  --> The ACK number incorrectly received
+   state = 4  --> The ACK length incorrectly received
+   state = 3  --> N-ACK received
+   state = 2  --> The ACK has not been received
+   state = 1  --> not used (reserved)
+   state = 0  --> The ACK has been received with no errors
+ Parameters:
+   wait: time to wait while there is no a valid header received.
 */
-uint8_t SX1278::sendWithTimeout(uint32_t wait)
+uint8_t SX1278::getACK(uint32_t wait)
 {
 	uint8_t state = 2;
 	byte value = 0x00;
 	unsigned long previous;
+	boolean a_received = false;
 
 	#if (SX1278_debug_mode > 1)
 		Serial.println();
-		Serial.println(F("Starting 'sendWithTimeout'"));
+		Serial.println(F("Starting 'getACK'"));
 	#endif
+	SX1278_TIME_CALL(INSTR_GET_ACK);
+	SX1278_TRACE(TRACE_CALL, 0, INSTR_GET_ACK);
 
-	// wait to TxDone flag
-	previous = millis();
-	if( _modem == LORA )
-	{ 
-		/// LoRa mode
-		// Initializing flags
-		clearFlags();	
-		// LORA mode - Tx
-		writeRegister(REG_OP_MODE, LORA_TX_MODE); 
+    previous = millis();
 
-		value = readRegister(REG_IRQ_FLAGS);
-		
-		// Wait until the packet is sent (TX Done flag) or the timeout expires
-		while ((bitRead(value, 3) == 0) && (millis() - previous < wait))
+	if( _modem == LORA )
+	{ // LoRa mode
+	    value = readRegister(REG_IRQ_FLAGS);
+		// Wait until the ACK is received (RxDone flag) or the timeout expires
+		while ((bitRead(value, 6) == 0) && (millis() - previous < wait))
 		{
+			// FhssChangeChannel flag
+			if( bitRead(value, 1) == 1 )
+			{
+				hopChannel();
+			}
 			value = readRegister(REG_IRQ_FLAGS);
-			// Condition to avoid an overflow (DO NOT REMOVE)
 			if( millis() < previous )
 			{
 				previous = millis();
 			}
 		}
-		state = 1;
+		if( bitRead(value, 6) == 1 )
+		{ // ACK received
+			a_received = true;
+		}
+		// Standby para minimizar el consumo
+		setOpMode(LORA_STANDBY_MODE);	// Setting standby LoRa mode
 	}
 	else
-	{ 
-		/// FSK mode
-		writeRegister(REG_OP_MODE, FSK_TX_MODE);  // FSK mode - Tx
-
+	{ // FSK mode
 		value = readRegister(REG_IRQ_FLAGS2);
-		// Wait until the packet is sent (Packet Sent flag) or the timeout expires
-		while ((bitRead(value, 3) == 0) && (millis() - previous < wait))
+		// Wait until the packet is received (RxDone flag) or the timeout expires
+		while ((bitRead(value, 2) == 0) && (millis() - previous < wait))
 		{
 			value = readRegister(REG_IRQ_FLAGS2);
-			
-			// Condition to avoid an overflow (DO NOT REMOVE)
 			if( millis() < previous )
 			{
 				previous = millis();
 			}
 		}
-		state = 1;
-	}
-	if( bitRead(value, 3) == 1 )
-	{
-		state = 0;	// Packet successfully sent
-		#if (SX1278_debug_mode > 1)
-			Serial.println(F("## Packet successfully sent ##"));
-			Serial.println();
-		#endif
+		if( bitRead(value, 2) == 1 )
+		{ // ACK received
+			a_received = true;
+		}
+		// Standby para minimizar el consumo
+		setOpMode(FSK_STANDBY_MODE);	// Setting standby FSK mode
 	}
-	else
+
+	if( a_received )
 	{
-		if( state == 1 )
+//----	writeRegister(REG_FIFO_ADDR_PTR, 0x00);  // Setting address pointer in FIFO data buffer
+		// Storing the received ACK
+		ACK.dst = _destination;
+		ACK.src = readRegister(REG_FIFO);
+		ACK.packnum = readRegister(REG_FIFO);
+		if( (_modem == LORA) && (_frameFormat == FRAME_FORMAT_COMPACT) )
 		{
-			#if (SX1278_debug_mode > 1)
-				Serial.println(F("** Timeout has expired **"));
-				Serial.println();
-			#endif
+			// Compact format: an ACK is flagged in the format byte
+			if( (_rxFormat & (FRAME_VERSION_MASK | FRAME_FLAG_ACK)) == (FRAME_VERSION_COMPACT | FRAME_FLAG_ACK) )
+			{
+				ACK.length = 0;
+			}
+			else
+			{
+				ACK.length = 1;
+			}
 		}
 		else
 		{
-			#if (SX1278_debug_mode > 1)
-				Serial.println(F("** There has been an error and packet has not been sent **"));
+			ACK.length = readRegister(REG_FIFO);
+		}
+		ACK.data[0] = readRegister(REG_FIFO);
+
+		// Checking the received ACK
+		if( ACK.dst == packet_sent.src )
+		{
+			if( ACK.src == packet_sent.dst )
+			{
+				if( ACK.packnum == packet_sent.packnum )
+				{
+					if( ACK.length == 0 )
+					{
+						if( ACK.data[0] == CORRECT_PACKET )
+						{
+							state = 0;
+							#if (SX1278_debug_mode > 0)
+							// Printing the received ACK
+							Serial.println(F("## ACK received:"));
+							Serial.print(ACK.dst, HEX);
+							Serial.print("|");
+							Serial.print(ACK.src, HEX);
+							Serial.print("|");
+							Serial.print(ACK.packnum, HEX);
+							Serial.print("|");
+							Serial.print(ACK.length, HEX);
+							Serial.print("|");
+							Serial.print(ACK.data[0], HEX);
+							Serial.println(F(" ##"));
+							Serial.println();
+							#endif
+						}
+						else
+						{
+							state = 3;
+							#if (SX1278_debug_mode > 0)
+								Serial.println(F("** N-ACK received **"));
+								Serial.println();
+							#endif
+						}
+					}
+					else
+					{
+						state = 4;
+						#if (SX1278_debug_mode > 0)
+							Serial.println(F("** ACK length incorrectly received **"));
+							Serial.println();
+						#endif
+					}
+				}
+				else
+				{
+					state = 5;
+					#if (SX1278_debug_mode > 0)
+						Serial.println(F("** ACK number incorrectly received **"));
+						Serial.println();
+					#endif
+				}
+			}
+			else
+			{
+				state = 6;
+				#if (SX1278_debug_mode > 0)
+					Serial.println(F("** ACK source incorrectly received **"));
+					Serial.println();
+				#endif
+			}
+		}
+		else
+		{
+			state = 7;
+			#if (SX1278_debug_mode > 0)
+				Serial.println(F("** ACK destination incorrectly received **"));
 				Serial.println();
 			#endif
 		}
 	}
-	
-	// Initializing flags
-	clearFlags();		
+	else
+	{
+		state = 8;
+		#if (SX1278_debug_mode > 0)
+			Serial.println(F("** ACK lost **"));
+			Serial.println();
+		#endif
+	}
+	clearFlags();	// Initializing flags
+	idle();
 	return state;
 }
 
 /*
- Function: Configures the module to transmit information.
+ Function: Configures the module to transmit information with retries in case of error.
  Returns: Integer that determines if there has been any error
    state = 2  --> The command has not been executed
    state = 1  --> There has been an error while executing the command
    state = 0  --> The command has been executed with no errors
 */
-uint8_t SX1278::sendPacketMAXTimeout(uint8_t dest, char *payload)
+uint8_t SX1278::sendPacketMAXTimeoutACKRetries(	uint8_t dest, 
+													char  *payload)
 {
-	return sendPacketTimeout(dest, payload, MAX_TIMEOUT);
+	return sendPacketTimeoutACKRetries(dest, payload, MAX_TIMEOUT);
 }
 
 /*
- Function: Configures the module to transmit information.
+ Function: Configures the module to transmit information with retries in case of error.
  Returns: Integer that determines if there has been any error
    state = 2  --> The command has not been executed
    state = 1  --> There has been an error while executing the command
    state = 0  --> The command has been executed with no errors
 */
-uint8_t SX1278::sendPacketMAXTimeout(	uint8_t dest,  
-											uint8_t *payload, 
-											uint16_t length16)
+uint8_t SX1278::sendPacketMAXTimeoutACKRetries(	uint8_t dest, 
+													uint8_t *payload, 
+													uint16_t length16)
 {
-	return sendPacketTimeout(dest, payload, length16, MAX_TIMEOUT);
+	return sendPacketTimeoutACKRetries(dest, payload, length16, MAX_TIMEOUT);
+}
+
+/*
+ Function: Configures the module to transmit information with retries in case of error.
+ Returns: Integer that determines if there has been any error
+   state = 9  --> The ACK lost (no data available)
+   state = 8  --> The ACK lost
+   state = 7  --> The ACK destination incorrectly received
+   state = 6  --> The ACK source incorrectly received
+   state = 5  --> The ACK number incorrectly received
+   state = 4  --> The ACK length incorrectly received
+   state = 3  --> N-ACK received
+   state = 2  --> The command has not been executed
+   state = 1  --> There has been an error while executing the command
+   state = 0  --> The command has been executed with no errors
+*/
+uint8_t SX1278::sendPacketTimeoutACKRetries(uint8_t dest, char *payload)
+{
+	uint8_t state = 2;
+
+	#if (SX1278_debug_mode > 1)
+		Serial.println();
+		Serial.println(F("Starting 'sendPacketTimeoutACKRetries'"));
+	#endif
+
+	// Sending packet to 'dest' destination and waiting an ACK response.
+	state = 1;
+	while( (state != 0) && (_retries <= _maxRetries) )
+	{
+		state = sendPacketTimeoutACK(dest, payload);
+		_retries++;
+	}
+	SX1278_LINK(linkRetries(dest, state, _retries));
+	_retries = 0;
+
+	return state;
 }
 
 /*
- Function: Configures the module to transmit information.
+ Function: Configures the module to transmit information with retries in case of error.
  Returns: Integer that determines if there has been any error
+   state = 9  --> The ACK lost (no data available)
+   state = 8  --> The ACK lost
+   state = 7  --> The ACK destination incorrectly received
+   state = 6  --> The ACK source incorrectly received
+   state = 5  --> The ACK number incorrectly received
+   state = 4  --> The ACK length incorrectly received
+   state = 3  --> N-ACK received
    state = 2  --> The command has not been executed
    state = 1  --> There has been an error while executing the command
    state = 0  --> The command has been executed with no errors
 */
-uint8_t SX1278::sendPacketTimeout(uint8_t dest, char *payload)
+uint8_t SX1278::sendPacketTimeoutACKRetries(uint8_t dest, 
+												uint8_t *payload, 
+												uint16_t length16)
 {
 	uint8_t state = 2;
 
 	#if (SX1278_debug_mode > 1)
 		Serial.println();
-		Serial.println(F("Starting 'sendPacketTimeout'"));
+		Serial.println(F("Starting 'sendPacketTimeoutACKRetries'"));
 	#endif
 
-	// Setting a packet with 'dest' destination address, 'payload' data field
-	// and writing it in FIFO.
-	state = setPacket(dest, payload);	
-	if (state == 0)								
+	// Sending packet to 'dest' destination and waiting an ACK response.
+	state = 1;
+	while( (state != 0) && (_retries <= _maxRetries) )
 	{
-		state = sendWithTimeout();	// Sending the packet
+		state = sendPacketTimeoutACK(dest, payload, length16);
+		_retries++;
 	}
+	SX1278_LINK(linkRetries(dest, state, _retries));
+	_retries = 0;
+
 	return state;
 }
 
 /*
- Function: Configures the module to transmit information.
+ Function: Configures the module to transmit information with retries in case of error.
  Returns: Integer that determines if there has been any error
+   state = 9  --> The ACK lost (no data available)
+   state = 8  --> The ACK lost
+   state = 7  --> The ACK destination incorrectly received
+   state = 6  --> The ACK source incorrectly received
+   state = 5  --> The ACK number incorrectly received
+   state = 4  --> The ACK length incorrectly received
+   state = 3  --> N-ACK received
    state = 2  --> The command has not been executed
    state = 1  --> There has been an error while executing the command
    state = 0  --> The command has been executed with no errors
 */
-uint8_t SX1278::sendPacketTimeout(	uint8_t dest, 
-										uint8_t *payload, 
-										uint16_t length16)
+uint8_t SX1278::sendPacketTimeoutACKRetries(uint8_t dest, 
+												char *payload, 
+												uint32_t wait)
 {
 	uint8_t state = 2;
-	uint8_t state_f = 2;
 
 	#if (SX1278_debug_mode > 1)
 		Serial.println();
-		Serial.println(F("Starting 'sendPacketTimeout'"));
+		Serial.println(F("Starting 'sendPacketTimeoutACKRetries'"));
 	#endif
 
-	state = truncPayload(length16);
-	if( state == 0 )
-	{
-		state_f = setPacket(dest, payload);	// Setting a packet with 'dest' destination
-	}												// and writing it in FIFO.
-	else
-	{
-		state_f = state;
-	}
-	if( state_f == 0 )
+	// Sending packet to 'dest' destination and waiting an ACK response.
+	state = 1;
+	while( (state != 0) && (_retries <= _maxRetries) )
 	{
-		state_f = sendWithTimeout();	// Sending the packet
+		state = sendPacketTimeoutACK(dest, payload, wait);
+		_retries++;
 	}
-	return state_f;
+	SX1278_LINK(linkRetries(dest, state, _retries));
+	_retries = 0;
+
+	return state;
 }
 
 /*
- Function: Configures the module to transmit information.
+ Function: Configures the module to transmit information with retries in case of error.
  Returns: Integer that determines if there has been any error
+   state = 9  --> The ACK lost (no data available)
+   state = 8  --> The ACK lost
+   state = 7  --> The ACK destination incorrectly received
+   state = 6  --> The ACK source incorrectly received
+   state = 5  --> The ACK number incorrectly received
+   state = 4  --> The ACK length incorrectly received
+   state = 3  --> N-ACK received
    state = 2  --> The command has not been executed
    state = 1  --> There has been an error while executing the command
    state = 0  --> The command has been executed with no errors
 */
-uint8_t SX1278::sendPacketTimeout(uint8_t dest, char *payload, uint32_t wait)
+uint8_t SX1278::sendPacketTimeoutACKRetries(uint8_t dest, 
+												uint8_t *payload, 
+												uint16_t length16, 
+												uint32_t wait)
 {
 	uint8_t state = 2;
 
 	#if (SX1278_debug_mode > 1)
 		Serial.println();
-		Serial.println(F("Starting 'sendPacketTimeout'"));
+		Serial.println(F("Starting 'sendPacketTimeoutACKRetries'"));
 	#endif
 
-	state = setPacket(dest, payload);	// Setting a packet with 'dest' destination
-	if (state == 0)								// and writing it in FIFO.
+	// Sending packet to 'dest' destination and waiting an ACK response.
+	state = 1;
+	while( (state != 0) && (_retries <= _maxRetries) )
 	{
-		state = sendWithTimeout(wait);	// Sending the packet
+		state = sendPacketTimeoutACK(dest, payload, length16, wait);
+		_retries++;
 	}
+	SX1278_LINK(linkRetries(dest, state, _retries));
+	_retries = 0;
+
 	return state;
 }
 
 /*
- Function: Configures the module to transmit information.
+ Function: Sets the sliding window used by bulk transfers.
  Returns: Integer that determines if there has been any error
    state = 2  --> The command has not been executed
    state = 1  --> There has been an error while executing the command
    state = 0  --> The command has been executed with no errors
+ Parameters:
+   window: frames sent before waiting an ACK.
+   mode: ARQ_SELECTIVE_REPEAT or ARQ_GO_BACK_N.
 */
-uint8_t SX1278::sendPacketTimeout(	uint8_t dest, 
-										uint8_t *payload, 
-										uint16_t length16, 
-										uint32_t wait)
+int8_t SX1278::setARQWindow(uint8_t window, uint8_t mode)
 {
-	uint8_t state = 2;
-	uint8_t state_f = 2;
+	int8_t state = 2;
 
 	#if (SX1278_debug_mode > 1)
 		Serial.println();
-		Serial.println(F("Starting 'sendPacketTimeout'"));
+		Serial.println(F("Starting 'setARQWindow'"));
 	#endif
 
-	state = truncPayload(length16);
-	if( state == 0 )
+	if( (window == 0) || (window > MAX_ARQ_WINDOW)
+		|| ((mode != ARQ_SELECTIVE_REPEAT) && (mode != ARQ_GO_BACK_N)) )
 	{
-		state_f = setPacket(dest, payload);	// Setting a packet with 'dest' destination
+		state = 1;
+		#if (SX1278_debug_mode > 1)
+			Serial.println(F("** Window must be between 1 and 32 **"));
+			Serial.println();
+		#endif
 	}
 	else
 	{
-		state_f = state;
+		_arqWindow = window;
+		_arqMode = mode;
+		state = 0;
 	}
-	if( state_f == 0 )								// and writing it in FIFO.
+	return state;
+}
+
+/*
+ Function: Updates the smoothed round trip time of a peer (RFC 6298).
+ Parameters:
+   addr: peer address.
+   sample: round trip time measured (ms).
+*/
+void SX1278::updateRTT(uint8_t addr, uint16_t sample)
+{
+	rttEstimate *e = &_rtt[addr % ARQ_PEERS];
+	uint16_t diff;
+
+	// '0' means no estimation
+	if( sample == 0 )
 	{
-		state_f = sendWithTimeout(wait);	// Sending the packet
+		sample = 1;
+	}
+	if( (e->addr != addr) || (e->srtt == 0) )
+	{
+		// First sample of this peer
+		e->addr = addr;
+		e->srtt = sample;
+		e->rttvar = sample / 2;
+	}
+	else
+	{
+		diff = (e->srtt > sample) ? (e->srtt - sample) : (sample - e->srtt);
+		e->rttvar = (3 * (uint32_t)e->rttvar + diff) / 4;
+		e->srtt = (7 * (uint32_t)e->srtt + sample) / 8;
 	}
-	return state_f;
 }
 
 /*
- Function: Configures the module to transmit information.
- Returns: Integer that determines if there has been any error
-   state = 2  --> The command has not been executed
-   state = 1  --> There has been an error while executing the command
-   state = 0  --> The command has been executed with no errors
+ Function: Gets the ACK timeout of a peer from its round trip time.
+ Returns: Timeout (ms)
+ Parameters:
+   addr: peer address.
+   wait: timeout to use if there is no estimation for the peer.
 */
-uint8_t SX1278::sendPacketMAXTimeoutACK(uint8_t dest, char *payload)
+uint32_t SX1278::getRTO(uint8_t addr, uint32_t wait)
 {
-	return sendPacketTimeoutACK(dest, payload, MAX_TIMEOUT);
+	rttEstimate *e = &_rtt[addr % ARQ_PEERS];
+	uint32_t rto;
+
+	if( (e->addr != addr) || (e->srtt == 0) )
+	{
+		return wait;
+	}
+	rto = e->srtt + 4 * (uint32_t)e->rttvar;
+	if( rto < MIN_RTO )
+	{
+		rto = MIN_RTO;
+	}
+	if( rto > MAX_TIMEOUT )
+	{
+		rto = MAX_TIMEOUT;
+	}
+	return rto;
 }
 
+#if (SX1278_link_stats > 0)
 /*
- Function: Configures the module to transmit information and receive an ACK.
- Returns: Integer that determines if there has been any error
-   state = 2  --> The command has not been executed
-   state = 1  --> There has been an error while executing the command
-   state = 0  --> The command has been executed with no errors
+ Function: Gets the statistics entry of a peer, taking a free entry for a
+           new peer. The entries of other peers are never taken over.
+ Returns: Pointer to the entry, NULL if the table is full
+ Parameters:
+   addr: peer address.
 */
-uint8_t SX1278::sendPacketMAXTimeoutACK(uint8_t dest, 
-											uint8_t *payload, 
-											uint16_t length16)
+linkStats* SX1278::linkEntry(uint8_t addr)
 {
-	return sendPacketTimeoutACK(dest, payload, length16, MAX_TIMEOUT);
+	linkStats *e;
+
+	// Probing from the home entry of the peer
+	for( uint8_t i = 0; i < LINK_PEERS; i++ )
+	{
+		e = &_links[(addr + i) % LINK_PEERS];
+		if( !e->used )
+		{
+			memset( e, 0x00, sizeof(linkStats) );
+			e->addr = addr;
+			e->used = true;
+			return e;
+		}
+		if( e->addr == addr )
+		{
+			return e;
+		}
+	}
+	linkCount(&_linkOverflow);
+	return NULL;
 }
 
 /*
- Function: Configures the module to transmit information and receive an ACK.
- Returns: Integer that determines if there has been any error
-   state = 9  --> The ACK lost (no data available)
-   state = 8  --> The ACK lost
-   state = 7  --> The ACK destination incorrectly received
-   state = 6  --> The ACK source incorrectly received
-   state = 5  --> The ACK number incorrectly received
-   state = 4  --> The ACK length incorrectly received
-   state = 3  --> N-ACK received
-   state = 2  --> The command has not been executed
-   state = 1  --> There has been an error while executing the command
-   state = 0  --> The command has been executed with no errors
+ Function: Increments a statistics counter, so that it stays at its maximum
+           instead of wrapping to '0'.
+ Parameters:
+   counter: counter to increment.
 */
-uint8_t SX1278::sendPacketTimeoutACK(uint8_t dest, char *payload)
+void SX1278::linkCount(uint16_t *counter)
 {
-	uint8_t state = 2;
-	uint8_t state_f = 2;
+	if( *counter != 0xFFFF )
+	{
+		(*counter)++;
+	}
+}
 
-	#if (SX1278_debug_mode > 1)
-		Serial.println();
-		Serial.println(F("Starting 'sendPacketTimeoutACK'"));
-	#endif
+/*
+ Function: Accounts a frame sent to a peer.
+ Parameters:
+   addr: destination of the frame.
+   airtime: time (ms) on air of the frame.
+*/
+void SX1278::linkSent(uint8_t addr, uint32_t airtime)
+{
+	linkStats *e = linkEntry(addr);
 
-	state = sendPacketTimeout(dest, payload);	// Sending packet to 'dest' destination
-	if( state == 0 )
+	if( e == NULL )
 	{
-		state = receive();	// Setting Rx mode to wait an ACK
+		return;
 	}
-	else
+	linkCount(&e->sent);
+	e->airtime = (airtime > 0xFFFFFFFF - e->airtime) ? 0xFFFFFFFF : e->airtime + airtime;
+}
+
+/*
+ Function: Accounts the result of a transmission acknowledged by a peer.
+ Parameters:
+   addr: destination of the frame.
+   state: result of 'sendPacketTimeoutACK'.
+*/
+void SX1278::linkACK(uint8_t addr, uint8_t state)
+{
+	linkStats *e = linkEntry(addr);
+
+	if( e == NULL )
 	{
-		state_f = state;
+		return;
 	}
 	if( state == 0 )
 	{
-		if( availableData() )
-		{
-			state_f = getACK();	// Getting ACK
-		}
-		else
-		{
-			state_f = 9;
-		}
+		linkCount(&e->acked);
 	}
 	else
 	{
-		state_f = state;
+		linkCount(&e->ackFailed);
 	}
-
-	return state_f;
 }
 
 /*
- Function: Configures the module to transmit information and receive an ACK.
- Returns: Integer that determines if there has been any error
-   state = 9  --> The ACK lost (no data available)
-   state = 8  --> The ACK lost
-   state = 7  --> The ACK destination incorrectly received
-   state = 6  --> The ACK source incorrectly received
-   state = 5  --> The ACK number incorrectly received
-   state = 4  --> The ACK length incorrectly received
-   state = 3  --> N-ACK received
-   state = 2  --> The ACK has not been received
-   state = 2  --> The command has not been executed
-   state = 1  --> There has been an error while executing the command
-   state = 0  --> The command has been executed with no errors
+ Function: Accounts the retries used to deliver a frame to a peer.
+ Parameters:
+   addr: destination of the frame.
+   state: result of the last try.
+   tries: number of tries.
 */
-uint8_t SX1278::sendPacketTimeoutACK(	uint8_t dest, 
-											uint8_t *payload, 
-											uint16_t length16)
+void SX1278::linkRetries(uint8_t addr, uint8_t state, uint8_t tries)
 {
-	uint8_t state = 2;
-	uint8_t state_f = 2;
+	linkStats *e = linkEntry(addr);
 
-	#if (SX1278_debug_mode > 1)
-		Serial.println();
-		Serial.println(F("Starting 'sendPacketTimeoutACK'"));
-	#endif
+	if( e == NULL )
+	{
+		return;
+	}
+	if( state != 0 )
+	{
+		linkCount(&e->dropped);
+	}
+	else if( tries != 0 )
+	{
+		tries--;
+		linkCount(&e->retries[(tries < LINK_RETRY_BINS) ? tries : (LINK_RETRY_BINS - 1)]);
+	}
+}
 
-	// Sending packet to 'dest' destination
-	state = sendPacketTimeout(dest, payload, length16);
+/*
+ Function: Accounts the frame stored in 'packet_received' with the SNR and
+           RSSI of the last packet.
+*/
+void SX1278::linkReceived()
+{
+	linkStats *e = linkEntry(packet_received.src);
+	int16_t bin;
 
-	// Trying to receive the ACK
-	if( state == 0 )
+	if( e == NULL )
 	{
-		state = receive();	// Setting Rx mode to wait an ACK
+		return;
+	}
+	linkCount(&e->received);
+	if( _modem == LORA )
+	{
+		getRSSIpacket();
+		bin = (_SNR + 20) / 5;
+		linkCount(&e->snr[constrain(bin, 0, LINK_SNR_BINS - 1)]);
+		bin = (_RSSIpacket + 130) / 10;
 	}
 	else
 	{
-		state_f = state;
+		bin = (130 - (readRegister(REG_RSSI_VALUE_FSK) >> 1)) / 10;
 	}
-	if( state == 0 )
+	linkCount(&e->rssi[constrain(bin, 0, LINK_RSSI_BINS - 1)]);
+}
+
+/*
+ Function: Gets the statistics of a peer.
+ Returns: Pointer to the statistics, NULL if there are none
+ Parameters:
+   addr: peer address.
+*/
+linkStats* SX1278::getLinkStats(uint8_t addr)
+{
+	linkStats *e;
+
+	for( uint8_t i = 0; i < LINK_PEERS; i++ )
 	{
-		if( availableData() )
+		e = &_links[(addr + i) % LINK_PEERS];
+		if( !e->used )
 		{
-			state_f = getACK();	// Getting ACK
+			break;
 		}
-		else
+		if( e->addr == addr )
 		{
-			state_f = 9;
+			return e;
 		}
 	}
-	else
-	{
-		state_f = state;
-	}
-
-	return state_f;
+	return NULL;
 }
 
 /*
- Function: Configures the module to transmit information and receive an ACK.
- Returns: Integer that determines if there has been any error
-   state = 9  --> The ACK lost (no data available)
-   state = 8  --> The ACK lost
-   state = 7  --> The ACK destination incorrectly received
-   state = 6  --> The ACK source incorrectly received
-   state = 5  --> The ACK number incorrectly received
-   state = 4  --> The ACK length incorrectly received
-   state = 3  --> N-ACK received
-   state = 2  --> The ACK has not been received
-   state = 2  --> The command has not been executed
-   state = 1  --> There has been an error while executing the command
-   state = 0  --> The command has been executed with no errors
+ Function: Resets the statistics of all the peers.
 */
-uint8_t SX1278::sendPacketTimeoutACK(	uint8_t dest, 
-											char *payload,
-											uint32_t wait)
+void SX1278::resetLinkStats()
 {
-	uint8_t state = 2;
-	uint8_t state_f = 2;
+	memset( _links, 0x00, sizeof(_links) );
+	_linkOverflow = 0;
+}
 
-	#if (SX1278_debug_mode > 1)
-		Serial.println();
-		Serial.println(F("Starting 'sendPacketTimeoutACK'"));
-	#endif
+/*
+ Function: Writes the statistics as a binary record:
+           [LINK_STATS_VERSION][peers] and, for each peer, the fields of
+           'linkStats' from 'addr' to 'rssi' in little endian.
+ Returns: Bytes written, '0' if 'size' is too small
+ Parameters:
+   buffer: where the record is written.
+   size: buffer size.
+*/
+uint16_t SX1278::dumpLinkStats(uint8_t *buffer, uint16_t size)
+{
+	uint16_t n = 2;
+	uint8_t peers = 0;
+	linkStats *e;
 
-	state = sendPacketTimeout(dest, payload, wait);	// Sending packet to 'dest' destination
-	if( state == 0 )
+	if( size < 2 )
 	{
-		state = receive();	// Setting Rx mode to wait an ACK
-	}
-	else
-	{
-		state_f = 1;
+		return 0;
 	}
-	if( state == 0 )
+	for( uint8_t i = 0; i < LINK_PEERS; i++ )
 	{
-		if( availableData() )
+		e = &_links[i];
+		if( !e->used )
 		{
-			state_f = getACK();	// Getting ACK
+			continue;
 		}
-		else
+		if( n + LINK_RECORD_SIZE > size )
 		{
-			state_f = 9;
+			return 0;
 		}
+		buffer[n++] = e->addr;
+		n = putWord(buffer, n, e->sent);
+		n = putWord(buffer, n, e->received);
+		n = putWord(buffer, n, e->acked);
+		n = putWord(buffer, n, e->ackFailed);
+		n = putWord(buffer, n, e->dropped);
+		for( uint8_t k = 0; k < LINK_RETRY_BINS; k++ )
+		{
+			n = putWord(buffer, n, e->retries[k]);
+		}
+		n = putWord(buffer, n, e->airtime & 0xFFFF);
+		n = putWord(buffer, n, e->airtime >> 16);
+		for( uint8_t k = 0; k < LINK_SNR_BINS; k++ )
+		{
+			n = putWord(buffer, n, e->snr[k]);
+		}
+		for( uint8_t k = 0; k < LINK_RSSI_BINS; k++ )
+		{
+			n = putWord(buffer, n, e->rssi[k]);
+		}
+		peers++;
 	}
-	else
-	{
-		state_f = 1;
-	}
+	buffer[0] = LINK_STATS_VERSION;
+	buffer[1] = peers;
+	return n;
+}
 
-	return state_f;
+/*
+ Function: Writes a 16 bits value in little endian.
+ Returns: Index after the value
+*/
+uint16_t SX1278::putWord(uint8_t *buffer, uint16_t n, uint16_t value)
+{
+	buffer[n++] = value & 0xFF;
+	buffer[n++] = value >> 8;
+	return n;
 }
+#endif
 
+#if (SX1278_fec_mode > 0)
 /*
- Function: Configures the module to transmit information and receive an ACK.
+ Function: Sets the parity frames sent with each block of bulk fragments.
  Returns: Integer that determines if there has been any error
-   state = 9  --> The ACK lost (no data available)
-   state = 8  --> The ACK lost
-   state = 7  --> The ACK destination incorrectly received
-   state = 6  --> The ACK source incorrectly received
-   state = 5  --> The ACK number incorrectly received
-   state = 4  --> The ACK length incorrectly received
-   state = 3  --> N-ACK received
    state = 2  --> The command has not been executed
    state = 1  --> There has been an error while executing the command
    state = 0  --> The command has been executed with no errors
+ Parameters:
+   parity: parity frames per block, 0 (disabled), 1 (P) or 2 (P and Q).
+   block: fragments per block.
 */
-uint8_t SX1278::sendPacketTimeoutACK(	uint8_t dest, 
-											uint8_t *payload, 
-											uint16_t length16, 
-											uint32_t wait)
+int8_t SX1278::setFEC(uint8_t parity, uint8_t block)
 {
-	uint8_t state = 2;
-	uint8_t state_f = 2;
+	int8_t state = 2;
 
 	#if (SX1278_debug_mode > 1)
 		Serial.println();
-		Serial.println(F("Starting 'sendPacketTimeoutACK'"));
+		Serial.println(F("Starting 'setFEC'"));
 	#endif
 
-	state = sendPacketTimeout(dest, payload, length16, wait);	// Sending packet to 'dest' destination
-	if( state == 0 )
+	if( (parity > 2) || (block < 2) || (block > FEC_MAX_BLOCK) )
 	{
-		state = receive();	// Setting Rx mode to wait an ACK
+		state = 1;
 	}
 	else
 	{
-		state_f = 1;
+		_fecParity = parity;
+		_fecBlock = block;
+		state = 0;
 	}
-	if( state == 0 )
+	return state;
+}
+
+#if !defined(__AVR__)
+// GF(256) log/exp tables, built on first use
+static uint8_t gfExpTable[512];
+static uint8_t gfLogTable[256];
+static boolean gfTables = false;
+
+static void gfInitTables()
+{
+	uint16_t x = 1;
+
+	for( uint16_t i = 0; i < 255; i++ )
 	{
-		if( availableData() )
+		gfExpTable[i] = x;
+		gfExpTable[i + 255] = x;
+		gfLogTable[x] = i;
+		x <<= 1;
+		if( x & 0x100 )
 		{
-			state_f = getACK();	// Getting ACK
+			x ^= 0x11D;
 		}
-		else
+	}
+	gfTables = true;
+}
+#endif
+
+/*
+ Function: Multiplies two elements of GF(256), polynomial 0x11D.
+ Returns: Product
+*/
+uint8_t SX1278::gfMul(uint8_t a, uint8_t b)
+{
+#if defined(__AVR__)
+	// Shift and add: no tables in RAM
+	uint8_t r = 0;
+
+	while( b != 0 )
+	{
+		if( b & 0x01 )
 		{
-			state_f = 9;
+			r ^= a;
 		}
+		a = (a & 0x80) ? ((a << 1) ^ 0x1D) : (a << 1);
+		b >>= 1;
 	}
-	else
+	return r;
+#else
+	if( (a == 0) || (b == 0) )
 	{
-		state_f = 1;
+		return 0;
 	}
-
-	return state_f;
+	if( !gfTables )
+	{
+		gfInitTables();
+	}
+	return gfExpTable[gfLogTable[a] + gfLogTable[b]];
+#endif
 }
 
 /*
- Function: It gets and stores an ACK if it is received.
- Returns:
+ Function: Gets the power 'n' of the GF(256) generator (2).
+ Returns: Power of the generator
 */
-uint8_t SX1278::getACK()
+uint8_t SX1278::gfPow(uint8_t n)
 {
-	return getACK(MAX_TIMEOUT);
+#if defined(__AVR__)
+	uint8_t r = 1;
+
+	while( n-- > 0 )
+	{
+		r = (r & 0x80) ? ((r << 1) ^ 0x1D) : (r << 1);
+	}
+	return r;
+#else
+	if( !gfTables )
+	{
+		gfInitTables();
+	}
+	return gfExpTable[n % 255];
+#endif
 }
 
 /*
- Function: It gets and stores an ACK if it is received, before ending 'wait' time.
- Returns: Integer that determines if there has been any error 
-   state = 8  --> The ACK lost
-   state = 7  --> The ACK destination incorrectly received
-   state = 6  --> The ACK source incorrectly received
-   state = 5  --> The ACK number incorrectly received
-   state = 4  --> The ACK length incorrectly received
-   state = 3  --> N-ACK received
-   state = 2  --> The ACK has not been received
-   state = 1  --> not used (reserved)
-   state = 0  --> The ACK has been received with no errors
- Parameters:
-   wait: time to wait while there is no a valid header received.
+ Function: Gets the inverse of a non zero element of GF(256).
+ Returns: Inverse
 */
-uint8_t SX1278::getACK(uint32_t wait)
+uint8_t SX1278::gfInv(uint8_t a)
 {
-	uint8_t state = 2;
-	byte value = 0x00;
-	unsigned long previous;
-	boolean a_received = false;
-
-	#if (SX1278_debug_mode > 1)
-		Serial.println();
-		Serial.println(F("Starting 'getACK'"));
-	#endif
-
-    previous = millis();
+#if defined(__AVR__)
+	// a^254 = a^-1
+	uint8_t r = 1;
+	uint8_t n = 254;
 
-	if( _modem == LORA )
-	{ // LoRa mode
-	    value = readRegister(REG_IRQ_FLAGS);
-		// Wait until the ACK is received (RxDone flag) or the timeout expires
-		while ((bitRead(value, 6) == 0) && (millis() - previous < wait))
+	while( n != 0 )
+	{
+		if( n & 0x01 )
 		{
-			value = readRegister(REG_IRQ_FLAGS);
-			if( millis() < previous )
-			{
-				previous = millis();
-			}
-		}
-		if( bitRead(value, 6) == 1 )
-		{ // ACK received
-			a_received = true;
+			r = gfMul(r, a);
 		}
-		// Standby para minimizar el consumo
-		writeRegister(REG_OP_MODE, LORA_STANDBY_MODE);	// Setting standby LoRa mode
+		a = gfMul(a, a);
+		n >>= 1;
 	}
-	else
-	{ // FSK mode
-		value = readRegister(REG_IRQ_FLAGS2);
-		// Wait until the packet is received (RxDone flag) or the timeout expires
-		while ((bitRead(value, 2) == 0) && (millis() - previous < wait))
-		{
-			value = readRegister(REG_IRQ_FLAGS2);
-			if( millis() < previous )
-			{
-				previous = millis();
-			}
-		}
-		if( bitRead(value, 2) == 1 )
-		{ // ACK received
-			a_received = true;
-		}
-		// Standby para minimizar el consumo
-		writeRegister(REG_OP_MODE, FSK_STANDBY_MODE);	// Setting standby FSK mode
+	return r;
+#else
+	if( !gfTables )
+	{
+		gfInitTables();
 	}
+	return gfExpTable[255 - gfLogTable[a]];
+#endif
+}
 
-	if( a_received )
+/*
+ Function: Rebuilds the lost fragments of a block from its P and Q parity.
+ Returns: Number of fragments rebuilt
+ Parameters:
+   data: bulk buffer.
+   size: bulk buffer size.
+   got: bitmap of the fragments received.
+   nfrag: number of fragments of the transfer.
+   frag: fragment size.
+   lastLen: length of the last fragment.
+   block: block to rebuild.
+   p: P parity of the block, NULL if not received.
+   q: Q parity of the block, NULL if not received.
+*/
+uint8_t SX1278::fecRecover(uint8_t *data, uint16_t size, uint8_t *got, uint16_t nfrag,
+							uint8_t frag, uint8_t lastLen, uint16_t block, uint8_t *p, uint8_t *q)
+{
+	uint16_t first = block * _fecBlock;
+	uint8_t nb;
+	uint8_t m = 0;
+	uint8_t x = 0;
+	uint8_t y = 0;
+	uint8_t len[FEC_MAX_BLOCK];
+	uint8_t coef[FEC_MAX_BLOCK];
+	uint8_t a = 0;
+	uint8_t b = 0;
+	uint8_t sp;
+	uint8_t sq;
+	uint8_t v;
+
+	if( first >= nfrag )
 	{
-//----	writeRegister(REG_FIFO_ADDR_PTR, 0x00);  // Setting address pointer in FIFO data buffer
-		// Storing the received ACK
-		ACK.dst = _destination;
-		ACK.src = readRegister(REG_FIFO);
-		ACK.packnum = readRegister(REG_FIFO);
-		ACK.length = readRegister(REG_FIFO);
-		ACK.data[0] = readRegister(REG_FIFO);
+		return 0;
+	}
+	nb = (nfrag - first < _fecBlock) ? (nfrag - first) : _fecBlock;
 
-		// Checking the received ACK
-		if( ACK.dst == packet_sent.src )
+	// Fragments lost in the block
+	for( uint8_t i = 0; i < nb; i++ )
+	{
+		len[i] = (first + i == nfrag - 1) ? lastLen : frag;
+		coef[i] = gfPow(i);
+		if( (got[(first + i) >> 3] & (1 << ((first + i) & 7))) == 0 )
 		{
-			if( ACK.src == packet_sent.dst )
-			{
-				if( ACK.packnum == packet_sent.packnum )
-				{
-					if( ACK.length == 0 )
-					{
-						if( ACK.data[0] == CORRECT_PACKET )
-						{
-							state = 0;
-							#if (SX1278_debug_mode > 0)
-							// Printing the received ACK
-							Serial.println(F("## ACK received:"));
-							Serial.print(ACK.dst, HEX);
-							Serial.print("|");
-							Serial.print(ACK.src, HEX);
-							Serial.print("|");
-							Serial.print(ACK.packnum, HEX);
-							Serial.print("|");
-							Serial.print(ACK.length, HEX);
-							Serial.print("|");
-							Serial.print(ACK.data[0], HEX);
-							Serial.println(F(" ##"));
-							Serial.println();
-							#endif
-						}
-						else
-						{
-							state = 3;
-							#if (SX1278_debug_mode > 0)
-								Serial.println(F("** N-ACK received **"));
-								Serial.println();
-							#endif
-						}
-					}
-					else
-					{
-						state = 4;
-						#if (SX1278_debug_mode > 0)
-							Serial.println(F("** ACK length incorrectly received **"));
-							Serial.println();
-						#endif
-					}
-				}
-				else
-				{
-					state = 5;
-					#if (SX1278_debug_mode > 0)
-						Serial.println(F("** ACK number incorrectly received **"));
-						Serial.println();
-					#endif
-				}
+			if( m == 0 )
+			{
+				x = i;
 			}
 			else
 			{
-				state = 6;
-				#if (SX1278_debug_mode > 0)
-					Serial.println(F("** ACK source incorrectly received **"));
-					Serial.println();
-				#endif
+				y = i;
+			}
+			m++;
+		}
+	}
+	if( (m == 0) || (m > 2) || ((m == 2) && ((p == NULL) || (q == NULL)))
+		|| ((p == NULL) && (q == NULL)) )
+	{
+		return 0;
+	}
+	if( ((uint32_t)(first + nb - 1) * frag + len[nb - 1] > size) )
+	{
+		return 0;
+	}
+
+	if( m == 1 )
+	{
+		// d_x = Qx / g^x when P is lost
+		b = gfInv(coef[x]);
+	}
+	else
+	{
+		// d_x = A*Pxy + B*Qxy, A = g^(y-x)/(g^(y-x)+1), B = g^-x/(g^(y-x)+1)
+		b = gfInv(gfPow(y - x) ^ 1);
+		a = gfMul(gfPow(y - x), b);
+		b = gfMul(gfInv(coef[x]), b);
+	}
+
+	for( uint8_t j = 0; j < frag; j++ )
+	{
+		// Syndromes of the bytes received
+		sp = (p != NULL) ? p[j] : 0;
+		sq = (q != NULL) ? q[j] : 0;
+		for( uint8_t i = 0; i < nb; i++ )
+		{
+			if( (i == x) || ((m == 2) && (i == y)) || (j >= len[i]) )
+			{
+				continue;
+			}
+			v = data[(first + i) * frag + j];
+			sp ^= v;
+			sq ^= gfMul(coef[i], v);
+		}
+
+		if( m == 1 )
+		{
+			v = (p != NULL) ? sp : gfMul(sq, b);
+			if( j < len[x] )
+			{
+				data[(first + x) * frag + j] = v;
 			}
 		}
 		else
 		{
-			state = 7;
-			#if (SX1278_debug_mode > 0)
-				Serial.println(F("** ACK destination incorrectly received **"));
-				Serial.println();
-			#endif
+			v = gfMul(a, sp) ^ gfMul(b, sq);
+			if( j < len[x] )
+			{
+				data[(first + x) * frag + j] = v;
+			}
+			if( j < len[y] )
+			{
+				data[(first + y) * frag + j] = sp ^ v;
+			}
 		}
 	}
-	else
+
+	got[(first + x) >> 3] |= (1 << ((first + x) & 7));
+	if( m == 2 )
 	{
-		state = 8;
-		#if (SX1278_debug_mode > 0)
-			Serial.println(F("** ACK lost **"));
-			Serial.println();
-		#endif
+		got[(first + y) >> 3] |= (1 << ((first + y) & 7));
 	}
-	clearFlags();	// Initializing flags
-	return state;
+	#if (SX1278_debug_mode > 0)
+		Serial.print(F("## Fragments rebuilt with FEC: "));
+		Serial.println(m, DEC);
+	#endif
+	return m;
 }
 
 /*
- Function: Configures the module to transmit information with retries in case of error.
+ Function: Sends the parity frames of a block of bulk fragments: P is the XOR
+           of the fragments and Q the sum of g^i * fragment i over GF(256).
  Returns: Integer that determines if there has been any error
    state = 2  --> The command has not been executed
    state = 1  --> There has been an error while executing the command
    state = 0  --> The command has been executed with no errors
+ Parameters:
+   dest: destination of the transfer.
+   data: data of the transfer.
+   length: data length.
+   frag: fragment size.
+   block: block of the parity.
+   wait: time to wait to send each frame.
 */
-uint8_t SX1278::sendPacketMAXTimeoutACKRetries(	uint8_t dest, 
-													char  *payload)
+int8_t SX1278::fecSend(uint8_t dest, uint8_t *data, uint16_t length, uint8_t frag,
+						uint16_t block, uint32_t wait)
 {
-	return sendPacketTimeoutACKRetries(dest, payload, MAX_TIMEOUT);
+	int8_t state = 2;
+	uint16_t nfrag = (length + frag - 1) / frag;
+	uint16_t first = block * _fecBlock;
+	uint8_t nb;
+	uint8_t lastLen;
+	uint8_t l;
+	uint8_t v;
+	uint8_t coef[FEC_MAX_BLOCK];
+
+	nb = (nfrag - first < _fecBlock) ? (nfrag - first) : _fecBlock;
+	lastLen = length - (nfrag - 1) * frag;
+	for( uint8_t i = 0; i < nb; i++ )
+	{
+		coef[i] = gfPow(i);
+	}
+
+	for( uint8_t k = 0; k < _fecParity; k++ )
+	{
+		for( uint8_t j = 0; j < frag; j++ )
+		{
+			v = 0;
+			for( uint8_t i = 0; i < nb; i++ )
+			{
+				// Short last fragment is padded with zeros
+				l = (first + i == nfrag - 1) ? lastLen : frag;
+				if( j < l )
+				{
+					v ^= (k == 0) ? data[(first + i) * frag + j] : gfMul(coef[i], data[(first + i) * frag + j]);
+				}
+			}
+			packet_sent.data[BULK_HEADER + j] = v;
+		}
+		// Header: type and block, length of the last fragment as packet number
+		packet_sent.data[0] = (k == 0) ? BULK_PARITY : (BULK_PARITY | BULK_FLAG_Q);
+		packet_sent.data[1] = block;
+		_packetNumber = lastLen;
+		state = sendPacketTimeout(dest, packet_sent.data, frag + BULK_HEADER, wait);
+		if( state != 0 )
+		{
+			return 1;
+		}
+	}
+	return 0;
 }
+#endif
 
 /*
- Function: Configures the module to transmit information with retries in case of error.
- Returns: Integer that determines if there has been any error
-   state = 2  --> The command has not been executed
-   state = 1  --> There has been an error while executing the command
-   state = 0  --> The command has been executed with no errors
+ Function: Gets the data bytes of each bulk fragment sent to 'dest', so that
+           the whole frame fits in its 8 bit length.
+ Returns: Size of the fragments
+ Parameters:
+   dest: destination of the transfer.
 */
-uint8_t SX1278::sendPacketMAXTimeoutACKRetries(	uint8_t dest, 
-													uint8_t *payload, 
-													uint16_t length16)
+uint8_t SX1278::bulkFragment(uint8_t dest)
 {
-	return sendPacketTimeoutACKRetries(dest, payload, length16, MAX_TIMEOUT);
+	uint8_t frag;
+
+	if( _modem == LORA )
+	{
+		frag = min(MAX_LENGTH - frameOverhead(dest), MAX_PAYLOAD) - BULK_HEADER;
+	}
+	else
+	{
+		frag = min(MAX_LENGTH_FSK - frameOverhead(dest), MAX_PAYLOAD_FSK) - BULK_HEADER;
+	}
+	if( _compression != COMPRESSION_NONE )
+	{
+		frag--;		// Room for the codec byte
+	}
+	if( _security != SECURITY_NONE )
+	{
+		frag -= SECURITY_OVERHEAD;	// Room for the counter and the tag
+	}
+	return frag;
 }
 
 /*
- Function: Configures the module to transmit information with retries in case of error.
+ Function: Sends a buffer larger than a packet, fragmented and acknowledged by
+           windows with a cumulative ACK carrying the ranges received.
  Returns: Integer that determines if there has been any error
-   state = 9  --> The ACK lost (no data available)
-   state = 8  --> The ACK lost
-   state = 7  --> The ACK destination incorrectly received
-   state = 6  --> The ACK source incorrectly received
-   state = 5  --> The ACK number incorrectly received
-   state = 4  --> The ACK length incorrectly received
-   state = 3  --> N-ACK received
    state = 2  --> The command has not been executed
    state = 1  --> There has been an error while executing the command
    state = 0  --> The command has been executed with no errors
+   state = -1 --> Forbidden command in fixed length mode
+ Parameters:
+   dest: destination of the transfer.
+   data: data to send.
+   length: data length.
+   wait: time to wait to send each frame, and each ACK until the round
+         trip time to 'dest' is known.
 */
-uint8_t SX1278::sendPacketTimeoutACKRetries(uint8_t dest, char *payload)
+int8_t SX1278::sendBulk(uint8_t dest, uint8_t *data, uint16_t length, uint32_t wait)
 {
-	uint8_t state = 2;
+	int8_t state = 2;
+	uint8_t acked[MAX_BULK_FRAGMENTS/8];
+	uint8_t frag;
+	uint8_t type;
+	uint16_t nfrag;
+	uint16_t base = 0;
+	uint16_t end;
+	uint16_t last;
+	uint16_t len;
+	uint16_t first;
+	uint16_t stop;
+	uint8_t fails = 0;
+	unsigned long sent;
+#if (SX1278_fec_mode > 0)
+	uint16_t parity = 0;
+#endif
 
 	#if (SX1278_debug_mode > 1)
 		Serial.println();
-		Serial.println(F("Starting 'sendPacketTimeoutACKRetries'"));
+		Serial.println(F("Starting 'sendBulk'"));
 	#endif
 
-	// Sending packet to 'dest' destination and waiting an ACK response.
-	state = 1;
-	while( (state != 0) && (_retries <= _maxRetries) )
+	// Fragment index is sent as packet number
+	if( _fixedLength != 0 )
 	{
-		state = sendPacketTimeoutACK(dest, payload);
-		_retries++;
+		return -1;
+	}
+	frag = bulkFragment(dest);
+	nfrag = (length + frag - 1) / frag;
+	if( (nfrag == 0) || (nfrag > MAX_BULK_FRAGMENTS) )
+	{
+		return 1;
 	}
+	memset( acked, 0x00, sizeof(acked) );
 	_retries = 0;
 
-	return state;
-}
+	type = BULK_DATA;
+	if( _arqMode == ARQ_GO_BACK_N )
+	{
+		type |= BULK_FLAG_GBN;
+	}
 
-/*
- Function: Configures the module to transmit information with retries in case of error.
- Returns: Integer that determines if there has been any error
-   state = 9  --> The ACK lost (no data available)
-   state = 8  --> The ACK lost
-   state = 7  --> The ACK destination incorrectly received
-   state = 6  --> The ACK source incorrectly received
-   state = 5  --> The ACK number incorrectly received
-   state = 4  --> The ACK length incorrectly received
-   state = 3  --> N-ACK received
-   state = 2  --> The command has not been executed
-   state = 1  --> There has been an error while executing the command
-   state = 0  --> The command has been executed with no errors
-*/
-uint8_t SX1278::sendPacketTimeoutACKRetries(uint8_t dest, 
-												uint8_t *payload, 
-												uint16_t length16)
-{
-	uint8_t state = 2;
+	while( base < nfrag )
+	{
+		// Send the fragments of the window not acknowledged yet
+		end = base + _arqWindow;
+		if( end > nfrag )
+		{
+			end = nfrag;
+		}
+		last = base;
+		for( uint16_t i = base; i < end; i++ )
+		{
+			if( (acked[i >> 3] & (1 << (i & 7))) == 0 )
+			{
+				last = i;
+			}
+		}
+		for( uint16_t i = base; i <= last; i++ )
+		{
+			if( (acked[i >> 3] & (1 << (i & 7))) != 0 )
+			{
+				continue;
+			}
+#if (SX1278_fec_mode > 0)
+			// The parity of a block goes before its last fragment, so the
+			// ACK request is still the last frame of the window
+			if( (_fecParity != 0) && (i / _fecBlock == parity)
+				&& ((i % _fecBlock == _fecBlock - 1) || (i == nfrag - 1)) )
+			{
+				if( fecSend(dest, data, length, frag, parity, wait) != 0 )
+				{
+					return 1;
+				}
+				parity++;
+			}
+#endif
+			len = frag;
+			if( (uint32_t)i*frag + len > length )
+			{
+				len = length - i*frag;
+			}
+			// Header: type and last fragment index. Broadcast and groups are not acknowledged
+			packet_sent.data[0] = ((i == last) && !isMulticast(dest)) ? (type | BULK_FLAG_ACKREQ) : type;
+			packet_sent.data[1] = nfrag - 1;
+			memcpy( &packet_sent.data[BULK_HEADER], &data[i*frag], len );
+			_packetNumber = i;
+			state = sendPacketTimeout(dest, packet_sent.data, len + BULK_HEADER, wait);
+			if( state != 0 )
+			{
+				return 1;
+			}
+		}
+		sent = millis();
 
-	#if (SX1278_debug_mode > 1)
-		Serial.println();
-		Serial.println(F("Starting 'sendPacketTimeoutACKRetries'"));
-	#endif
+		if( isMulticast(dest) )
+		{
+			// Sent once, losses are left to FEC
+			base = end;
+			continue;
+		}
 
-	// Sending packet to 'dest' destination and waiting an ACK response.
-	state = 1;
-	while( (state != 0) && (_retries <= _maxRetries) )
-	{
-		state = sendPacketTimeoutACK(dest, payload, length16);
-		_retries++;
+		// Wait for the cumulative ACK of the window
+		state = receivePacketTimeout(getRTO(dest, wait));
+		if( (state == 0)
+			&& (packet_received.src == dest)
+			&& (_payloadlength >= BULK_ACK_HEADER)
+			&& (packet_received.data[0] == BULK_ACK)
+			&& (_payloadlength >= BULK_ACK_HEADER + 2*packet_received.data[2]) )
+		{
+			// Karn: only ACKs of a first request are sampled
+			if( fails == 0 )
+			{
+				updateRTT(dest, millis() - sent);
+			}
+			// Every fragment before the first missing one has been received
+			for( uint16_t i = 0; i < packet_received.data[1]; i++ )
+			{
+				acked[i >> 3] |= (1 << (i & 7));
+			}
+			// Ranges received after the first missing fragment
+			for( uint8_t r = 0; r < packet_received.data[2]; r++ )
+			{
+				first = packet_received.data[BULK_ACK_HEADER + 2*r];
+				stop = packet_received.data[BULK_ACK_HEADER + 2*r + 1];
+				for( uint16_t i = first; (i <= stop) && (i < nfrag); i++ )
+				{
+					acked[i >> 3] |= (1 << (i & 7));
+				}
+			}
+			fails = 0;
+		}
+		else
+		{
+			fails++;
+			#if (SX1278_debug_mode > 0)
+				Serial.println(F("** Bulk ACK not received **"));
+			#endif
+			if( fails > _maxRetries )
+			{
+				return 1;
+			}
+		}
+
+		// Slide the window up to the first fragment not acknowledged
+		while( (base < nfrag) && ((acked[base >> 3] & (1 << (base & 7))) != 0) )
+		{
+			base++;
+		}
 	}
-	_retries = 0;
 
-	return state;
+	#if (SX1278_debug_mode > 1)
+		Serial.print(F("## Bulk transfer of "));
+		Serial.print(length, DEC);
+		Serial.println(F(" bytes has been successfully sent ##"));
+		Serial.println();
+	#endif
+	return 0;
 }
 
 /*
- Function: Configures the module to transmit information with retries in case of error.
+ Function: Receives a buffer sent with 'sendBulk', answering each ACK request
+           with the first fragment missing and the ranges received after it.
  Returns: Integer that determines if there has been any error
-   state = 9  --> The ACK lost (no data available)
-   state = 8  --> The ACK lost
-   state = 7  --> The ACK destination incorrectly received
-   state = 6  --> The ACK source incorrectly received
-   state = 5  --> The ACK number incorrectly received
-   state = 4  --> The ACK length incorrectly received
-   state = 3  --> N-ACK received
    state = 2  --> The command has not been executed
    state = 1  --> There has been an error while executing the command
    state = 0  --> The command has been executed with no errors
+   state = -1 --> Forbidden command in fixed length mode
+ Parameters:
+   data: buffer to store the received data.
+   size: buffer size.
+   wait: time to wait for each frame.
 */
-uint8_t SX1278::sendPacketTimeoutACKRetries(uint8_t dest, 
-												char *payload, 
-												uint32_t wait)
+int8_t SX1278::receiveBulk(uint8_t *data, uint16_t size, uint32_t wait)
 {
-	uint8_t state = 2;
+	int8_t state = 2;
+	uint8_t got[MAX_BULK_FRAGMENTS/8];
+	uint8_t ack[BULK_ACK_HEADER + 2*MAX_ARQ_RANGES];
+	uint8_t frag = 0;
+	uint8_t src = 0;
+	uint8_t type;
+	uint8_t ranges;
+	uint16_t nfrag = 0;
+	uint16_t count = 0;
+	uint16_t idx;
+	uint16_t len;
+	uint16_t missing;
+	boolean broadcast = false;
+#if (SX1278_fec_mode > 0)
+	uint8_t fecP[MAX_PAYLOAD - BULK_HEADER];
+	uint8_t fecQ[MAX_PAYLOAD - BULK_HEADER];
+	boolean haveP = false;
+	boolean haveQ = false;
+	uint16_t fecBlock = 0;
+	uint8_t lastLen = 0;
+	uint8_t n;
+#endif
 
 	#if (SX1278_debug_mode > 1)
 		Serial.println();
-		Serial.println(F("Starting 'sendPacketTimeoutACKRetries'"));
+		Serial.println(F("Starting 'receiveBulk'"));
 	#endif
 
-	// Sending packet to 'dest' destination and waiting an ACK response.
-	state = 1;
-	while( (state != 0) && (_retries <= _maxRetries) )
+	if( _fixedLength != 0 )
 	{
-		state = sendPacketTimeoutACK(dest, payload, wait);
-		_retries++;
+		return -1;
 	}
-	_retries = 0;
+	memset( got, 0x00, sizeof(got) );
+	_bulkLength = 0;
+	missing = 0;
+
+	while( true )
+	{
+		state = receivePacketTimeout(wait);
+		if( state != 0 )
+		{
+			// Once complete, the transfer ends when the sender stops
+			// asking for ACKs
+			if( (nfrag != 0) && (count == nfrag) )
+			{
+				break;
+			}
+			return 1;
+		}
+
+		type = packet_received.data[0];
+		if( (_payloadlength < BULK_HEADER)
+			|| (((type & BULK_TYPE_MASK) != BULK_DATA) && ((type & BULK_TYPE_MASK) != BULK_PARITY)) )
+		{
+			continue;
+		}
+		if( nfrag == 0 )
+		{
+			// The transfer starts with the first fragment received
+			if( (type & BULK_TYPE_MASK) != BULK_DATA )
+			{
+				continue;
+			}
+			src = packet_received.src;
+			nfrag = packet_received.data[1] + 1;
+			broadcast = isMulticast(packet_received.dst);
+			// The framing bytes, so the fragment size, depend on the destination
+			frag = bulkFragment(packet_received.dst);
+		}
+		else if( packet_received.src != src )
+		{
+			continue;
+		}
+
+		idx = packet_received.packnum;
+		len = _payloadlength - BULK_HEADER;
+		if( (type & BULK_TYPE_MASK) == BULK_PARITY )
+		{
+#if (SX1278_fec_mode > 0)
+			// Keep the parity of the last block announced
+			if( len == frag )
+			{
+				if( packet_received.data[1] != fecBlock )
+				{
+					fecBlock = packet_received.data[1];
+					haveP = false;
+					haveQ = false;
+				}
+				lastLen = idx;
+				if( (type & BULK_FLAG_Q) == 0 )
+				{
+					memcpy( fecP, &packet_received.data[BULK_HEADER], frag );
+					haveP = true;
+				}
+				else
+				{
+					memcpy( fecQ, &packet_received.data[BULK_HEADER], frag );
+					haveQ = true;
+				}
+			}
+#endif
+		}
+		// Store the fragment by its index. Go-back-N only accepts the
+		// first fragment missing
+		else if( (idx < nfrag) && ((got[idx >> 3] & (1 << (idx & 7))) == 0)
+			&& (((type & BULK_FLAG_GBN) == 0) || (idx == missing)) )
+		{
+			if( (uint32_t)idx*frag + len > size )
+			{
+				#if (SX1278_debug_mode > 0)
+					Serial.println(F("** Bulk buffer too small **"));
+				#endif
+				return 1;
+			}
+			memcpy( &data[idx*frag], &packet_received.data[BULK_HEADER], len );
+			got[idx >> 3] |= (1 << (idx & 7));
+			count++;
+			if( idx == nfrag - 1 )
+			{
+				_bulkLength = idx*frag + len;
+			}
+			while( (missing < nfrag - 1) && ((got[missing >> 3] & (1 << (missing & 7))) != 0) )
+			{
+				missing++;
+			}
+		}
+
+#if (SX1278_fec_mode > 0)
+		// Rebuild the fragments lost in the block of the last parity
+		if( haveP || haveQ )
+		{
+			n = fecRecover(data, size, got, nfrag, frag, lastLen, fecBlock,
+							haveP ? fecP : NULL, haveQ ? fecQ : NULL);
+			if( n != 0 )
+			{
+				count += n;
+				if( (got[(nfrag - 1) >> 3] & (1 << ((nfrag - 1) & 7))) != 0 )
+				{
+					_bulkLength = (nfrag - 1) * frag + lastLen;
+				}
+				while( (missing < nfrag - 1) && ((got[missing >> 3] & (1 << (missing & 7))) != 0) )
+				{
+					missing++;
+				}
+			}
+		}
+#endif
 
-	return state;
-}
+		// Broadcast transfers are not acknowledged
+		if( broadcast )
+		{
+			if( count == nfrag )
+			{
+				break;
+			}
+			continue;
+		}
 
-/*
- Function: Configures the module to transmit information with retries in case of error.
- Returns: Integer that determines if there has been any error
-   state = 9  --> The ACK lost (no data available)
-   state = 8  --> The ACK lost
-   state = 7  --> The ACK destination incorrectly received
-   state = 6  --> The ACK source incorrectly received
-   state = 5  --> The ACK number incorrectly received
-   state = 4  --> The ACK length incorrectly received
-   state = 3  --> N-ACK received
-   state = 2  --> The command has not been executed
-   state = 1  --> There has been an error while executing the command
-   state = 0  --> The command has been executed with no errors
-*/
-uint8_t SX1278::sendPacketTimeoutACKRetries(uint8_t dest, 
-												uint8_t *payload, 
-												uint16_t length16, 
-												uint32_t wait)
-{
-	uint8_t state = 2;
+		if( ((type & BULK_TYPE_MASK) == BULK_DATA) && ((type & BULK_FLAG_ACKREQ) != 0) )
+		{
+			// Ranges received from the first fragment missing
+			ranges = 0;
+			idx = missing;
+			while( (idx < nfrag) && (ranges < MAX_ARQ_RANGES) )
+			{
+				if( (got[idx >> 3] & (1 << (idx & 7))) == 0 )
+				{
+					idx++;
+					continue;
+				}
+				ack[BULK_ACK_HEADER + 2*ranges] = idx;
+				while( (idx + 1 < nfrag) && ((got[(idx + 1) >> 3] & (1 << ((idx + 1) & 7))) != 0) )
+				{
+					idx++;
+				}
+				ack[BULK_ACK_HEADER + 2*ranges + 1] = idx;
+				ranges++;
+				idx++;
+			}
+			ack[0] = BULK_ACK;
+			ack[1] = missing;
+			ack[2] = ranges;
+			sendPacketTimeout(src, ack, BULK_ACK_HEADER + 2*ranges, wait);
+		}
+	}
 
 	#if (SX1278_debug_mode > 1)
+		Serial.print(F("## Bulk transfer of "));
+		Serial.print(_bulkLength, DEC);
+		Serial.println(F(" bytes has been successfully received ##"));
 		Serial.println();
-		Serial.println(F("Starting 'sendPacketTimeoutACKRetries'"));
 	#endif
-
-	// Sending packet to 'dest' destination and waiting an ACK response.
-	state = 1;
-	while( (state != 0) && (_retries <= _maxRetries) )
-	{
-		state = sendPacketTimeoutACK(dest, payload, length16, wait);
-		_retries++;
-	}
-	_retries = 0;
-
-	return state;
+	return 0;
 }
 
 /*
@@ -5332,11 +9983,11 @@ uint8_t SX1278::getTemp()
 		Serial.println(F("Starting 'getTemp'"));
 	#endif
 
-	st0 = readRegister(REG_OP_MODE);	// Save the previous status
+	st0 = _opMode;	// Save the previous status
 
 	if( _modem == LORA )
 	{ // Allowing access to FSK registers while in LoRa standby mode
-		writeRegister(REG_OP_MODE, LORA_STANDBY_FSK_REGS_MODE);
+		setOpMode(LORA_STANDBY_FSK_REGS_MODE);
 	}
 
 	state = 1;
@@ -5363,7 +10014,7 @@ uint8_t SX1278::getTemp()
 
 	if( _modem == LORA )
 	{
-		writeRegister(REG_OP_MODE, st0);	// Getting back to previous status
+		setOpMode(st0);	// Getting back to previous status
 	}
 
 	state = 0;
@@ -5413,14 +10064,14 @@ bool SX1278::cadDetected()
 	unsigned long time = millis();
 	
 	// set LNA
-	sx1278.writeRegister(REG_LNA,0x23);
-	sx1278.clearFlags();	
+	writeRegister(REG_LNA,0x23);
+	clearFlags();	
 	
-    sx1278.getRSSI();
+    getRSSI();
     
 	#if (SX1278_debug_mode > 1) 
 		Serial.print(F("Inside CAD DETECTION -> RSSI: "));
-		Serial.println(sx1278._RSSI);   
+		Serial.println(_RSSI);   
 	#endif
 	
 	if( _modem == LORA )
@@ -5430,15 +10081,17 @@ bool SX1278::cadDetected()
 		#endif
 		
 		// Setting LoRa CAD mode
-		sx1278.writeRegister(REG_OP_MODE,0x87);  
+		setOpMode(0x87);  
 	} 
 	
 	// Wait for IRQ CadDone
-    val = sx1278.readRegister(REG_IRQ_FLAGS);
+    val = readRegister(REG_IRQ_FLAGS);
     while((bitRead(val,2) == 0) && (millis()-time)<10000 )
     {
-      val = sx1278.readRegister(REG_IRQ_FLAGS);
+      val = readRegister(REG_IRQ_FLAGS);
     }    
+	// The module goes back to standby by itself
+	updatePowerState(LORA_STANDBY_MODE);
 	
 	// After waiting or detecting CadDone
 	// check 'CadDetected' bit in 'RegIrqFlags' register
@@ -5457,5 +10110,397 @@ bool SX1278::cadDetected()
 	
 }
 
+/*
+ Function: Runs a channel activity detection for the low power listening.
+           Unlike 'cadDetected' it does not set the LNA nor read the RSSI,
+           and it polls CadDone without the delay of 'readRegister'.
+ Returns: Boolean that's 'true' if a preamble has been detected
+*/
+boolean SX1278::lplDetected()
+{
+	uint8_t value = 0;
+	unsigned long start = millis();
+
+	clearFlags();
+	setOpMode(0x87);	// LoRa CAD mode
+
+	// Wait for IRQ CadDone
+	do
+	{
+		readRegisters(REG_IRQ_FLAGS, &value, 1);
+	} while( (bitRead(value, 2) == 0) && (millis() - start < LPL_CAD_TIMEOUT) );
+	// The module goes back to standby by itself
+	updatePowerState(LORA_STANDBY_MODE);
+
+	// CadDetected flag
+	return (bitRead(value, 0) == 1);
+}
+
+/*
+ Function: Sets the interval between channel activity samples of the low
+           power listening. The preamble is lengthened to cover it and the
+           time from the wake up until the reception is set, so both ends
+           must set the same interval after setting SF and BW.
+ Returns: Integer that determines if there has been any error
+   state = 2  --> The command has not been executed
+   state = 1  --> There has been an error while executing the command
+   state = 0  --> The command has been executed with no errors
+   state = -1 --> Forbidden command for this protocol
+ Parameters:
+   interval: sleep time (ms) between samples, '0' to get back to the
+             default preamble.
+*/
+int8_t SX1278::setWakeInterval(uint16_t interval)
+{
+	int8_t state = 2;
+	float symbols;
+
+	#if (SX1278_debug_mode > 1)
+		Serial.println();
+		Serial.println(F("Starting 'setWakeInterval'"));
+	#endif
+
+	if( _modem == FSK )
+	{
+		state = -1;
+		#if (SX1278_debug_mode > 1)
+			Serial.println(F("** Low power listening is only available in LoRa mode **"));
+			Serial.println();
+		#endif
+		return state;
+	}
+
+	// A whole sleep period, the wake up, the CAD and the reception setup
+	// must fall inside the preamble
+	symbols = ceil((interval + LPL_WAKE_OVERHEAD) / symbolTime()) + LPL_PREAMBLE_MARGIN;
+	if( symbols > 65535 )
+	{
+		state = 1;
+		#if (SX1278_debug_mode > 1)
+			Serial.println(F("** Wake interval too long for this SF and BW **"));
+			Serial.println();
+		#endif
+	}
+	else
+	{
+		_wakeInterval = interval;
+		state = setPreambleLength( (interval == 0) ? 8 : (uint16_t)symbols );
+	}
+	return state;
+}
+
+/*
+ Function: Receives a packet with low power listening: the module sleeps and
+           wakes every '_wakeInterval' to run a CAD, and only listens when a
+           preamble is detected.
+ Returns: Integer that determines if there has been any error
+   state = 2  --> The command has not been executed
+   state = 1  --> There has been an error while executing the command
+   state = 0  --> The command has been executed with no errors
+   state = -1 --> Forbidden command for this protocol
+ Parameters:
+   wait: time to wait for a packet.
+*/
+int8_t SX1278::receiveLowPower(uint32_t wait)
+{
+	int8_t state = 2;
+	unsigned long previous;
+	unsigned long start;
+	uint32_t listen;
+
+	#if (SX1278_debug_mode > 1)
+		Serial.println();
+		Serial.println(F("Starting 'receiveLowPower'"));
+	#endif
+
+	if( _modem == FSK )
+	{
+		return -1;
+	}
+
+	// Rest of the preamble and header after a detection
+	listen = _wakeInterval + LPL_WAKE_OVERHEAD + (uint32_t)(LPL_LISTEN_SYMBOLS * symbolTime()) + 1;
+	// The LNA setting is kept in sleep mode
+	writeRegister(REG_LNA, 0x23);
+	state = 1;
+	previous = millis();
+	while( millis() - previous < wait )
+	{
+		start = millis();
+		wake();
+		if( lplDetected() )
+		{
+			#if (SX1278_debug_mode > 0)
+				Serial.println(F("## Preamble detected ##"));
+			#endif
+			if( receive() == 0 )
+			{
+				// The sender sized the preamble with LPL_WAKE_OVERHEAD, a
+				// slower wake up may miss the start of the packet
+				#if (SX1278_debug_mode > 0)
+					if( millis() - start > LPL_WAKE_OVERHEAD )
+					{
+						Serial.println(F("** Wake up longer than LPL_WAKE_OVERHEAD **"));
+					}
+				#endif
+				if( availableData(listen) && (getPacket() == 0) )
+				{
+					state = 0;
+					break;
+				}
+			}
+		}
+		setSleep();
+		delay(_wakeInterval);
+
+		// Condition to avoid an overflow (DO NOT REMOVE)
+		if( millis() < previous )
+		{
+			previous = millis();
+		}
+	}
+	idle();
+	return state;
+}
+
+/*
+ Function: Broadcasts a TDMA beacon with the slot map. Slot 'i' belongs to
+           'owners[i]' and starts 'TDMA_GUARD + i * slot' ms after the end of
+           the beacon. The slot fits a frame with a 'length' bytes payload.
+ Returns: Integer that determines if there has been any error
+   state = 2  --> The command has not been executed
+   state = 1  --> There has been an error while executing the command
+   state = 0  --> The command has been executed with no errors
+   state = -1 --> Forbidden parameter value for this function
+ Parameters:
+   owners: node address of each slot.
+   nslots: number of slots.
+   length: largest payload sent in a slot.
+   period: time (ms) until the next beacon.
+*/
+int8_t SX1278::sendBeacon(uint8_t *owners, uint8_t nslots, uint16_t length, uint32_t period)
+{
+	int8_t state = 2;
+	uint8_t beacon[TDMA_BEACON_HEADER + TDMA_MAX_SLOTS];
+	uint32_t stamp;
+
+	#if (SX1278_debug_mode > 1)
+		Serial.println();
+		Serial.println(F("Starting 'sendBeacon'"));
+	#endif
+
+	if( (nslots == 0) || (nslots > TDMA_MAX_SLOTS) )
+	{
+		state = -1;
+		#if (SX1278_debug_mode > 1)
+			Serial.println(F("** Wrong number of slots **"));
+			Serial.println();
+		#endif
+		return state;
+	}
+
+	// The slot length is computed from the airtime, the guard absorbs the
+	// clock drift left after the correction
+	_tdmaSlot = (uint16_t)ceil(timeOnAir(length + payloadOverhead())) + TDMA_GUARD;
+	_tdmaPeriod = period;
+	_tdmaSlots = nslots;
+	_tdmaIndex = TDMA_NO_SLOT;
+	stamp = millis();
+
+	beacon[0] = TDMA_BEACON;
+	beacon[1] = _beaconSeq++;
+	beacon[2] = nslots;
+	beacon[3] = _tdmaSlot & 0xFF;
+	beacon[4] = _tdmaSlot >> 8;
+	for( uint8_t i = 0; i < 4; i++ )
+	{
+		beacon[5 + i] = (period >> (8 * i)) & 0xFF;
+		beacon[9 + i] = (stamp >> (8 * i)) & 0xFF;
+	}
+	memcpy( &beacon[TDMA_BEACON_HEADER], owners, nslots );
+
+	state = sendPacketTimeout(BROADCAST_0, beacon, TDMA_BEACON_HEADER + nslots);
+	if( state == 0 )
+	{
+		_beaconEnd = _txDoneTime;
+		_tdmaSynced = true;
+	}
+	return state;
+}
+
+/*
+ Function: Waits for a TDMA beacon, corrects the clock drift with its time
+           stamp and finds the slot of the node. When synchronized the module
+           sleeps until the expected beacon.
+ Returns: Integer that determines if there has been any error
+   state = 2  --> The command has not been executed
+   state = 1  --> There has been an error while executing the command
+   state = 0  --> The command has been executed with no errors
+ Parameters:
+   wait: time to wait for the beacon once the module listens.
+*/
+int8_t SX1278::waitBeacon(uint32_t wait)
+{
+	int8_t state = 2;
+	unsigned long next;
+	unsigned long start;
+	uint32_t stamp;
+	uint32_t period;
+
+	#if (SX1278_debug_mode > 1)
+		Serial.println();
+		Serial.println(F("Starting 'waitBeacon'"));
+	#endif
+
+	if( _tdmaSynced )
+	{
+		// Sleep until a guard time before the expected beacon
+		next = _beaconStart + (unsigned long)(_tdmaPeriod * _clockRatio);
+		if( (long)(next - TDMA_GUARD - millis()) > 0 )
+		{
+			setSleep();
+			delay(next - TDMA_GUARD - millis());
+		}
+		wait += 2 * TDMA_GUARD;
+	}
+
+	state = 1;
+	start = millis();
+	while( millis() - start < wait )
+	{
+		if( receivePacketTimeout(wait - (millis() - start)) != 0 )
+		{
+			continue;
+		}
+		if( (packet_received.data[0] != TDMA_BEACON)
+			|| (_payloadlength < TDMA_BEACON_HEADER)
+			|| (_payloadlength < TDMA_BEACON_HEADER + packet_received.data[2]) )
+		{
+			continue;
+		}
+
+		stamp = 0;
+		period = 0;
+		for( uint8_t i = 0; i < 4; i++ )
+		{
+			period |= (uint32_t)packet_received.data[5 + i] << (8 * i);
+			stamp |= (uint32_t)packet_received.data[9 + i] << (8 * i);
+		}
+
+		// Local ticks per gateway tick between the last two beacons
+		if( _tdmaSynced && (stamp != _beaconStamp) )
+		{
+			_clockRatio = (float)(_rxDoneTime - _beaconEnd) / (stamp - _beaconStamp);
+			if( (_clockRatio < 1.0 - TDMA_MAX_DRIFT) || (_clockRatio > 1.0 + TDMA_MAX_DRIFT) )
+			{
+				// Beacons lost or wrong time stamps
+				_clockRatio = 1.0;
+			}
+		}
+
+		_tdmaSlots = packet_received.data[2];
+		_tdmaSlot = packet_received.data[3] | ((uint16_t)packet_received.data[4] << 8);
+		_tdmaPeriod = period;
+		_beaconStamp = stamp;
+		_beaconEnd = _rxDoneTime;
+		_beaconStart = _rxDoneTime - (unsigned long)timeOnAir(_payloadlength);
+		_tdmaIndex = TDMA_NO_SLOT;
+		for( uint8_t i = 0; i < _tdmaSlots; i++ )
+		{
+			if( packet_received.data[TDMA_BEACON_HEADER + i] == _nodeAddress )
+			{
+				_tdmaIndex = i;
+				break;
+			}
+		}
+		_tdmaSynced = true;
+		state = 0;
+		#if (SX1278_debug_mode > 0)
+			Serial.print(F("## Beacon received, slot "));
+			Serial.print(_tdmaIndex, DEC);
+			Serial.println(F(" ##"));
+		#endif
+		break;
+	}
+	if( state != 0 )
+	{
+		// Listen from scratch the next time
+		_tdmaSynced = false;
+	}
+	idle();
+	return state;
+}
+
+/*
+ Function: Sends a packet in the slot of the node, sleeping until it starts.
+ Returns: Integer that determines if there has been any error
+   state = 2  --> The command has not been executed
+   state = 1  --> There has been an error while executing the command
+   state = 0  --> The command has been executed with no errors
+   state = -1 --> The node has no slot, its slot has passed or the packet
+                  does not fit in it
+ Parameters:
+   dest: packet destination.
+   payload: packet payload.
+   length: payload length, it must fit in the slot.
+*/
+int8_t SX1278::sendInSlot(uint8_t dest, uint8_t *payload, uint16_t length)
+{
+	int8_t state = 2;
+	unsigned long start;
+	unsigned long prepare;
+
+	#if (SX1278_debug_mode > 1)
+		Serial.println();
+		Serial.println(F("Starting 'sendInSlot'"));
+	#endif
+
+	if( !_tdmaSynced || (_tdmaIndex == TDMA_NO_SLOT) )
+	{
+		return -1;
+	}
+	// A longer frame would overflow into the next slot
+	if( ceil(timeOnAir(length + payloadOverhead())) > _tdmaSlot - TDMA_GUARD )
+	{
+		state = -1;
+		#if (SX1278_debug_mode > 1)
+			Serial.println(F("** The packet does not fit in the slot **"));
+			Serial.println();
+		#endif
+		return state;
+	}
+
+	start = _beaconEnd + (unsigned long)((TDMA_GUARD + (uint32_t)_tdmaIndex * _tdmaSlot) * _clockRatio);
+	if( (long)(start - millis()) < 0 )
+	{
+		state = -1;
+		#if (SX1278_debug_mode > 1)
+			Serial.println(F("** The slot has passed, wait for the next beacon **"));
+			Serial.println();
+		#endif
+		return state;
+	}
+	// The FIFO is lost in sleep mode, so it is loaded just before the slot
+	setSleep();
+	if( (long)(start - _prepareTime - millis()) > 0 )
+	{
+		delay(start - _prepareTime - millis());
+	}
+	prepare = millis();
+	state = prepareTx(dest, payload, length);
+	_prepareTime = millis() - prepare;
+	if( state != 0 )
+	{
+		return state;
+	}
+
+	// Firing at the start of the slot
+	while( (long)(start - millis()) > 0 );
+	fireTx();
+	setTimeout();
+	state = waitTxDone(_sendTime);
+	return state;
+}
+
 
 SX1278	sx1278 = SX1278();
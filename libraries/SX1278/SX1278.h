@@ -52,6 +52,29 @@
 
 #define SX1278_debug_mode 0
 
+//! FEC parity frames in bulk transfers (0 disabled, 1 enabled) //
+#define SX1278_fec_mode 0
+
+//! Instrumentation counters (0 disabled, 1 enabled) //
+#define SX1278_instrumentation 0
+
+//! Binary event trace in a RAM ring buffer (0 disabled, 1 enabled) //
+#define SX1278_trace_mode 0
+
+//! Link statistics by peer (0 disabled, 1 enabled), off on AVR to save RAM //
+#if defined(__AVR__)
+	#define SX1278_link_stats 0
+#else
+	#define SX1278_link_stats 1
+#endif
+
+//! Payload compression (0 disabled, 1 enabled), off on AVR to save RAM //
+#if defined(__AVR__)
+	#define SX1278_compression_mode 0
+#else
+	#define SX1278_compression_mode 1
+#endif
+
 #define SX1278_SS SS
 
 //! MACROS //
@@ -59,6 +82,28 @@
 #define bitSet(value, bit) ((value) |= (1UL << (bit)))    // set bit to '1'
 #define bitClear(value, bit) ((value) &= ~(1UL << (bit))) // set bit to '0'
 
+#if (SX1278_instrumentation > 0)
+	#define SX1278_COUNT(counter)		(_instr.counter++)
+	#define SX1278_COUNT_N(counter, n)	(_instr.counter += (n))
+	#define SX1278_TIME_CALL(op)		instrumentTimer _instrTimer(this, op)
+#else
+	#define SX1278_COUNT(counter)
+	#define SX1278_COUNT_N(counter, n)
+	#define SX1278_TIME_CALL(op)
+#endif
+
+#if (SX1278_trace_mode > 0)
+	#define SX1278_TRACE(event, reg, value)	trace(event, reg, value)
+#else
+	#define SX1278_TRACE(event, reg, value)
+#endif
+
+#if (SX1278_link_stats > 0)
+	#define SX1278_LINK(call)		call
+#else
+	#define SX1278_LINK(call)
+#endif
+
 
 //! REGISTERS //
 //							FSK	Commun	LORA
@@ -281,6 +326,45 @@ const uint8_t FSK_STANDBY_MODE = 0x01;
 const uint8_t FSK_TX_MODE = 0x03;
 const uint8_t FSK_RX_MODE = 0x05;
 
+//POWER STATES:
+const uint8_t POWER_SLEEP = 0;
+const uint8_t POWER_STANDBY = 1;
+const uint8_t POWER_RX = 2;
+const uint8_t POWER_TX = 3;
+const uint8_t POWER_STATES = 4;
+
+// Typical currents (uA) and supply (mV) of the energy model, TX at +17 dBm
+const uint32_t CURRENT_SLEEP = 1;
+const uint32_t CURRENT_STANDBY = 1600;
+const uint32_t CURRENT_RX = 10800;
+const uint32_t CURRENT_TX = 87000;
+const uint32_t SUPPLY_VOLTAGE = 3300;
+
+// Crystal oscillator start up (us) and maximum wait for ModeReady (us)
+const uint16_t WAKE_LATENCY_OSC = 250;
+const uint16_t MAX_WAKE_LATENCY = 2000;
+
+// Low power listening: extra preamble symbols for the CAD, symbols listened
+// after a detection, time (ms) from the wake up until the reception is set
+// (wake, CAD start and 'receive' with the delays of 'writeRegister'), the
+// same on both ends since the sender sizes the preamble with it, and
+// maximum wait for CadDone (ms)
+const uint8_t LPL_PREAMBLE_MARGIN = 8;
+const uint8_t LPL_LISTEN_SYMBOLS = 32;
+const uint8_t LPL_WAKE_OVERHEAD = 25;
+const uint8_t LPL_CAD_TIMEOUT = 100;
+
+// TDMA beacon: [type][seq][slots][slot ms (2)][period ms (4)][stamp (4)][owners]
+const uint8_t TDMA_BEACON = 0xC0;
+const uint8_t TDMA_BEACON_HEADER = 13;
+const uint8_t TDMA_MAX_SLOTS = 64;
+const uint8_t TDMA_NO_SLOT = 0xFF;
+const uint16_t TDMA_GUARD = 20;
+const float TDMA_MAX_DRIFT = 0.01;
+// Worst case (ms) of the first 'prepareTx' of 'sendInSlot', before it has
+// been measured: wake up and about 15 register accesses with their delay
+const uint16_t TDMA_PREPARE_TIME = 20;
+
 //OTHER CONSTANTS:
 
 const uint8_t st_SD_ON = 1;
@@ -292,6 +376,7 @@ const uint8_t CRC_OFF = 0;
 const uint8_t LORA = 1;
 const uint8_t FSK = 0;
 const uint8_t BROADCAST_0 = 0x00;
+const uint8_t MULTICAST_FIRST = 0xE0;
 const uint8_t MAX_LENGTH = 255;
 const uint8_t MAX_PAYLOAD = 251;
 const uint8_t MAX_LENGTH_FSK = 64;
@@ -307,6 +392,242 @@ const uint32_t MESH_TIMEOUT = 3600000;  //3600000 msec = 3600 sec = 1 hour
 const uint8_t MAX_RETRIES = 5;
 const uint8_t CORRECT_PACKET = 0;
 const uint8_t INCORRECT_PACKET = 1;
+const uint8_t MAX_HOP_CHANNELS = 16;
+const uint8_t FSK_PRESET_4K8 = 0;
+const uint8_t FSK_PRESET_38K4 = 1;
+const uint8_t FSK_PRESET_100K = 2;
+const uint8_t FSK_PRESET_250K = 3;
+const uint8_t FSK_PRESET_300K = 4;
+const uint32_t MIN_BITRATE_FSK = 1200;
+const uint32_t MAX_BITRATE_FSK = 300000;
+const uint32_t MAX_FDEV_FSK = 200000;
+const uint32_t MAX_RX_BW_FSK = 250000;
+const uint8_t FSK_FIFO_SIZE = 64;
+const uint8_t FSK_FIFO_THRESHOLD = 32;
+const uint16_t MAX_LENGTH_FSK_STREAM = 2046;
+const uint8_t BULK_DATA = 0xB0;
+const uint8_t BULK_FLAG_ACKREQ = 0x01;
+const uint8_t BULK_FLAG_GBN = 0x02;
+const uint8_t BULK_TYPE_MASK = 0xFC;
+const uint8_t BULK_ACK = 0xB8;
+const uint8_t BULK_PARITY = 0xB4;
+const uint8_t BULK_FLAG_Q = 0x02;
+const uint8_t FEC_MAX_BLOCK = 32;
+const uint8_t BULK_HEADER = 2;
+const uint8_t BULK_ACK_HEADER = 3;
+const uint16_t MAX_BULK_FRAGMENTS = 256;
+const uint8_t ARQ_SELECTIVE_REPEAT = 0;
+const uint8_t ARQ_GO_BACK_N = 1;
+const uint8_t MAX_ARQ_WINDOW = 32;
+const uint8_t MAX_ARQ_RANGES = 8;
+const uint8_t ARQ_PEERS = 8;
+const uint16_t MIN_RTO = 100;
+#if defined(__AVR__)
+const uint8_t LINK_PEERS = 8;
+#else
+const uint8_t LINK_PEERS = 32;
+#endif
+const uint8_t LINK_RETRY_BINS = 4;
+const uint8_t LINK_SNR_BINS = 6;
+const uint8_t LINK_RSSI_BINS = 6;
+const uint8_t LINK_STATS_VERSION = 1;
+const uint8_t LINK_RECORD_SIZE = 47;
+const uint8_t COMPRESSION_NONE = 0;
+const uint8_t COMPRESSION_DELTA = 1;
+const uint8_t COMPRESSION_DICT = 2;
+const uint8_t COMPRESSION_CUSTOM = 3;
+const uint8_t SECURITY_NONE = 0;
+const uint8_t SECURITY_AES_CCM = 1;
+const uint8_t SECURITY_COUNTER = 3;
+const uint8_t SECURITY_TAG = 4;
+const uint8_t SECURITY_OVERHEAD = 7;
+const uint32_t MAX_SECURITY_COUNTER = 0xFFFFFF;
+const uint8_t SECURITY_PEERS = 8;
+const uint8_t CCM_NONCE_LENGTH = 13;
+const uint8_t CCM_FLAGS_MAC = 0x09;
+const uint8_t CCM_FLAGS_CTR = 0x01;
+const uint8_t FRAME_FORMAT_LEGACY = 0;
+const uint8_t FRAME_FORMAT_COMPACT = 1;
+const uint8_t FRAME_VERSION_MASK = 0xE0;
+const uint8_t FRAME_VERSION_COMPACT = 0xA0;
+const uint8_t FRAME_FLAG_ACK = 0x10;
+const uint8_t FRAME_FLAG_BROADCAST = 0x08;
+const uint8_t FRAME_RETRY_MASK = 0x07;
+
+//! Instrumented functions
+const uint8_t INSTR_SET_PACKET = 0;
+const uint8_t INSTR_SEND = 1;
+const uint8_t INSTR_AVAILABLE_DATA = 2;
+const uint8_t INSTR_GET_PACKET = 3;
+const uint8_t INSTR_GET_ACK = 4;
+const uint8_t INSTR_SET_ACK = 5;
+const uint8_t INSTR_OPS = 6;
+
+//! Structure : instrumentation counters.
+/*!
+	Filled by 'getInstrumentation' when SX1278_instrumentation is
+	enabled. Times are in us, 'calls', 'time' and 'maxTime' are indexed
+	by INSTR_SET_PACKET ... INSTR_SET_ACK.
+ */
+struct instrumentation
+{
+	//! Register read transactions, FIFO reads and bursts included
+	uint32_t regReads;
+	//! Register write transactions, FIFO writes and bursts included
+	uint32_t regWrites;
+	//! FIFO bytes read
+	uint32_t fifoReads;
+	//! FIFO bytes written
+	uint32_t fifoWrites;
+	//! Reads of the IRQ flags registers
+	uint32_t irqPolls;
+	//! Random padding (ms) added to the timeouts by 'setTimeout'
+	uint32_t timeoutPadding;
+	//! Time (ms) waited in 'setACK' before sending the ACK
+	uint32_t ackDelay;
+	//! Writes of REG_OP_MODE
+	uint32_t opModeWrites;
+	//! Mode changes skipped because the module was already in the mode
+	uint32_t opModeSkips;
+	//! Calls of each instrumented function
+	uint32_t calls[INSTR_OPS];
+	//! Total time of each instrumented function, 64 bits because 32 bits
+	//! of us wrap after 71 minutes
+	uint64_t time[INSTR_OPS];
+	//! Longest call of each instrumented function
+	uint32_t maxTime[INSTR_OPS];
+};
+
+//! Register writes queued between 'beginBatch' and 'flushBatch'
+const uint8_t BATCH_SIZE = 8;
+
+//! Read-back verification policies of the setters
+//! Every write is read back
+const uint8_t VERIFY_ALWAYS = 0;
+//! Only writes that change the last value set are read back
+const uint8_t VERIFY_ON_CHANGE = 1;
+//! Writes are not read back, 'auditRegisters' checks them
+const uint8_t VERIFY_AUDIT = 2;
+//! Registers kept in the shadow checked by 'auditRegisters'
+const uint8_t SHADOW_SIZE = 16;
+
+//! Trace events
+const uint8_t TRACE_WRITE = 1;
+const uint8_t TRACE_IRQ = 2;
+const uint8_t TRACE_CALL = 3;
+const uint8_t TRACE_LOST = 4;
+//! Records kept in the trace buffer
+const uint8_t TRACE_SIZE = 32;
+//! Start of each record sent by 'drainTrace'
+const uint8_t TRACE_SYNC = 0xA5;
+//! Bytes sent by 'drainTrace' per record: sync, time (LE32), event, reg, value
+const uint8_t TRACE_FRAME = 8;
+
+//! Structure : trace record.
+/*!
+	Written by 'trace' when SX1278_trace_mode is enabled.
+ */
+struct traceRecord
+{
+	//! Time of the event (us)
+	uint32_t time;
+	//! TRACE_WRITE, TRACE_IRQ, TRACE_CALL or TRACE_LOST
+	uint8_t event;
+	//! Register written or read, '0' for the other events
+	uint8_t reg;
+	//! Value of the register, the INSTR_* function for TRACE_CALL or
+	//! the records lost for TRACE_LOST
+	uint8_t value;
+};
+
+//! Function type : payload compressor or decompressor.
+/*!
+	It writes in 'out' (up to 'size' bytes) the transformation of the
+	'length' bytes of 'in' and returns the bytes written, '0' on error.
+ */
+typedef uint16_t (*compressHandler)(uint8_t *in, uint16_t length, uint8_t *out, uint16_t size);
+
+//! Structure : round trip time estimation of a peer.
+/*!
+ */
+struct rttEstimate
+{
+	//! Structure Variable : Peer address
+	/*!
+ 	*/
+	uint8_t addr;
+
+	//! Structure Variable : Smoothed round trip time (ms), '0' if no sample
+	/*!
+ 	*/
+	uint16_t srtt;
+
+	//! Structure Variable : Round trip time variation (ms)
+	/*!
+ 	*/
+	uint16_t rttvar;
+};
+
+//! Structure : link statistics of a peer.
+/*!
+ */
+struct linkStats
+{
+	//! Structure Variable : Peer address
+	/*!
+ 	*/
+	uint8_t addr;
+
+	//! Structure Variable : The entry holds a peer
+	/*!
+ 	*/
+	boolean used;
+
+	//! Structure Variable : Frames sent to the peer, ACKs included
+	/*!
+ 	*/
+	uint16_t sent;
+
+	//! Structure Variable : Frames correctly received from the peer
+	/*!
+ 	*/
+	uint16_t received;
+
+	//! Structure Variable : Tries acknowledged by the peer
+	/*!
+ 	*/
+	uint16_t acked;
+
+	//! Structure Variable : Tries not acknowledged by the peer
+	/*!
+ 	*/
+	uint16_t ackFailed;
+
+	//! Structure Variable : Frames not delivered after all the retries
+	/*!
+ 	*/
+	uint16_t dropped;
+
+	//! Structure Variable : Frames delivered after 0, 1, 2 and 3 or more retries
+	/*!
+ 	*/
+	uint16_t retries[LINK_RETRY_BINS];
+
+	//! Structure Variable : Time (ms) on air of the frames sent
+	/*!
+ 	*/
+	uint32_t airtime;
+
+	//! Structure Variable : SNR of the frames received: < -15, 5 dB bins, >= 5 dB
+	/*!
+ 	*/
+	uint16_t snr[LINK_SNR_BINS];
+
+	//! Structure Variable : RSSI of the frames received: < -120, 10 dB bins, >= -80 dBm
+	/*!
+ 	*/
+	uint16_t rssi[LINK_RSSI_BINS];
+};
 
 //! Structure :
 /*!
@@ -379,6 +700,105 @@ public:
 	 */
 	void OFF();
 
+	//! It sets the module in sleep mode.
+  	/*!
+  	The FIFO content is lost, registers are kept.
+	\return '0' on success, '1' otherwise
+	 */
+	int8_t setSleep();
+
+	//! It sets the module in standby mode.
+  	/*!
+	\return '0' on success, '1' otherwise
+	 */
+	int8_t setStandby();
+
+	//! It wakes the module up from sleep mode, accounting the latency.
+  	/*!
+	\return '0' on success, '1' otherwise
+	 */
+	int8_t wake();
+
+	//! It sets the module in sleep mode after each send and receive.
+  	/*!
+  	The module is woken up again when a packet is written in FIFO or
+  	a reception starts.
+	\param boolean enable : 'true' to sleep when idle.
+	 */
+	void setAutoSleep(boolean enable);
+
+	//! It sets the module in sleep mode if the automatic sleep is enabled.
+	void idle();
+
+	//! It accounts the time spent in the previous power state.
+  	/*!
+	\param uint8_t mode : value written in REG_OP_MODE.
+	 */
+	void updatePowerState(uint8_t mode);
+
+	//! It sets the operating mode, REG_OP_MODE is only written when the
+	//! module is not in the mode yet.
+  	/*!
+	\param uint8_t mode : value to write in REG_OP_MODE.
+	 */
+	void setOpMode(uint8_t mode);
+
+	//! It gets the time (ms) spent in a power state.
+  	/*!
+	\param uint8_t power : POWER_SLEEP, POWER_STANDBY, POWER_RX or POWER_TX.
+	\return time in milliseconds
+	 */
+	uint32_t getResidency(uint8_t power);
+
+	//! It gets the energy (mJ) used by the module, modelled with the
+	//! typical currents of the datasheet.
+	float getEnergy();
+
+	//! It resets the power state counters.
+	void resetPowerStats();
+
+	//! It prints the power state counters and the modelled energy.
+	void showPowerStats();
+
+#if (SX1278_instrumentation > 0)
+	//! It accounts a call of an instrumented function.
+  	/*!
+	\param uint8_t op : instrumented function.
+	\param uint32_t time : duration of the call in us.
+	 */
+	void instrumentCall(uint8_t op, uint32_t time);
+
+	//! It copies the instrumentation counters.
+  	/*!
+	\param instrumentation *counters : where the counters are copied.
+	 */
+	void getInstrumentation(instrumentation *counters);
+
+	//! It resets the instrumentation counters.
+	void resetInstrumentation();
+#endif
+
+#if (SX1278_trace_mode > 0)
+	//! It stores an event in the trace buffer.
+  	/*!
+	\param uint8_t event : TRACE_WRITE, TRACE_IRQ or TRACE_CALL.
+	\param uint8_t reg : register written or read.
+	\param uint8_t value : value of the register or function called.
+	 */
+	void trace(uint8_t event, uint8_t reg, uint8_t value);
+
+	//! It sends the oldest trace records through the serial port without
+	//! waiting for room in the serial transmit buffer.
+  	/*!
+	\param uint8_t max : maximum number of records to send.
+	\return the number of records sent.
+	 */
+	uint8_t drainTrace(uint8_t max);
+
+	//! It discards the trace records.
+	void resetTrace();
+#endif
+
 	//! It reads an internal module register.
   	/*!
   	\param byte address : address register to read from.
@@ -393,6 +813,78 @@ public:
 	 */
 	void writeRegister(byte address, byte data);
 
+	//! It reads consecutive module registers in one SPI transaction,
+	//! without the delay of 'readRegister'. The FIFO address is not
+	//! incremented, so 'length' FIFO bytes are read.
+  	/*!
+  	\param byte address : first register to read from.
+  	\param uint8_t *data : where the registers are stored.
+  	\param uint16_t length : number of registers to read.
+	 */
+	void readRegisters(byte address, uint8_t *data, uint16_t length);
+
+	//! It writes consecutive module registers in one SPI transaction,
+	//! without the delay of 'writeRegister'. The FIFO address is not
+	//! incremented, so 'length' FIFO bytes are written.
+  	/*!
+  	\param byte address : first register to write in.
+  	\param uint8_t *data : values to write.
+  	\param uint16_t length : number of registers to write.
+	 */
+	void writeRegisters(byte address, uint8_t *data, uint16_t length);
+
+	//! It starts queueing the register writes so contiguous registers
+	//! are written in bursts by 'flushBatch'. Reads of a queued register
+	//! return the queued value, and writes of the current operating mode
+	//! are skipped.
+	void beginBatch();
+
+	//! It writes the queued registers in bursts and reads them back in
+	//! bursts to check them, without ending the batch.
+	void writeBatch();
+
+	//! It writes the queued registers and ends the batch.
+  	/*!
+	\return '0' if every register written in the batch was read back
+	with its value, '1' otherwise
+	 */
+	int8_t flushBatch();
+
+	//! It sets when the setters read back the registers they write.
+  	/*!
+  	\param uint8_t policy : VERIFY_ALWAYS, VERIFY_ON_CHANGE or VERIFY_AUDIT.
+  	\param uint32_t period : time (ms) between the audits run when the
+  	module goes idle, '0' to only audit when 'auditRegisters' is called.
+	\return '0' on success, '-1' if the policy does not exist
+	 */
+	int8_t setVerifyPolicy(uint8_t policy, uint32_t period);
+
+	//! It records in the shadow the registers written by a setter and,
+	//! depending on the verification policy, reads them back.
+  	/*!
+  	\param byte address : first register written.
+  	\param uint8_t *data : values written.
+  	\param uint8_t length : number of consecutive registers written.
+	\return 'true' if the registers hold the values or were not read back
+	 */
+	boolean checkRegisters(byte address, uint8_t *data, uint8_t length);
+
+	//! It reads the registers of the shadow and writes again the ones
+	//! that have been corrupted, by a brown-out for instance.
+  	/*!
+  	If the module has lost its modem or its mode, it has been reset, so
+  	the modem is set again before the shadow is written back.
+	\return the number of corrupted registers.
+	 */
+	uint8_t auditRegisters();
+
+	//! It keeps the shadow up to date when a register of it is written.
+  	/*!
+  	\param byte address : register written.
+  	\param byte data : value written.
+	 */
+	void shadowWrite(byte address, byte data);
+
 	//! It clears the interruption flags.
   	/*!
 	\param void
@@ -402,7 +894,9 @@ public:
 
 	//! It sets the LoRa mode on.
   	/*!
-  	It stores in global '_LORA' variable '1' when success
+  	It stores in global '_LORA' variable '1' when success. The
+  	modulation is only set to its defaults when the module was in FSK
+  	mode, so it is kept through 'OFF' and 'ON'.
     \return '0' on success, '1' otherwise
 	 */
 	uint8_t setLORA();
@@ -414,6 +908,38 @@ public:
 	 */
 	uint8_t setFSK();
 
+	//! It sets the FSK bit rate.
+  	/*!
+  	It stores in global '_bitRate' variable the bit rate when success.
+	\param uint32_t bitrate : bit rate in bps, from 1200 to 300000.
+	\return '0' on success, '1' otherwise
+	 */
+	int8_t setFSKBitrate(uint32_t bitrate);
+
+	//! It sets the FSK frequency deviation.
+  	/*!
+  	The deviation plus half the bit rate must not exceed 250 kHz.
+	\param uint32_t fdev : frequency deviation in Hz, up to 200000.
+	\return '0' on success, '1' otherwise
+	 */
+	int8_t setFSKDeviation(uint32_t fdev);
+
+	//! It sets the FSK receiver bandwidth.
+  	/*!
+  	The narrowest bandwidth wider than or equal to 'bw' is set for the
+  	receiver and the AFC.
+	\param uint32_t bw : single side bandwidth in Hz, up to 250000.
+	\return '0' on success, '1' otherwise
+	 */
+	int8_t setFSKRxBandwidth(uint32_t bw);
+
+	//! It sets bit rate, deviation and receiver bandwidth from a preset.
+  	/*!
+	\param uint8_t preset : FSK_PRESET_4K8 up to FSK_PRESET_300K.
+	\return '0' on success, '1' otherwise
+	 */
+	int8_t setFSKPreset(uint8_t preset);
+
 	//! It gets the BW, SF and CR of the module.
   	/*!
 	It stores in global '_bandwidth' variable the BW
@@ -457,6 +983,44 @@ public:
 	 */
 	int8_t	setHeaderOFF();
 
+	//! It sets a fixed packet length with implicit header.
+  	/*!
+  	Frames carry only 'length' bytes of payload, without header nor
+  	addressing bytes, so every frame is received as addressed to this
+  	node. Both ends must use the same length, and ACKs and the
+  	encryption are not available. '0' returns to explicit header mode.
+	\param uint8_t length : fixed payload length (0 to disable).
+	\return '0' on success, '1' otherwise, '-1' if the encryption is
+	enabled
+	 */
+	int8_t	setFixedLength(uint8_t length);
+
+	//! It sets the software frame format.
+  	/*!
+  	FRAME_FORMAT_LEGACY sends dst|src|packnum|length|payload|retry.
+  	FRAME_FORMAT_COMPACT sends format|dst|src|packnum|payload, where
+  	the format byte carries the version, the retry number and the
+  	ACK and broadcast flags, 'dst' is omitted for broadcast and the
+  	length is taken from the LoRa header. Both ends must use the same
+  	format. LoRa mode only.
+	\param uint8_t format : FRAME_FORMAT_LEGACY or FRAME_FORMAT_COMPACT.
+	\return '0' on success, '1' otherwise
+	 */
+	int8_t	setFrameFormat(uint8_t format);
+
+	//! It gets the number of framing bytes added to the payload.
+  	/*!
+	\param uint8_t dest : destination of the frame.
+	\return number of bytes of the software header
+	 */
+	uint8_t	frameOverhead(uint8_t dest);
+
+	//! It gets the bytes added to the payload by compression and security.
+  	/*!
+	\return number of bytes added to the payload
+	 */
+	uint8_t	payloadOverhead();
+
 	//! It gets the CRC configured.
   	/*!
   	It stores in global '_CRC' variable '1' enabling CRC generation on
@@ -572,6 +1136,31 @@ public:
 	 */
 	int8_t setChannel(uint32_t ch);
 
+	//! It sets the intra-packet frequency hopping (FHSS) in LoRa mode.
+  	/*!
+	It stores in global '_hopChannels' variable the list of channels and in
+	global '_hopPeriod' variable the number of symbols between hops.
+	\param const uint32_t *channels : frequency channels to hop across.
+	\param uint8_t number : number of channels in the list.
+	\param uint8_t period : symbol periods between frequency hops.
+	\return '0' on success, '1' otherwise, '-1' in FSK mode or if the
+	channels or the period are invalid
+	 */
+	int8_t setFHSS(const uint32_t *channels, uint8_t number, uint8_t period);
+
+	//! It disables the intra-packet frequency hopping.
+  	/*!
+	\return '0' on success, '1' otherwise, '-1' in FSK mode
+	 */
+	int8_t setFHSS_OFF();
+
+	//! It services the FhssChangeChannel interruption moving the module to
+	//! the next channel of the hopping list.
+  	/*!
+	\return void
+	 */
+	void hopChannel();
+
 	//! It gets the output power of the signal.
   	/*!
 	It stores in global '_power' variable the output power of the signal
@@ -645,12 +1234,47 @@ public:
 
 	//! It sets the node address of the mote.
   	/*!
-  	It stores in global '_nodeAddress' variable the node address
+  	It stores in global '_nodeAddress' variable the node address.
+  	Addresses from MULTICAST_FIRST (0xE0) to 255 are reserved for
+  	groups and can not be used as node address.
   	\param uint8_t addr : address value to set as node address.
-	\return '0' on success, '1' otherwise
+	\return '0' on success, '1' otherwise, '-1' if the address is
+	reserved for groups
 	 */
 	int8_t setNodeAddress(uint8_t addr);
 
+	//! It joins a multicast group.
+  	/*!
+  	Addresses from MULTICAST_FIRST to 255 are group addresses. Frames
+  	sent to a group the node belongs to are received like broadcast
+  	ones: they are not acknowledged, so one frame reaches every member.
+	\param uint8_t group : group address.
+	\return '0' on success, '1' otherwise
+	 */
+	int8_t addGroup(uint8_t group);
+
+	//! It leaves a multicast group.
+  	/*!
+	\param uint8_t group : group address.
+	\return '0' on success, '1' otherwise
+	 */
+	int8_t removeGroup(uint8_t group);
+
+	//! It indicates if 'addr' is a group address.
+	boolean isGroupAddress(uint8_t addr);
+
+	//! It indicates if frames to 'dest' are not acknowledged (broadcast or group).
+	boolean isMulticast(uint8_t dest);
+
+	//! It indicates if a frame to 'dest' is for this node.
+	boolean isForMe(uint8_t dest);
+
+	//! It sets the FSK address filtering with the node address and the groups.
+  	/*!
+	\return '0' on success, '1' otherwise
+	 */
+	int8_t setAddressFilter();
+
 	//! It gets the SNR of the latest received packet.
   	/*!
 	It stores in global '_SNR' variable the SNR
@@ -740,6 +1364,9 @@ public:
 	 */
 	uint8_t receive();
 
+	//! It drops the frame being received and listens again.
+	void restartRx();
+
 	//! It receives a packet before MAX_TIMEOUT.
   	/*!
   	 *
@@ -796,6 +1423,52 @@ public:
 	 */
 	uint8_t receiveAll(uint32_t wait);
 
+	//! It starts a continuous reception session. The module is configured
+	//! once and stays in Rx mode across packets.
+  	/*!
+	It stores in global '_rxContinuous' variable 'true' when success
+	\return '0' on success, '1' otherwise
+	 */
+	int8_t startRxContinuous();
+
+	//! It gets the next packet of the continuous reception session before a
+	//! timeout, without leaving Rx mode.
+  	/*!
+  	\param uint32_t wait : time to wait to receive something.
+	\return '0' on success, '1' otherwise
+	 */
+	int8_t receivePacketContinuous(uint32_t wait);
+
+	//! It stops the continuous reception session.
+  	/*!
+	\return '0' on success, '1' otherwise
+	 */
+	int8_t stopRxContinuous();
+
+	//! It sends a long FSK frame refilling the FIFO while it is being sent.
+  	/*!
+  	The frame is 'dest' followed by 'length' bytes of 'data' in fixed
+  	length mode, so the receiver must expect the same length. The FIFO
+  	is refilled each time FifoLevel falls under FSK_FIFO_THRESHOLD.
+	\param uint8_t dest : packet destination.
+	\param uint8_t *data : data to send.
+	\param uint16_t length : data length, up to MAX_LENGTH_FSK_STREAM.
+	\param uint32_t wait : time to wait to send the frame.
+	\return '0' on success, '1' otherwise, '3' if the FIFO ran empty
+	 */
+	int8_t sendFSKStream(uint8_t dest, uint8_t *data, uint16_t length, uint32_t wait);
+
+	//! It receives a long FSK frame draining the FIFO while it is received.
+  	/*!
+  	The FIFO is drained each time FifoLevel rises over FSK_FIFO_THRESHOLD.
+  	The destination of the frame is stored in '_destination'.
+	\param uint8_t *data : buffer to store the received data.
+	\param uint16_t length : expected data length, up to MAX_LENGTH_FSK_STREAM.
+	\param uint32_t wait : time to wait to receive the frame.
+	\return '0' on success, '1' otherwise, '3' if the FIFO overran or CRC error
+	 */
+	int8_t receiveFSKStream(uint8_t *data, uint16_t length, uint32_t wait);
+
 	//! It checks if there is an available packet and its destination.
   	/*!
   	 *
@@ -807,12 +1480,23 @@ public:
 	//! timeout.
   	/*!
   	 *
+  	Frames for other nodes are dropped right after their header and
+  	the reception goes on for the rest of 'wait'.
   	\param uint32_t wait : time to wait while there is no a valid header 
   	received.
 	\return 'true' on success, 'false' otherwise
 	 */
 	boolean	availableData(uint32_t wait);
 
+	//! It waits for a header and checks its destination.
+  	/*!
+  	\param uint32_t wait : time to wait while there is no a valid header 
+  	received.
+	\return '2' if a frame for another node has been dropped, '1' if
+	the packet is for the module, '0' otherwise
+	 */
+	uint8_t receiveHeader(uint32_t wait);
+
 	//! It writes a packet in FIFO in order to send it.
 	/*!
 	\param uint8_t dest : packet destination.
@@ -855,6 +1539,27 @@ public:
 	*/
 	int8_t getPacket(uint32_t wait);
 
+	//! It reads the rest of a received packet from the current FIFO address
+	//! pointer, once the destination has been stored.
+	/*!
+	 *
+	\return '0' on success, '1' otherwise
+	*/
+	int8_t readPacket();
+
+	//! It writes the packet stored in 'packet_sent' in FIFO.
+  	/*!
+	\return '0' on success, '1' otherwise
+	 */
+	uint8_t writePacket();
+
+	//! It reads the destination at the beginning of the received frame.
+  	/*!
+  	In compact format it also stores the format byte in '_rxFormat'.
+	\return the destination of the received frame
+	 */
+	uint8_t readDestination();
+
 	//! It sends the packet stored in FIFO before ending MAX_TIMEOUT.
 	/*!
 	 *
@@ -876,6 +1581,35 @@ public:
 	*/
 	uint8_t sendWithTimeout(uint32_t wait);
 
+	//! It loads a packet in FIFO ahead of time and leaves the module in
+	//! standby, ready to transmit it with 'fireTx'.
+	/*!
+	\param uint8_t dest : packet destination.
+	\param uint8_t *payload : packet payload.
+	\param uint16_t length : payload buffer length.
+	\return '0' on success, '1' otherwise
+	*/
+	uint8_t prepareTx(uint8_t dest, uint8_t *payload, uint16_t length);
+
+	//! It clears the flags and selects the first hopping channel before a
+	//! transmission.
+	void armTx();
+
+	//! It starts the transmission of the prepared packet with a single
+	//! write of REG_OP_MODE. The duration of the call is kept in
+	//! '_fireLatency'.
+	/*!
+	\return '0' on success, '1' if no packet has been prepared
+	*/
+	int8_t fireTx();
+
+	//! It waits for the end of the transmission started by 'fireTx'.
+	/*!
+	\param uint32_t wait : time to wait since the transmission started.
+	\return '0' on success, '1' otherwise
+	*/
+	uint8_t waitTxDone(uint32_t wait);
+
 	//! It tries to send the packet which payload is a parameter before ending 
 	//! MAX_TIMEOUT.
 	/*!
@@ -960,8 +1694,9 @@ public:
 			'4'  --> The ACK length incorrectly received
 			'3'  --> N-ACK received
 			'2'  --> The ACK has not been received
-			'1'  --> not used (reserved)
-			'0'  --> The ACK has been received with no errors
+			'1'  --> ACKs are not available with a fixed length
+			'0'  --> The ACK has been received with no errors, or the packet
+					has been sent to a group or broadcast (no ACK)
 	*/
 	uint8_t sendPacketMAXTimeoutACK(uint8_t dest, 
 									char *payload);
@@ -980,8 +1715,9 @@ public:
 			'4'  --> The ACK length incorrectly received
 			'3'  --> N-ACK received
 			'2'  --> The ACK has not been received
-			'1'  --> not used (reserved)
-			'0'  --> The ACK has been received with no errors
+			'1'  --> ACKs are not available with a fixed length
+			'0'  --> The ACK has been received with no errors, or the packet
+					has been sent to a group or broadcast (no ACK)
 	*/
 	uint8_t sendPacketMAXTimeoutACK(uint8_t dest, 
 									uint8_t *payload, 
@@ -1000,8 +1736,9 @@ public:
 			'4'  --> The ACK length incorrectly received
 			'3'  --> N-ACK received
 			'2'  --> The ACK has not been received
-			'1'  --> not used (reserved)
-			'0'  --> The ACK has been received with no errors
+			'1'  --> ACKs are not available with a fixed length
+			'0'  --> The ACK has been received with no errors, or the packet
+					has been sent to a group or broadcast (no ACK)
 	*/
 	uint8_t sendPacketTimeoutACK(	uint8_t dest, 
 									char *payload);
@@ -1020,8 +1757,9 @@ public:
 			'4'  --> The ACK length incorrectly received
 			'3'  --> N-ACK received
 			'2'  --> The ACK has not been received
-			'1'  --> not used (reserved)
-			'0'  --> The ACK has been received with no errors
+			'1'  --> ACKs are not available with a fixed length
+			'0'  --> The ACK has been received with no errors, or the packet
+					has been sent to a group or broadcast (no ACK)
 	*/
 	uint8_t sendPacketTimeoutACK(	uint8_t dest, 
 									uint8_t *payload, 
@@ -1041,8 +1779,9 @@ public:
 			'4'  --> The ACK length incorrectly received
 			'3'  --> N-ACK received
 			'2'  --> The ACK has not been received
-			'1'  --> not used (reserved)
-			'0'  --> The ACK has been received with no errors
+			'1'  --> ACKs are not available with a fixed length
+			'0'  --> The ACK has been received with no errors, or the packet
+					has been sent to a group or broadcast (no ACK)
 	*/
 	uint8_t sendPacketTimeoutACK(	uint8_t dest, 
 									char *payload,
@@ -1063,8 +1802,9 @@ public:
 			'4'  --> The ACK length incorrectly received
 			'3'  --> N-ACK received
 			'2'  --> The ACK has not been received
-			'1'  --> not used (reserved)
-			'0'  --> The ACK has been received with no errors
+			'1'  --> ACKs are not available with a fixed length
+			'0'  --> The ACK has been received with no errors, or the packet
+					has been sent to a group or broadcast (no ACK)
 	*/
 	uint8_t sendPacketTimeoutACK(uint8_t dest, 
 									uint8_t *payload, 
@@ -1093,6 +1833,19 @@ public:
 	float timeOnAir();
 	float timeOnAir( uint16_t payloadlength );
 
+	//! It gets the theoretical value of the time-on-air of a FSK packet
+  	/*!
+  	Preamble, sync word, payload and CRC are sent at '_bitRate'.
+	\return float: time on air in ms
+	 */
+	float timeOnAirFSK( uint16_t payloadlength );
+
+	//! It gets the duration of a LoRa symbol.
+  	/*!
+	\return float: symbol time in ms
+	 */
+	float symbolTime();
+
 	//! It sets the payload of the packet that is going to be sent.
   	/*!
   	\param char *payload : packet payload.
@@ -1107,6 +1860,112 @@ public:
 	 */
 	uint8_t setPayload(uint8_t *payload);
 
+	//! It sets the compression of the payloads sent and received.
+  	/*!
+  	Payloads are sent with a first byte telling the codec used, so
+  	a payload that does not compress is sent as is. Both ends must
+  	enable compression. Not used in fixed length mode.
+	\param uint8_t mode : COMPRESSION_NONE, COMPRESSION_DELTA (int16
+	values as zigzag varint deltas), COMPRESSION_DICT (static text
+	dictionary) or COMPRESSION_CUSTOM.
+	\return '0' on success, '1' otherwise (always '1' for a mode other
+	than COMPRESSION_NONE when SX1278_compression_mode is 0)
+	 */
+	int8_t setCompression(uint8_t mode);
+
+	//! It sets the handlers used with COMPRESSION_CUSTOM.
+  	/*!
+	\param compressHandler encode : payload compressor.
+	\param compressHandler decode : payload decompressor.
+	 */
+	void setCompressionHandler(compressHandler encode, compressHandler decode);
+
+	//! It compresses the payload stored in 'packet_sent'.
+  	/*!
+	\return '0' on success, '1' if the payload has been truncated
+	 */
+	uint8_t compressPayload();
+
+	//! It decompresses the payload stored in 'packet_received'.
+  	/*!
+	\return '0' on success, '1' otherwise
+	 */
+	uint8_t decompressPayload();
+
+#if (SX1278_compression_mode > 0)
+	//! It encodes int16 values as zigzag varint deltas.
+	uint16_t deltaEncode(uint8_t *in, uint16_t length, uint8_t *out, uint16_t size);
+
+	//! It decodes zigzag varint deltas to int16 values.
+	uint16_t deltaDecode(uint8_t *in, uint16_t length, uint8_t *out, uint16_t size);
+
+	//! It replaces the words of the static dictionary by one byte.
+	uint16_t dictEncode(uint8_t *in, uint16_t length, uint8_t *out, uint16_t size);
+
+	//! It expands the words of the static dictionary.
+	uint16_t dictDecode(uint8_t *in, uint16_t length, uint8_t *out, uint16_t size);
+#endif
+
+	//! It enables the authenticated encryption of the payloads.
+  	/*!
+  	Payloads are encrypted with AES-128-CCM after the compression. A
+  	24 bits frame counter and a 4 bytes tag are appended, so each
+  	frame is SECURITY_OVERHEAD bytes longer. The nonce is made of the
+  	source, the destination, the packet number and the frame counter,
+  	so the header is authenticated too. Frames whose counter is not
+  	greater than the last one received from the same source are
+  	rejected as replays. The counters of the last SECURITY_PEERS
+  	sources heard are kept, a source forgotten can be replayed.
+	\param const uint8_t *key : 16 bytes key, NULL to disable it.
+	\return '0' on success, '1' otherwise, '-1' in fixed length mode
+	 */
+	int8_t setSecurity(const uint8_t *key);
+
+	//! It sets the next frame counter.
+  	/*!
+  	The counter must never be reused with the same key, so it should
+  	be restored after a reset.
+	\param uint32_t counter : next frame counter.
+	 */
+	void setSecurityCounter(uint32_t counter);
+
+	//! It encrypts a block with AES-128.
+	void aesEncrypt(uint8_t *block);
+
+	//! It multiplies by x in GF(2^8) with the AES polynomial.
+	uint8_t aesXtime(uint8_t a);
+
+	//! It builds a CCM block from the nonce.
+	void ccmBlock(uint8_t *block, uint8_t flags, uint8_t *nonce, uint16_t value);
+
+	//! It computes the CCM tag of a message.
+	void ccmMAC(uint8_t *data, uint16_t length, uint8_t *nonce, uint8_t *tag);
+
+	//! It encrypts or decrypts a CCM message and its tag.
+	void ccmCTR(uint8_t *data, uint16_t length, uint8_t *nonce, uint8_t *tag);
+
+	//! It builds the nonce of a frame.
+	void ccmNonce(uint8_t *nonce, uint8_t src, uint8_t dst, uint8_t packnum, uint32_t counter);
+
+	//! It encrypts the payload stored in 'packet_sent'.
+  	/*!
+	\return '0' on success, '1' if it has been truncated or not sent
+	 */
+	uint8_t encryptPayload();
+
+	//! It encrypts again the payload stored in 'packet_sent' with a new
+	//! frame counter, so that a retry is not taken for a replay.
+  	/*!
+	\return '0' on success, '1' if the counter is exhausted
+	 */
+	uint8_t renewPayload();
+
+	//! It checks and decrypts the payload stored in 'packet_received'.
+  	/*!
+	\return '0' on success, '1' if it is not authentic
+	 */
+	uint8_t decryptPayload();
+
 	//! If an ACK is received, it gets it and checks its content.
 	/*!
 	 *
@@ -1117,7 +1976,7 @@ public:
 			'4'  --> The ACK length incorrectly received
 			'3'  --> N-ACK received
 			'2'  --> The ACK has not been received
-			'1'  --> not used (reserved)
+			'1'  --> ACKs are not available with a fixed length
 			'0'  --> The ACK has been received with no errors
 	*/
 	uint8_t getACK();
@@ -1134,7 +1993,7 @@ public:
 			'4'  --> The ACK length incorrectly received
 			'3'  --> N-ACK received
 			'2'  --> The ACK has not been received
-			'1'  --> not used (reserved)
+			'1'  --> ACKs are not available with a fixed length
 			'0'  --> The ACK has been received with no errors
 	*/
 	uint8_t getACK(uint32_t wait);
@@ -1207,6 +2066,162 @@ public:
 										uint16_t length, 
 										uint32_t wait);
 
+	//! It sets the sliding window used by 'sendBulk'.
+	/*!
+	\param uint8_t window : frames sent before waiting an ACK, from 1
+	(stop-and-wait) to MAX_ARQ_WINDOW.
+	\param uint8_t mode : ARQ_SELECTIVE_REPEAT or ARQ_GO_BACK_N.
+	\return '0' on success, '1' otherwise
+	*/
+	int8_t setARQWindow(uint8_t window, uint8_t mode);
+
+	//! It updates the round trip time estimation of a peer.
+	/*!
+	\param uint8_t addr : peer address.
+	\param uint16_t sample : round trip time measured (ms).
+	*/
+	void updateRTT(uint8_t addr, uint16_t sample);
+
+	//! It gets the ACK timeout for a peer from its round trip time.
+	/*!
+	\param uint8_t addr : peer address.
+	\param uint32_t wait : timeout to use if there is no estimation.
+	\return timeout (ms)
+	*/
+	uint32_t getRTO(uint8_t addr, uint32_t wait);
+
+#if (SX1278_link_stats > 0)
+	//! It gets the statistics entry of a peer, NULL if the table is full.
+	linkStats* linkEntry(uint8_t addr);
+
+	//! It increments a statistics counter, saturating at its maximum.
+	void linkCount(uint16_t *counter);
+
+	//! It accounts a frame sent to a peer.
+	void linkSent(uint8_t addr, uint32_t airtime);
+
+	//! It accounts an acknowledged transmission to a peer.
+	void linkACK(uint8_t addr, uint8_t state);
+
+	//! It accounts the retries used to deliver a frame to a peer.
+	void linkRetries(uint8_t addr, uint8_t state, uint8_t tries);
+
+	//! It accounts the frame stored in 'packet_received'.
+	void linkReceived();
+
+	//! It gets the link statistics of a peer.
+	/*!
+	Statistics are kept for the first LINK_PEERS peers. The events of
+	other peers are counted in '_linkOverflow', the counters saturate.
+	\param uint8_t addr : peer address.
+	\return pointer to the statistics, NULL if there are none
+	*/
+	linkStats* getLinkStats(uint8_t addr);
+
+	//! It resets the link statistics.
+	void resetLinkStats();
+
+	//! It writes the link statistics as a binary record.
+	/*!
+	The record is [LINK_STATS_VERSION][peers] followed, for each peer,
+	by LINK_RECORD_SIZE bytes with the fields of 'linkStats' from 'addr'
+	to 'rssi' ('used' excluded) in little endian.
+	\param uint8_t *buffer : where the record is written.
+	\param uint16_t size : buffer size.
+	\return bytes written, '0' if the buffer is too small
+	*/
+	uint16_t dumpLinkStats(uint8_t *buffer, uint16_t size);
+
+	//! It writes a 16 bits value in little endian.
+	uint16_t putWord(uint8_t *buffer, uint16_t n, uint16_t value);
+#endif
+
+#if (SX1278_fec_mode > 0)
+	//! It sets the parity frames sent with each block of bulk fragments.
+	/*!
+	After the fragments of each block, a P (XOR) frame and a Q (Reed-Solomon
+	over GF(256)) frame are sent, so the receiver rebuilds up to 'parity'
+	lost fragments of the block without asking them again.
+	\param uint8_t parity : parity frames per block, 0 (disabled), 1 or 2.
+	\param uint8_t block : fragments per block, from 2 to FEC_MAX_BLOCK.
+	\return '0' on success, '1' otherwise
+	*/
+	int8_t setFEC(uint8_t parity, uint8_t block);
+
+	//! It multiplies two elements of GF(256).
+	uint8_t gfMul(uint8_t a, uint8_t b);
+
+	//! It gets the power 'n' of the GF(256) generator.
+	uint8_t gfPow(uint8_t n);
+
+	//! It gets the inverse of an element of GF(256).
+	uint8_t gfInv(uint8_t a);
+
+	//! It rebuilds the lost fragments of a block from its parity frames.
+	/*!
+	\param uint8_t *data : bulk buffer.
+	\param uint16_t size : bulk buffer size.
+	\param uint8_t *got : bitmap of the fragments received.
+	\param uint16_t nfrag : number of fragments of the transfer.
+	\param uint8_t frag : fragment size.
+	\param uint8_t lastLen : length of the last fragment.
+	\param uint16_t block : block to rebuild.
+	\param uint8_t *p : P parity of the block, NULL if not received.
+	\param uint8_t *q : Q parity of the block, NULL if not received.
+	\return number of fragments rebuilt
+	*/
+	uint8_t fecRecover(uint8_t *data, uint16_t size, uint8_t *got, uint16_t nfrag,
+						uint8_t frag, uint8_t lastLen, uint16_t block, uint8_t *p, uint8_t *q);
+
+	//! It sends the P and Q parity frames of a block of bulk fragments.
+	/*!
+	\param uint8_t dest : destination of the transfer.
+	\param uint8_t *data : data of the transfer.
+	\param uint16_t length : data length.
+	\param uint8_t frag : fragment size.
+	\param uint16_t block : block of the parity.
+	\param uint32_t wait : time to wait to send each frame.
+	\return '0' on success, '1' otherwise
+	*/
+	int8_t fecSend(uint8_t dest, uint8_t *data, uint16_t length, uint8_t frag,
+					uint16_t block, uint32_t wait);
+#endif
+
+	//! It sends a buffer larger than a packet to 'dest'.
+	/*!
+	The buffer is split in up to MAX_BULK_FRAGMENTS fragments whose index
+	is the packet number. Fragments are sent in windows of '_arqWindow'
+	frames and the last frame of each window asks for a cumulative ACK
+	with the ranges received after the first missing fragment, so with
+	selective repeat only the missing fragments are sent again. A transfer
+	to BROADCAST_0 or to a group is sent once without ACKs.
+	\param uint8_t dest : packet destination.
+	\param uint8_t *data : data to send.
+	\param uint16_t length : data length.
+	\param uint32_t wait : time to wait to send each frame, and each ACK
+	until the round trip time to 'dest' is known.
+	\return '0' on success, '1' otherwise
+	*/
+	int8_t sendBulk(uint8_t dest, uint8_t *data, uint16_t length, uint32_t wait);
+
+	//! It gets the data bytes of each bulk fragment sent to 'dest'.
+	/*!
+	\param uint8_t dest : destination of the transfer.
+	\return the fragment size, so that the frame with its framing,
+	codec and security bytes fits in the 8 bit length.
+	*/
+	uint8_t bulkFragment(uint8_t dest);
+
+	//! It receives a buffer sent with 'sendBulk'.
+	/*!
+	It stores in global '_bulkLength' variable the length received.
+	\param uint8_t *data : buffer to store the received data.
+	\param uint16_t size : buffer size.
+	\param uint32_t wait : time to wait for each frame.
+	\return '0' on success, '1' otherwise
+	*/
+	int8_t receiveBulk(uint8_t *data, uint16_t size, uint32_t wait);
+
 	//! It gets the internal temperature of the module.
 	/*!
 	It stores in global '_temp' variable the module temperature.
@@ -1228,6 +2243,65 @@ public:
 	*/
 	bool cadDetected();
 
+	//! It runs a CAD for the low power listening, without the RSSI read.
+  	/*!
+	\return 'true' on cad detected, 'false' if not detected
+	 */
+	boolean lplDetected();
+
+	//! It sets the interval between samples of the low power listening.
+  	/*!
+  	The preamble is lengthened to cover the interval and the time the
+  	receiver needs to wake up and set the reception (LPL_WAKE_OVERHEAD),
+  	so both ends must set it, after setting SF and BW.
+	\param uint16_t interval : sleep time (ms) between samples, '0' to
+	get back to the default preamble.
+	\return '0' on success, '1' otherwise
+	 */
+	int8_t setWakeInterval(uint16_t interval);
+
+	//! It receives a packet with low power listening.
+  	/*!
+  	The module sleeps and wakes every '_wakeInterval' ms to run a CAD.
+  	It only listens when a preamble is detected.
+	\param uint32_t wait : time to wait for a packet.
+	\return '0' on success, '1' otherwise
+	 */
+	int8_t receiveLowPower(uint32_t wait);
+
+	//! It broadcasts a TDMA beacon with the slot map.
+  	/*!
+  	Slot 'i' belongs to 'owners[i]' and starts TDMA_GUARD + i * slot ms
+  	after the end of the beacon, the slot being the airtime of a
+  	'length' bytes payload plus TDMA_GUARD. The beacon carries a time
+  	stamp so the nodes can correct their clock drift.
+	\param uint8_t *owners : node address of each slot.
+	\param uint8_t nslots : number of slots, up to TDMA_MAX_SLOTS.
+	\param uint16_t length : largest payload sent in a slot.
+	\param uint32_t period : time (ms) until the next beacon.
+	\return '0' on success, '1' otherwise
+	 */
+	int8_t sendBeacon(uint8_t *owners, uint8_t nslots, uint16_t length, uint32_t period);
+
+	//! It waits for a TDMA beacon and synchronizes with it.
+  	/*!
+  	When synchronized the module sleeps until a guard time before the
+  	expected beacon.
+	\param uint32_t wait : time to wait for the beacon.
+	\return '0' on success, '1' otherwise
+	 */
+	int8_t waitBeacon(uint32_t wait);
+
+	//! It sends a packet in the slot of the node, sleeping until it starts.
+  	/*!
+	\param uint8_t dest : packet destination.
+	\param uint8_t *payload : packet payload.
+	\param uint16_t length : payload length.
+	\return '0' on success, '1' on error, '-1' if there is no slot or
+	the packet does not fit in it
+	 */
+	int8_t sendInSlot(uint8_t dest, uint8_t *payload, uint16_t length);
+
 	/// Variables /////////////////////////////////////////////////////////////
 
 	//! Variable : SD state.
@@ -1252,6 +2326,18 @@ public:
    	*/
 	uint8_t _bandwidth;
 
+	//! Variable : bit rate configured in FSK mode (bps).
+	//!
+  	/*!
+   	*/
+	uint32_t _bitRate;
+
+	//! Variable : frequency deviation configured in FSK mode (Hz).
+	//!
+  	/*!
+   	*/
+	uint32_t _deviation;
+
 	//! Variable : coding rate configured in LoRa mode.
 	//!    codingRate = 001  --> CR = 4/5
 	//!    codingRate = 010  --> CR = 4/6
@@ -1302,6 +2388,24 @@ public:
    	*/
 	uint32_t _channel;
 
+	//! Variable : frequency channels used in FHSS mode.
+	//!
+  	/*!
+   	*/
+	uint32_t _hopChannels[MAX_HOP_CHANNELS];
+
+	//! Variable : number of frequency channels used in FHSS mode.
+	//!
+  	/*!
+   	*/
+	uint8_t _hopChannelsNb;
+
+	//! Variable : symbol periods between frequency hops (0 = FHSS disabled).
+	//!
+  	/*!
+   	*/
+	uint8_t _hopPeriod;
+
 	//! Variable : output power.
 	//!
   	/*!
@@ -1332,6 +2436,228 @@ public:
    	*/
 	uint16_t _preamblelength;
 
+	//! Variable : sleep time (ms) between samples of the low power listening.
+	//!
+  	/*!
+   	*/
+	uint16_t _wakeInterval;
+
+	//! Variable : time (millis) of the last RxDone.
+	//!
+  	/*!
+   	*/
+	unsigned long _rxDoneTime;
+
+	//! Variable : time (millis) of the last TxDone.
+	//!
+  	/*!
+   	*/
+	unsigned long _txDoneTime;
+
+	//! Variable : a packet is ready to be transmitted by 'fireTx'.
+	//!
+  	/*!
+   	*/
+	boolean _txArmed;
+
+	//! Variable : time (millis) of the last 'fireTx'.
+	//!
+  	/*!
+   	*/
+	unsigned long _txStart;
+
+	//! Variable : duration (us) of the last 'fireTx', from the call to the
+	//! write of the Tx mode.
+	//!
+  	/*!
+   	*/
+	uint32_t _fireLatency;
+
+	//! Variable : duration (ms) of the last 'prepareTx' of 'sendInSlot',
+	//! TDMA_PREPARE_TIME before the first one.
+	//!
+  	/*!
+   	*/
+	unsigned long _prepareTime;
+
+	//! Variable : sequence number of the next beacon sent.
+	//!
+  	/*!
+   	*/
+	uint8_t _beaconSeq;
+
+	//! Variable : number of slots of the TDMA frame.
+	//!
+  	/*!
+   	*/
+	uint8_t _tdmaSlots;
+
+	//! Variable : slot of the node, TDMA_NO_SLOT if it has none.
+	//!
+  	/*!
+   	*/
+	uint8_t _tdmaIndex;
+
+	//! Variable : slot length (ms).
+	//!
+  	/*!
+   	*/
+	uint16_t _tdmaSlot;
+
+	//! Variable : time (ms) between beacons.
+	//!
+  	/*!
+   	*/
+	uint32_t _tdmaPeriod;
+
+	//! Variable : gateway time stamp of the last beacon.
+	//!
+  	/*!
+   	*/
+	uint32_t _beaconStamp;
+
+	//! Variable : local time (millis) of the start of the last beacon.
+	//!
+  	/*!
+   	*/
+	unsigned long _beaconStart;
+
+	//! Variable : local time (millis) of the end of the last beacon.
+	//!
+  	/*!
+   	*/
+	unsigned long _beaconEnd;
+
+	//! Variable : local ticks per gateway tick.
+	//!
+  	/*!
+   	*/
+	float _clockRatio;
+
+	//! Variable : a beacon has been sent or received.
+	//!
+  	/*!
+   	*/
+	boolean _tdmaSynced;
+
+#if (SX1278_instrumentation > 0)
+	//! Variable : instrumentation counters.
+	//!
+  	/*!
+   	*/
+	instrumentation _instr;
+#endif
+
+	//! Variable : register writes are being queued.
+	//!
+  	/*!
+   	*/
+	boolean _batching;
+
+	//! Variable : registers queued.
+	//!
+  	/*!
+   	*/
+	uint8_t _batchCount;
+
+	//! Variable : a register written in the batch was not read back.
+	//!
+  	/*!
+   	*/
+	uint8_t _batchError;
+
+	//! Variable : addresses of the queued registers.
+	//!
+  	/*!
+   	*/
+	uint8_t _batchAddress[BATCH_SIZE];
+
+	//! Variable : values of the queued registers.
+	//!
+  	/*!
+   	*/
+	uint8_t _batchData[BATCH_SIZE];
+
+	//! Variable : read-back verification policy of the setters.
+	//!
+  	/*!
+   	*/
+	uint8_t _verifyPolicy;
+
+	//! Variable : time (ms) between automatic audits, '0' if disabled.
+	//!
+  	/*!
+   	*/
+	uint32_t _auditPeriod;
+
+	//! Variable : time (ms) of the last audit.
+	//!
+  	/*!
+   	*/
+	unsigned long _lastAudit;
+
+	//! Variable : corrupted registers found by the audits.
+	//!
+  	/*!
+   	*/
+	uint16_t _auditErrors;
+
+	//! Variable : registers kept in the shadow.
+	//!
+  	/*!
+   	*/
+	uint8_t _shadowCount;
+
+	//! Variable : addresses of the registers of the shadow.
+	//!
+  	/*!
+   	*/
+	uint8_t _shadowAddress[SHADOW_SIZE];
+
+	//! Variable : values written in the registers of the shadow.
+	//!
+  	/*!
+   	*/
+	uint8_t _shadowData[SHADOW_SIZE];
+
+	//! Variable : values last checked by the setters, to find the changes.
+	//!
+  	/*!
+   	*/
+	uint8_t _shadowChecked[SHADOW_SIZE];
+
+#if (SX1278_trace_mode > 0)
+	//! Variable : trace ring buffer.
+	//!
+  	/*!
+   	*/
+	traceRecord _trace[TRACE_SIZE];
+
+	//! Variable : next record to write in the trace buffer.
+	//!
+  	/*!
+   	*/
+	uint8_t _traceHead;
+
+	//! Variable : records stored in the trace buffer.
+	//!
+  	/*!
+   	*/
+	uint8_t _traceCount;
+
+	//! Variable : records lost because the trace buffer was full.
+	//!
+  	/*!
+   	*/
+	uint8_t _traceLost;
+
+	//! Variable : last value read from the IRQ flags registers.
+	//!
+  	/*!
+   	*/
+	uint8_t _traceIrq[2];
+#endif
+
 	//! Variable : payload length sent/received.
 	//!
   	/*!
@@ -1344,18 +2670,54 @@ public:
    	*/
 	uint8_t _nodeAddress;
 
+	//! Variable : multicast groups of the node, one bit per group address.
+	//!
+  	/*!
+   	*/
+	uint32_t _groups;
+
 	//! Variable : implicit or explicit header in LoRa mode.
 	//!
   	/*!
    	*/
 	uint8_t _header;
 
+	//! Variable : fixed payload length in implicit header mode ('0' if not used).
+	//!
+  	/*!
+   	*/
+	uint8_t _fixedLength;
+
+	//! Variable : software frame format (legacy or compact).
+	//!
+  	/*!
+   	*/
+	uint8_t _frameFormat;
+
+	//! Variable : format byte of the last compact frame received.
+	//!
+  	/*!
+   	*/
+	uint8_t _rxFormat;
+
 	//! Variable : header received while waiting a packet to arrive.
 	//!
   	/*!
    	*/
 	uint8_t _hreceived;
 
+	//! Variable : indicates if a continuous reception session is running.
+	//!
+  	/*!
+   	*/
+	boolean _rxContinuous;
+
+	//! Variable : number of bytes of the last packet received in LoRa mode.
+	//!
+  	/*!
+   	*/
+	uint8_t _rxNbBytes;
+
 	//! Variable : presence or absence of CRC calculation.
 	//!
   	/*!
@@ -1374,6 +2736,120 @@ public:
    	*/
 	uint8_t _packetNumber;
 
+	//! Variable : length of the last bulk transfer received.
+	//!
+  	/*!
+   	*/
+	uint16_t _bulkLength;
+
+	//! Variable : frames sent before waiting an ACK in bulk transfers.
+	//!
+  	/*!
+   	*/
+	uint8_t _arqWindow;
+
+	//! Variable : ARQ_SELECTIVE_REPEAT or ARQ_GO_BACK_N.
+	//!
+  	/*!
+   	*/
+	uint8_t _arqMode;
+
+	//! Variable : round trip time estimation by peer (direct mapped).
+	//!
+  	/*!
+   	*/
+	rttEstimate _rtt[ARQ_PEERS];
+
+#if (SX1278_link_stats > 0)
+	//! Variable : link statistics by peer (open addressing).
+	//!
+  	/*!
+   	*/
+	linkStats _links[LINK_PEERS];
+
+	//! Variable : events not accounted because the link statistics table
+	//! is full.
+	//!
+  	/*!
+   	*/
+	uint16_t _linkOverflow;
+#endif
+
+	//! Variable : destination of the frame in FIFO.
+	//!
+  	/*!
+   	*/
+	uint8_t _txDest;
+
+	//! Variable : compression of the payloads.
+	//!
+  	/*!
+   	*/
+	uint8_t _compression;
+
+	//! Variable : compressor used with COMPRESSION_CUSTOM.
+	//!
+  	/*!
+   	*/
+	compressHandler _compressHandler;
+
+	//! Variable : decompressor used with COMPRESSION_CUSTOM.
+	//!
+  	/*!
+   	*/
+	compressHandler _decompressHandler;
+
+	//! Variable : encryption of the payloads.
+	//!
+  	/*!
+   	*/
+	uint8_t _security;
+
+	//! Variable : AES-128 key.
+	//!
+  	/*!
+   	*/
+	uint8_t _secKey[16];
+
+	//! Variable : next frame counter, part of the nonce.
+	//!
+  	/*!
+   	*/
+	uint32_t _secCounter;
+
+	//! Variable : sources whose frame counter is tracked, the most
+	//! recently heard first.
+	//!
+  	/*!
+   	*/
+	uint8_t _secPeer[SECURITY_PEERS];
+
+	//! Variable : last frame counter received from each source.
+	//!
+  	/*!
+   	*/
+	uint32_t _secPeerCounter[SECURITY_PEERS];
+
+	//! Variable : number of sources tracked.
+	//!
+  	/*!
+   	*/
+	uint8_t _secPeers;
+
+#if (SX1278_fec_mode > 0)
+	//! Variable : parity frames sent with each block of bulk fragments.
+	//!
+  	/*!
+   	*/
+	uint8_t _fecParity;
+
+	//! Variable : fragments per FEC block.
+	//!
+  	/*!
+   	*/
+	uint8_t _fecBlock;
+#endif
+
 	//! Variable : indicates if received packet is correct or incorrect.
 	//!
   	/*!
@@ -1404,6 +2880,48 @@ public:
    	*/
 	uint8_t _modem;
 
+	//! Variable : last value written in REG_OP_MODE.
+	//!
+  	/*!
+   	*/
+	uint8_t _opMode;
+
+	//! Variable : current power state.
+	//!
+  	/*!
+   	*/
+	uint8_t _powerState;
+
+	//! Variable : time (millis) when the current power state started.
+	//!
+  	/*!
+   	*/
+	unsigned long _powerSince;
+
+	//! Variable : time (ms) spent in each power state.
+	//!
+  	/*!
+   	*/
+	uint32_t _residency[POWER_STATES];
+
+	//! Variable : sleep after each send and receive.
+	//!
+  	/*!
+   	*/
+	boolean _autoSleep;
+
+	//! Variable : wake ups from sleep mode.
+	//!
+  	/*!
+   	*/
+	uint16_t _wakeCount;
+
+	//! Variable : total wake latency (us).
+	//!
+  	/*!
+   	*/
+	uint32_t _wakeTime;
+
 	//! Variable : array with all the information about a sent packet.
 	//!
   	/*!
@@ -1436,6 +2954,23 @@ public:
 
 };
 
+#if (SX1278_instrumentation > 0)
+//! Class : times an instrumented call from its start to its return.
+/*!
+ */
+class instrumentTimer
+{
+public:
+	instrumentTimer(SX1278 *module, uint8_t op);
+	~instrumentTimer();
+
+private:
+	SX1278 *_module;
+	uint8_t _op;
+	unsigned long _start;
+};
+#endif
+
 extern SX1278	sx1278;
 
 #endif
@@ -0,0 +1,139 @@
+#!/usr/bin/env python3
+"""Decoder of the SX1278 binary trace.
+
+Reads the records sent by 'SX1278::drainTrace' (SX1278_trace_mode enabled)
+from a capture file or a serial port and prints one line per event.
+
+Each record is 8 bytes: sync (0xA5), time in us (LE32), event, reg, value.
+
+Usage:
+    trace_decoder.py capture.bin
+    trace_decoder.py /dev/ttyACM0 --baud 115200     (needs pyserial, Ctrl-C ends)
+"""
+
+import argparse
+import struct
+import sys
+
+TRACE_SYNC = 0xA5
+TRACE_FRAME = 8
+
+TRACE_WRITE = 1
+TRACE_IRQ = 2
+TRACE_CALL = 3
+TRACE_LOST = 4
+
+CALLS = {
+    0: "setPacket",
+    1: "sendWithTimeout",
+    2: "availableData",
+    3: "getPacket",
+    4: "getACK",
+    5: "setACK",
+}
+
+REGISTERS = {
+    0x01: "OP_MODE",
+    0x06: "FRF_MSB",
+    0x07: "FRF_MID",
+    0x08: "FRF_LSB",
+    0x09: "PA_CONFIG",
+    0x0B: "OCP",
+    0x0D: "FIFO_ADDR_PTR",
+    0x0E: "FIFO_TX_BASE_ADDR",
+    0x0F: "FIFO_RX_BASE_ADDR",
+    0x11: "IRQ_FLAGS_MASK",
+    0x12: "IRQ_FLAGS",
+    0x1D: "MODEM_CONFIG1",
+    0x1E: "MODEM_CONFIG2",
+    0x1F: "SYMB_TIMEOUT_LSB",
+    0x20: "PREAMBLE_MSB",
+    0x21: "PREAMBLE_LSB",
+    0x22: "PAYLOAD_LENGTH",
+    0x26: "MODEM_CONFIG3",
+    0x3E: "IRQ_FLAGS1",
+    0x3F: "IRQ_FLAGS2",
+    0x40: "DIO_MAPPING1",
+}
+
+# Bit 0 first
+LORA_IRQ = ["CadDetected", "FhssChangeChannel", "CadDone", "TxDone",
+            "ValidHeader", "PayloadCrcError", "RxDone", "RxTimeout"]
+
+
+def register(reg):
+    return REGISTERS.get(reg, "0x%02X" % reg)
+
+
+def describe(event, reg, value):
+    if event == TRACE_WRITE:
+        return "write %-18s 0x%02X" % (register(reg), value)
+    if event == TRACE_IRQ:
+        text = "irq   %-18s 0x%02X" % (register(reg), value)
+        if reg == 0x12:
+            flags = [LORA_IRQ[bit] for bit in range(8) if value & (1 << bit)]
+            if flags:
+                text += "  " + " ".join(flags)
+        return text
+    if event == TRACE_CALL:
+        return "call  " + CALLS.get(value, "op %d" % value)
+    if event == TRACE_LOST:
+        return "lost  %d records%s" % (value, " or more" if value == 255 else "")
+    return "event %d reg 0x%02X value 0x%02X" % (event, reg, value)
+
+
+def records(stream, follow=False):
+    """Yields (time, event, reg, value), resynchronising on garbage bytes.
+
+    With 'follow' an empty read is a read timeout, not the end of the
+    stream, so a serial port is read until the decoder is interrupted.
+    """
+    buffer = b""
+    while True:
+        chunk = stream.read(256)
+        if not chunk:
+            if follow:
+                continue
+            break
+        buffer += chunk
+        while len(buffer) >= TRACE_FRAME:
+            if buffer[0] != TRACE_SYNC:
+                buffer = buffer[1:]
+                continue
+            yield struct.unpack("<IBBB", buffer[1:TRACE_FRAME])
+            buffer = buffer[TRACE_FRAME:]
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("source", help="capture file or serial port")
+    parser.add_argument("--baud", type=int, default=0,
+                        help="open 'source' as a serial port at this baud rate")
+    args = parser.parse_args()
+
+    if args.baud:
+        import serial
+        stream = serial.Serial(args.source, args.baud, timeout=1)
+    else:
+        stream = open(args.source, "rb")
+
+    first = None
+    previous = None
+    try:
+        for time, event, reg, value in records(stream, follow=bool(args.baud)):
+            if first is None:
+                first = previous = time
+            # micros() wraps every 71 minutes
+            delta = (time - previous) & 0xFFFFFFFF
+            elapsed = (time - first) & 0xFFFFFFFF
+            print("%12d us %+10d us  %s" % (elapsed, delta, describe(event, reg, value)))
+            previous = time
+    except KeyboardInterrupt:
+        pass
+    finally:
+        stream.close()
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())